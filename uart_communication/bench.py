@@ -0,0 +1,317 @@
+"""
+End-to-end latency and throughput benchmarks for the SMU serial link.
+
+Times back-to-back round trips of COMM_OK, set_dac, read_adc and scan, plus
+continuous streams, per baud rate and protocol mode (ASCII / binary), and
+reports p50/p99 latency and commands (or samples) per second. Reports are
+saved with DataHandler as CSV and JSON; a saved JSON report is the baseline
+later firmware builds are checked against:
+
+    python bench.py --port COM3 --save baseline
+    python bench.py --port COM3 --compare baseline.json
+
+The firmware UART runs at a fixed rate (115200 by default, huart2 in main.c),
+so every rate passed with --baud needs a firmware build configured for it.
+"""
+
+import argparse
+import sys
+import time
+from typing import Dict, List, Optional
+
+import numpy as np
+
+import uart_com
+from utils import DataHandler
+
+
+BENCH_COMMANDS = ('comm_ok', 'set_dac', 'read_adc', 'scan', 'stream')
+BENCH_MODES = ('ascii', 'binary')
+
+# Report columns, in CSV order
+REPORT_FIELDS = ('command', 'mode', 'baud', 'n', 'failures', 'min_ms', 'p50_ms', 'p99_ms',
+                 'max_ms', 'mean_ms', 'rate_hz', 'mcu_errors')
+
+
+class SMUBenchmark:
+    """
+    Latency/throughput measurements on one open SMU connection.
+    """
+
+    def __init__(self, smu, repeats: int = 200, warmup: int = 10, dac_channel: int = 0,
+                 adc_channel: int = 0, stream_rate: int = 860, stream_samples: int = 2000,
+                 stream_runs: int = 5):
+        """
+        Initialize the benchmark.
+
+        Args:
+            smu: Connected uart_com.SMU instance
+            repeats: Timed round trips per command
+            warmup: Untimed round trips before each command's measurement
+            dac_channel: DAC channel written by set_dac (toggled between two codes)
+            adc_channel: ADC channel read by read_adc and streamed
+            stream_rate: Stream sample rate in SPS (1-860)
+            stream_samples: Samples per stream run
+            stream_runs: Stream runs (latency is first block after the request)
+        """
+        self.smu = smu
+        self.repeats = repeats
+        self.warmup = warmup
+        self.dac_channel = dac_channel
+        self.adc_channel = adc_channel
+        self.stream_rate = stream_rate
+        self.stream_samples = stream_samples
+        self.stream_runs = stream_runs
+        self._dac_toggle = 0
+
+    def run(self, commands=BENCH_COMMANDS, modes=BENCH_MODES) -> List[Dict]:
+        """
+        Benchmark every command in every protocol mode.
+
+        Args:
+            commands: Names from BENCH_COMMANDS
+            modes: Names from BENCH_MODES
+
+        Returns:
+            List of result rows (dicts with REPORT_FIELDS)
+        """
+        rows = []
+        for mode in modes:
+            if mode not in BENCH_MODES:
+                print(f"Error: Mode must be one of {list(BENCH_MODES)}, got '{mode}'")
+                continue
+            if not self.smu.enable_binary_mode(mode == 'binary', verbose=False):
+                print(f"  ✗ Could not switch the MCU to {mode} mode, skipping")
+                continue
+
+            for command in commands:
+                if command == 'stream':
+                    row = self.bench_stream()
+                elif command in BENCH_COMMANDS:
+                    row = self.bench_command(command)
+                else:
+                    print(f"Error: Command must be one of {list(BENCH_COMMANDS)}, got '{command}'")
+                    continue
+                row['mode'] = mode
+                rows.append(row)
+                print(f"  {command:<9} {mode:<6} p50 {row['p50_ms']:7.3f} ms  "
+                      f"p99 {row['p99_ms']:7.3f} ms  {row['rate_hz']:8.1f}/s"
+                      f"{'  (' + str(row['failures']) + ' failed)' if row['failures'] else ''}")
+
+        self.smu.enable_binary_mode(False, verbose=False)
+        return rows
+
+    def bench_command(self, command: str) -> Dict:
+        """
+        Time back-to-back round trips of one command.
+
+        Args:
+            command: 'comm_ok', 'set_dac', 'read_adc' or 'scan'
+
+        Returns:
+            Result row
+        """
+        call = {
+            'comm_ok': self._comm_ok,
+            'set_dac': self._set_dac,
+            'read_adc': lambda: self.smu.read_voltage(self.adc_channel, verbose=False) is not None,
+            'scan': lambda: self.smu.scan(0x0F, verbose=False) is not None,
+        }[command]
+
+        for _ in range(self.warmup):
+            call()
+
+        errors_before = self._mcu_errors()
+        latencies = []
+        failures = 0
+        started = time.perf_counter()
+        for _ in range(self.repeats):
+            t0 = time.perf_counter()
+            ok = call()
+            latencies.append(time.perf_counter() - t0)
+            if not ok:
+                failures += 1
+        elapsed = time.perf_counter() - started
+
+        row = self._summarize(command, latencies, failures)
+        row['rate_hz'] = self.repeats / elapsed if elapsed > 0 else 0.0
+        row['mcu_errors'] = self._error_delta(errors_before)
+        return row
+
+    def bench_stream(self) -> Dict:
+        """
+        Time continuous streams: latency to the first block, sustained samples per second.
+
+        Returns:
+            Result row (rate_hz in samples per second)
+        """
+        errors_before = self._mcu_errors()
+        latencies = []
+        failures = 0
+        samples = 0
+        streaming_time = 0.0
+
+        for _ in range(self.stream_runs):
+            t0 = time.perf_counter()
+            first = None
+            received = 0
+            for block in self.smu.stream(self.adc_channel, self.stream_rate, self.stream_samples,
+                                         verbose=False):
+                if first is None:
+                    first = time.perf_counter()
+                received += len(block)
+            done = time.perf_counter()
+
+            if first is None or received < self.stream_samples:
+                failures += 1
+            if first is not None:
+                latencies.append(first - t0)
+            samples += received
+            streaming_time += done - t0
+
+        row = self._summarize('stream', latencies, failures)
+        row['n'] = self.stream_runs
+        row['rate_hz'] = samples / streaming_time if streaming_time > 0 else 0.0
+        row['mcu_errors'] = self._error_delta(errors_before)
+        return row
+
+    def _comm_ok(self) -> bool:
+        """One COMM_OK round trip in the current protocol mode."""
+        if self.smu.binary:
+            return self.smu.transact(uart_com.PROTO_OP_COMM_OK, b'', verbose=False) is not None
+        return self.smu.check_communication(verbose=False)
+
+    def _set_dac(self) -> bool:
+        """One acknowledged set_dac, alternating between two codes."""
+        self._dac_toggle ^= 1
+        _, response = self.smu.set_dac(self.dac_channel, 1000 + self._dac_toggle, verbose=False)
+        return response == "1"
+
+    def _mcu_errors(self) -> Optional[Dict]:
+        """Firmware event counters (get_stats), None if the firmware has no stats command."""
+        stats = self.smu.get_stats(verbose=False)
+        return stats['counters'] if stats else None
+
+    def _error_delta(self, before: Optional[Dict]) -> Optional[int]:
+        """Firmware errors and dropped input counted since `before`."""
+        after = self._mcu_errors()
+        if before is None or after is None:
+            return None
+        return sum(after[k] - before.get(k, 0) for k in after)
+
+    def _summarize(self, command: str, latencies: List[float], failures: int) -> Dict:
+        """Latency statistics of one measurement, in milliseconds."""
+        ms = np.array(latencies) * 1e3 if latencies else np.array([np.nan])
+        return {
+            'command': command,
+            'mode': 'binary' if self.smu.binary else 'ascii',
+            'baud': self.smu.baud,
+            'n': len(latencies),
+            'failures': failures,
+            'min_ms': float(np.min(ms)),
+            'p50_ms': float(np.percentile(ms, 50)),
+            'p99_ms': float(np.percentile(ms, 99)),
+            'max_ms': float(np.max(ms)),
+            'mean_ms': float(np.mean(ms)),
+        }
+
+
+def run_suite(port: str, bauds=(115200,), commands=BENCH_COMMANDS, modes=BENCH_MODES,
+              **bench_kwargs) -> Dict:
+    """
+    Benchmark the link at each baud rate (one connection per rate).
+
+    Args:
+        port: Serial port name
+        bauds: Baud rates to test (each needs matching firmware)
+        commands: Names from BENCH_COMMANDS
+        modes: Names from BENCH_MODES
+        **bench_kwargs: Passed on to SMUBenchmark (repeats, adc_channel, ...)
+
+    Returns:
+        Report: {'created': ISO time, 'port': port, 'results': [rows]}
+    """
+    rows = []
+    for baud in bauds:
+        print(f"Benchmarking {port} at {baud} baud...")
+        with uart_com.SMU(port=port, baud=baud, verbose=False) as smu:
+            if smu.ser is None or not smu.check_communication(verbose=False):
+                print(f"  ✗ No communication at {baud} baud, skipping")
+                continue
+            rows.extend(SMUBenchmark(smu, **bench_kwargs).run(commands, modes))
+
+    return {'created': time.strftime('%Y-%m-%dT%H:%M:%S'), 'port': port, 'results': rows}
+
+
+def save_report(report: Dict, prefix: str) -> None:
+    """
+    Save a report as <prefix>.json (baseline format) and <prefix>.csv (one row per result).
+
+    Args:
+        report: Report from run_suite
+        prefix: Output filename without extension
+    """
+    DataHandler.save_to_json(report, prefix + '.json')
+    columns = {field: [row.get(field) for row in report['results']] for field in REPORT_FIELDS}
+    DataHandler.save_to_csv(columns, prefix + '.csv')
+
+
+def compare_reports(report: Dict, baseline: Dict, tolerance: float = 0.2) -> List[str]:
+    """
+    Find results that got worse than the baseline.
+
+    A result regresses if its p50 or p99 latency grew, or its rate dropped, by
+    more than `tolerance` (relative), or if it failed where the baseline did not.
+
+    Args:
+        report: Report from run_suite
+        baseline: Earlier report (DataHandler.load_from_json)
+        tolerance: Allowed relative change (0.2 = 20%)
+
+    Returns:
+        List of regression descriptions (empty if none)
+    """
+    def key(row):
+        return row['command'], row['mode'], row['baud']
+
+    reference = {key(row): row for row in baseline.get('results', [])}
+    regressions = []
+
+    for row in report['results']:
+        base = reference.get(key(row))
+        if base is None:
+            continue
+        name = '{} {} @{}'.format(*key(row))
+        for field in ('p50_ms', 'p99_ms'):
+            if base[field] > 0 and row[field] > base[field] * (1 + tolerance):
+                regressions.append(f"{name}: {field} {base[field]:.3f} → {row[field]:.3f}")
+        if base['rate_hz'] > 0 and row['rate_hz'] < base['rate_hz'] * (1 - tolerance):
+            regressions.append(f"{name}: rate_hz {base['rate_hz']:.1f} → {row['rate_hz']:.1f}")
+        if row['failures'] > base['failures']:
+            regressions.append(f"{name}: failures {base['failures']} → {row['failures']}")
+
+    return regressions
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="SMU link latency/throughput benchmark")
+    parser.add_argument('--port', default='COM3', help="Serial port")
+    parser.add_argument('--baud', type=int, nargs='+', default=[115200], help="Baud rate(s)")
+    parser.add_argument('--modes', nargs='+', default=list(BENCH_MODES), choices=BENCH_MODES)
+    parser.add_argument('--commands', nargs='+', default=list(BENCH_COMMANDS), choices=BENCH_COMMANDS)
+    parser.add_argument('--repeats', type=int, default=200, help="Round trips per command")
+    parser.add_argument('--save', help="Output prefix (default: bench_<timestamp>)")
+    parser.add_argument('--compare', help="Baseline JSON report to check for regressions")
+    parser.add_argument('--tolerance', type=float, default=0.2, help="Allowed relative change")
+    args = parser.parse_args()
+
+    report = run_suite(args.port, args.baud, args.commands, args.modes, repeats=args.repeats)
+    save_report(report, args.save or DataHandler.create_timestamped_filename('bench', 'json')[:-5])
+
+    if args.compare:
+        regressions = compare_reports(report, DataHandler.load_from_json(args.compare), args.tolerance)
+        for line in regressions:
+            print(f"  ✗ Regression: {line}")
+        if regressions:
+            sys.exit(1)
+        print(f"  ✓ No regressions against {args.compare}")
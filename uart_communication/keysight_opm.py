@@ -1,9 +1,12 @@
 import pyvisa
 import numpy as np
-from time import sleep
+from time import sleep, time
 
 
 class KeysightOPM:
+    # Software trigger for logging armed with start_logging(..., triggered=True)
+    SOFTWARE_TRIGGER = "*TRG"
+
     def __init__(self, visa_addr: str):
         self.rm = pyvisa.ResourceManager()
         self.inst = self.rm.open_resource(visa_addr)
@@ -117,6 +120,69 @@ class KeysightOPM:
             self.set_unit(chan, "dBm")
         return val * 1000 if val is not None else None
 
+    def start_logging(self, chan: int, points: int, avg_time: float = 1e-4,
+                      triggered: bool = True) -> bool:
+        """
+        Arm the logging function to record a trace of points in one go.
+
+        With triggered=True each trigger (rising edge on the trigger input, e.g.
+        the STM32's PA10 pulse, or a software trigger()) records one point;
+        otherwise points are logged back-to-back every avg_time. Read the trace
+        with fetch_logging(), so a whole sweep costs a single transfer.
+        """
+        if not self._check_channel(chan) or points < 1:
+            return False
+        try:
+            self.write(f"sens{chan}:func:stat logg,stop")
+            self.write(f"trig{chan}:inp {'sme' if triggered else 'ign'}")
+            self.write(f"sens{chan}:func:par:logg {int(points)},{avg_time}s")
+            self.write(f"sens{chan}:func:stat logg,star")
+            return True
+        except pyvisa.errors.VisaIOError as e:
+            print(f"Error: Could not arm logging on channel {chan}: {e}")
+            return False
+
+    def trigger(self):
+        """Software trigger: records one point on every channel armed with start_logging()."""
+        self.write(self.SOFTWARE_TRIGGER)
+
+    def logging_complete(self, chan: int) -> bool:
+        if not self._check_channel(chan): return False
+        try:
+            return "COMPLETE" in self.query(f"sens{chan}:func:stat?").upper()
+        except pyvisa.errors.VisaIOError as e:
+            print(f"Error: Could not read logging state of channel {chan}: {e}")
+            return False
+
+    def fetch_logging(self, chan: int, timeout: float = 10.0) -> np.ndarray | None:
+        """
+        Wait for the armed trace to complete and read it with one binary transfer.
+
+        Returns the trace in mW (logging results are always in Watt), or None on
+        timeout or instrument error. The trigger input is set back to ignore triggers.
+        """
+        if not self._check_channel(chan):
+            return None
+        deadline = time() + timeout
+        try:
+            while "COMPLETE" not in self.query(f"sens{chan}:func:stat?").upper():
+                if time() > deadline:
+                    self.stop_logging(chan)
+                    return None
+                sleep(0.01)
+            self.write(f"sens{chan}:func:res?")
+            trace = np.asarray(self.read_binary("f"), dtype=float) * 1000
+        except (pyvisa.errors.VisaIOError, ValueError, TypeError) as e:
+            print(f"Error: Could not read logging trace of channel {chan}: {e}")
+            trace = None
+        self.stop_logging(chan)
+        return trace
+
+    def stop_logging(self, chan: int):
+        if not self._check_channel(chan): return
+        self.write(f"sens{chan}:func:stat logg,stop")
+        self.write(f"trig{chan}:inp ign")
+
     def get_power_all(self) -> list[float]:
         """
         Measure the optical power on all available channels in their current units.
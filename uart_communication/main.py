@@ -11,42 +11,29 @@ if __name__ == "__main__":
         opm = keysight_opm.KeysightOPM(keysight_visa)
         print(f"Connected to OPM: {opm.id}\n")
         
-        # Initialize DAC controller
-        dac = uart_com.DACController(port="COM3", baud=115200, verbose=True)
+        # One serial connection for both DAC and ADC
+        smu = uart_com.SMU(port="COM3", baud=115200,
+                           shunt_resistors=[200.0, 200.0, 200.0, 200.0],
+                           verbose=True)
         
         # Check communication
-        if not dac.check_communication():
-            print("Warning: DAC communication check failed.")
-            dac.close()
+        if not smu.check_communication():
+            print("Warning: SMU communication check failed.")
+            smu.close()
             exit()
         
         # Set DAC channel 0
         dac_value = 1000
         print(f"Setting DAC channel 0 to {dac_value}...")
-        dac.set_dac(0, dac_value)
+        smu.set_dac(0, dac_value)
         sleep(0.2)  # Wait for DAC to settle
         
-        # Close DAC controller to free the serial port
-        dac.close()
-        sleep(0.5)  # Brief pause before reopening port
-        
-        # Initialize ADC controller (uses same port, so we need to close DAC first)
-        adc = uart_com.ADCController(port="COM3", baud=115200, 
-                                     shunt_resistors=[200.0, 200.0, 200.0, 200.0],
-                                     verbose=True)
-        
-        # Check communication
-        if not adc.check_communication():
-            print("Warning: ADC communication check failed.")
-            adc.close()
-            exit()
-        
         # Read current from ADC channel 0
         print("\nReading current from ADC channel 0...")
-        current = adc.read_current(0, verbose=True, timeout=3.0)
+        current = smu.read_current(0, verbose=True, timeout=3.0)
         
-        # Close ADC controller
-        adc.close()
+        # Close serial connection
+        smu.close()
         
         # Read power from OPM channel 1 (OPM uses 1-based indexing)
         print("\nReading power from OPM channel 1...")
@@ -8,22 +8,67 @@
   */
 
 #include "ADS1115.h"
+#include "smu_stats.h"
 
-static void prepareConfigFrame(uint8_t *pOutFrame, ADS1115_Config_t config);
+static void prepareConfigFrame(uint8_t *pOutFrame, const ADS1115_Handle_t *pConfig,
+                               ADS1115_OperatingMode_t mode);
+static void waitForConversion(ADS1115_Handle_t *pConfig);
+static HAL_StatusTypeDef readConversionRegister(ADS1115_Handle_t *pConfig, int16_t *value);
+static HAL_StatusTypeDef i2cTransmit(ADS1115_Handle_t *pConfig, uint8_t *data, uint16_t size,
+                                     uint32_t timeout);
+static HAL_StatusTypeDef i2cReceive(ADS1115_Handle_t *pConfig, uint8_t *data, uint16_t size,
+                                    uint32_t timeout);
+
+/* Samples per second per data rate setting */
+static const uint16_t dataRateSps[8] = {
+    8, 16, 32, 64, 128, 250, 475, 860
+};
+
+/* Nominal conversion period per data rate in microseconds (1 / SPS) */
+static const uint32_t conversionTimeUs[8] = {
+    125000, 62500, 31250, 15625, 7813, 4000, 2106, 1163
+};
 
 /**
-  * @brief  Initialize ADS1115 driver
+  * @brief  Initialize a caller-provided ADS1115 handle (static storage, no heap)
+  * @param  pConfig: Handle to initialize
   * @param  hi2c: Pointer to HAL I2C handle
   * @param  Addr: I2C address (0x48-0x4B)
   * @param  config: Configuration structure
-  * @retval Pointer to handle structure
+  * @retval HAL_OK, HAL_ERROR for a NULL handle or bus
   */
-ADS1115_Handle_t* ADS1115_init(I2C_HandleTypeDef *hi2c, uint16_t Addr, ADS1115_Config_t config)
+HAL_StatusTypeDef ADS1115_initHandle(ADS1115_Handle_t *pConfig, I2C_HandleTypeDef *hi2c,
+                                     uint16_t Addr, ADS1115_Config_t config)
 {
-    ADS1115_Handle_t *pConfig = malloc(sizeof(ADS1115_Handle_t));
+    if (pConfig == NULL || hi2c == NULL)
+        return HAL_ERROR;
+
     pConfig->hi2c = hi2c;
     pConfig->address = Addr;
     pConfig->config = config;
+    pConfig->waitMode = ADS1115_WAIT_FIXED_DELAY;
+    pConfig->conversionReady = 0;
+    pConfig->comparatorGated = 0;
+    pConfig->comparatorChannel = config.channel;
+    return HAL_OK;
+}
+
+#if ADS1115_USE_HEAP
+/**
+  * @brief  Initialize ADS1115 driver
+  * @param  hi2c: Pointer to HAL I2C handle
+  * @param  Addr: I2C address (0x48-0x4B)
+  * @param  config: Configuration structure
+  * @retval Pointer to handle structure, NULL if the allocation failed
+  */
+ADS1115_Handle_t* ADS1115_init(I2C_HandleTypeDef *hi2c, uint16_t Addr, ADS1115_Config_t config)
+{
+    ADS1115_Handle_t *pConfig = malloc(sizeof(ADS1115_Handle_t));
+    if (ADS1115_initHandle(pConfig, hi2c, Addr, config) != HAL_OK)
+    {
+        free(pConfig);
+        return NULL;
+    }
     return pConfig;
 }
 
@@ -36,6 +81,7 @@ void ADS1115_deinit(ADS1115_Handle_t* pConfig)
 {
     free(pConfig);
 }
+#endif /* ADS1115_USE_HEAP */
 
 /**
   * @brief  Update ADS1115 configuration
@@ -47,10 +93,10 @@ void ADS1115_updateConfig(ADS1115_Handle_t *pConfig, ADS1115_Config_t config)
 {
     pConfig->config = config;
 
-    uint8_t bytes[3] = {0};
-    prepareConfigFrame(bytes, pConfig->config);
+    uint8_t bytes[3];
+    prepareConfigFrame(bytes, pConfig, config.operatingMode);
 
-    HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), bytes, 3, 100);
+    i2cTransmit(pConfig, bytes, 3, 100);
 }
 
 /**
@@ -82,28 +128,53 @@ void ADS1115_updateAddress(ADS1115_Handle_t *pConfig, uint16_t address)
   */
 int16_t ADS1115_oneShotMeasure(ADS1115_Handle_t *pConfig)
 {
-    uint8_t bytes[3] = {0};
+    int16_t value = 0;
 
-    prepareConfigFrame(bytes, pConfig->config);
+    if (ADS1115_startConversion(pConfig) == HAL_OK)
+    {
+        ADS1115_readConversion(pConfig, &value); // Stays 0 on I2C error
+    }
+
+    return value;
+}
+
+/**
+  * @brief  Start a single-shot conversion without waiting for it
+  * @note   Lets several devices on one bus convert at the same time: start each,
+  *         then collect each with ADS1115_readConversion
+  * @param  pConfig: Pointer to handle structure
+  * @retval HAL status of the config write
+  */
+HAL_StatusTypeDef ADS1115_startConversion(ADS1115_Handle_t *pConfig)
+{
+    uint8_t bytes[3];
+
+    prepareConfigFrame(bytes, pConfig, pConfig->config.operatingMode);
 
     bytes[1] |= (1 << 7); // OS one shot measure - start conversion
 
+    // Clear before starting so a stale RDY edge is not taken for this conversion
+    pConfig->conversionReady = 0;
+
     // Write config register to start conversion
-    if (HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), bytes, 3, 100) != HAL_OK)
-    {
-        return 0; // I2C error
-    }
+    return i2cTransmit(pConfig, bytes, 3, 100);
+}
 
-    // Wait for conversion to complete
-    // At 128 SPS, conversion takes ~8ms. Wait longer to be safe (15ms should be enough)
-    HAL_Delay(15);
+/**
+  * @brief  Wait for the conversion started by ADS1115_startConversion and read it
+  * @param  pConfig: Pointer to handle structure
+  * @param  value: Output, 16-bit signed ADC value (left untouched on error)
+  * @retval HAL status of the data read
+  */
+HAL_StatusTypeDef ADS1115_readConversion(ADS1115_Handle_t *pConfig, int16_t *value)
+{
+    // Wait for conversion to complete (timing follows config.dataRate)
+    uint32_t wait_start = Stats_Cycles();
+    waitForConversion(pConfig);
+    Stats_Record(STATS_ADC_WAIT, wait_start);
     
     // Read the conversion data
-    // Note: We don't poll the OS bit because:
-    // 1. When OS=1 is written, the device immediately clears it to 0 and starts converting
-    // 2. After waiting 15ms (well beyond the ~8ms conversion time), conversion should be complete
-    // 3. Reading the conversion register will return the latest conversion result
-    return ADS1115_getData(pConfig);
+    return readConversionRegister(pConfig, value);
 }
 
 /**
@@ -113,24 +184,11 @@ int16_t ADS1115_oneShotMeasure(ADS1115_Handle_t *pConfig)
   */
 int16_t ADS1115_getData(ADS1115_Handle_t *pConfig)
 {
-    uint8_t reg_addr = 0x00; // Conversion register address
-    uint8_t bytes[2] = {0};
-    
-    // Write register address
-    if (HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), &reg_addr, 1, 50) != HAL_OK)
-    {
-        return 0; // I2C transmit error
-    }
+    int16_t readValue = 0;
 
-    // Read 2 bytes from conversion register
-    if (HAL_I2C_Master_Receive(pConfig->hi2c, (pConfig->address << 1), bytes, 2, 50) != HAL_OK)
-    {
-        return 0; // I2C receive error
-    }
+    // Stays 0 on an I2C error
+    readConversionRegister(pConfig, &readValue);
 
-    // Combine bytes (MSB first)
-    int16_t readValue = ((int16_t)(bytes[0] << 8) | bytes[1]);
-    
     // Note: We keep negative values as they represent negative voltages
     // The caller should handle the sign appropriately
     return readValue;
@@ -151,13 +209,13 @@ void ADS1115_setThresholds(ADS1115_Handle_t *pConfig, int16_t lowValue, int16_t
     ADSWrite[0] = 0x03;
     ADSWrite[1] = (uint8_t)((highValue & 0xFF00) >> 8);
     ADSWrite[2] = (uint8_t)(highValue & 0x00FF);
-    HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), ADSWrite, 3, 100);
+    i2cTransmit(pConfig, ADSWrite, 3, 100);
 
     //lo threshold reg
     ADSWrite[0] = 0x02;
     ADSWrite[1] = (uint8_t)((lowValue & 0xFF00) >> 8);
     ADSWrite[2] = (uint8_t)(lowValue & 0x00FF);
-    HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), ADSWrite, 3, 100);
+    i2cTransmit(pConfig, ADSWrite, 3, 100);
 }
 
 /**
@@ -180,6 +238,112 @@ void ADS1115_setConversionReadyPin(ADS1115_Handle_t* pConfig)
     ADS1115_setThresholds(pConfig, 0x0000, 0xFFFF);
 }
 
+/**
+  * @brief  Select how oneShotMeasure waits for a conversion to finish
+  * @note   ADS1115_WAIT_RDY_PIN turns the comparator into a conversion-ready
+  *         output (thresholds MSB trick, assert after one conversion, active low).
+  *         The ALERT/RDY pin must be wired to an EXTI line whose callback calls
+  *         ADS1115_conversionReadyCallback.
+  * @param  pConfig: Pointer to handle structure
+  * @param  mode: Wait strategy
+  * @retval None
+  */
+void ADS1115_setWaitMode(ADS1115_Handle_t *pConfig, ADS1115_WaitMode_t mode)
+{
+    if (mode == ADS1115_WAIT_RDY_PIN)
+    {
+        pConfig->config.queueComparator = ADS1115_QUE_1_CONV;
+        pConfig->config.polarityMode = ADS1115_POL_ACTIVE_LOW;
+        pConfig->config.latchingMode = ADS1115_LAT_NON_LATCHING;
+        ADS1115_setConversionReadyPin(pConfig);
+    }
+    pConfig->waitMode = mode;
+}
+
+/**
+  * @brief  Restrict the comparator to conversions of one input
+  * @note   The comparator judges every conversion against the thresholds. With the
+  *         gate on, conversions of other inputs are started with the comparator
+  *         disabled (COMP_QUE = 11), which also releases ALERT, so thresholds set
+  *         for one channel are not tripped by the others and every over-threshold
+  *         conversion of the gated channel produces a fresh ALERT edge.
+  * @param  pConfig: Pointer to handle structure
+  * @param  enable: 1 to gate, 0 to let every conversion through to the comparator
+  * @param  channel: Input the comparator watches
+  * @retval None
+  */
+void ADS1115_setComparatorGate(ADS1115_Handle_t *pConfig, uint8_t enable, ADS1115_MUX_t channel)
+{
+    pConfig->comparatorGated = enable;
+    pConfig->comparatorChannel = channel;
+}
+
+/**
+  * @brief  Mark the current conversion as complete
+  * @note   Call from the EXTI callback of the ALERT/RDY pin
+  * @param  pConfig: Pointer to handle structure
+  * @retval None
+  */
+void ADS1115_conversionReadyCallback(ADS1115_Handle_t *pConfig)
+{
+    pConfig->conversionReady = 1;
+}
+
+/**
+  * @brief  Check the OS bit of the config register
+  * @param  pConfig: Pointer to handle structure
+  * @retval 1 if no conversion is in progress, 0 if converting or on I2C error
+  */
+uint8_t ADS1115_isConversionReady(ADS1115_Handle_t *pConfig)
+{
+    uint8_t bytes[2] = {0};
+
+    if (HAL_I2C_Mem_Read(pConfig->hi2c, (pConfig->address << 1), ADS1115_REG_CONFIG,
+                         I2C_MEMADD_SIZE_8BIT, bytes, 2, 50) != HAL_OK)
+    {
+        Stats_Count(STATS_ADC_I2C_ERRORS);
+        return 0;
+    }
+
+    // OS reads 1 when the device is idle
+    return (bytes[0] & 0x80) ? 1 : 0;
+}
+
+/**
+  * @brief  Nominal conversion time for a data rate
+  * @param  dataRate: Data rate setting
+  * @retval Conversion period in microseconds
+  */
+uint32_t ADS1115_getConversionTimeUs(ADS1115_DataRate_t dataRate)
+{
+    return conversionTimeUs[dataRate & 0x07];
+}
+
+/**
+  * @brief  Pick the slowest data rate that is at least the requested rate
+  * @param  sps: Requested samples per second
+  * @retval Data rate setting (ADS1115_DR_860SPS for anything above 475)
+  */
+ADS1115_DataRate_t ADS1115_dataRateFromSps(uint16_t sps)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (dataRateSps[i] >= sps)
+            return (ADS1115_DataRate_t)i;
+    }
+    return ADS1115_DR_860SPS;
+}
+
+/**
+  * @brief  Samples per second for a data rate setting
+  * @param  dataRate: Data rate setting
+  * @retval Samples per second
+  */
+uint16_t ADS1115_dataRateToSps(ADS1115_DataRate_t dataRate)
+{
+    return dataRateSps[dataRate & 0x07];
+}
+
 /**
   * @brief  Start continuous conversion mode
   * @param  pConfig: Pointer to handle structure
@@ -187,13 +351,11 @@ void ADS1115_setConversionReadyPin(ADS1115_Handle_t* pConfig)
   */
 void ADS1115_startContinousMode(ADS1115_Handle_t *pConfig)
 {
-    uint8_t bytes[3] = {0};
+    uint8_t bytes[3];
 
-    ADS1115_Config_t configReg = pConfig->config;
-    configReg.operatingMode = MODE_CONTINOUS;
-    prepareConfigFrame(bytes, configReg);
+    prepareConfigFrame(bytes, pConfig, MODE_CONTINOUS);
 
-    HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), bytes, 3, 100);
+    i2cTransmit(pConfig, bytes, 3, 100);
 }
 
 /**
@@ -203,39 +365,151 @@ void ADS1115_startContinousMode(ADS1115_Handle_t *pConfig)
   */
 void ADS1115_stopContinousMode(ADS1115_Handle_t *pConfig)
 {
-    uint8_t bytes[3] = {0};
-    ADS1115_Config_t configReg = pConfig->config;
-    configReg.operatingMode = MODE_SINGLE_SHOT;
-    prepareConfigFrame(bytes, configReg);
+    uint8_t bytes[3];
+
+    prepareConfigFrame(bytes, pConfig, MODE_SINGLE_SHOT);
+
+    i2cTransmit(pConfig, bytes, 3, 100);
+}
+
+/**
+  * @brief  Wait for the conversion started by ADS1115_startConversion
+  * @note   The internal oscillator is specified to ±10%, so the timeout allows
+  *         twice the nominal period plus one tick of HAL_GetTick resolution.
+  *         On timeout (counted as STATS_ADC_TIMEOUTS) the caller reads whatever
+  *         result is latched.
+  * @param  pConfig: Pointer to handle structure
+  * @retval None
+  */
+static void waitForConversion(ADS1115_Handle_t *pConfig)
+{
+    uint32_t conv_us = ADS1115_getConversionTimeUs(pConfig->config.dataRate);
+    uint32_t timeout_ms = (2 * conv_us) / 1000 + 2;
+    uint32_t start = HAL_GetTick();
+
+    switch (pConfig->waitMode)
+    {
+    case ADS1115_WAIT_RDY_PIN:
+        while (!pConfig->conversionReady && (HAL_GetTick() - start) < timeout_ms) {}
+        if (!pConfig->conversionReady)
+            Stats_Count(STATS_ADC_TIMEOUTS);
+        break;
+
+    case ADS1115_WAIT_POLL_OS:
+    {
+        uint8_t ready;
+        while (!(ready = ADS1115_isConversionReady(pConfig)) && (HAL_GetTick() - start) < timeout_ms) {}
+        if (!ready)
+            Stats_Count(STATS_ADC_TIMEOUTS);
+        break;
+    }
+
+    case ADS1115_WAIT_FIXED_DELAY:
+    default:
+        // Nominal period + 10% oscillator tolerance, rounded up to whole ms
+        HAL_Delay((conv_us + conv_us / 10) / 1000 + 1);
+        break;
+    }
+}
+
+/**
+  * @brief  Read the conversion register
+  * @param  pConfig: Pointer to handle structure
+  * @param  value: Output, 16-bit signed ADC value (left untouched on error)
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef readConversionRegister(ADS1115_Handle_t *pConfig, int16_t *value)
+{
+    uint8_t reg_addr = ADS1115_REG_CONVERSION;
+    uint8_t bytes[2] = {0};
+
+    // Write register address
+    if (i2cTransmit(pConfig, &reg_addr, 1, 50) != HAL_OK)
+    {
+        return HAL_ERROR; // I2C transmit error
+    }
+
+    // Read 2 bytes from conversion register
+    if (i2cReceive(pConfig, bytes, 2, 50) != HAL_OK)
+    {
+        return HAL_ERROR; // I2C receive error
+    }
 
-    HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1), bytes, 3, 100);
+    // Combine bytes (MSB first)
+    *value = (int16_t)((bytes[0] << 8) | bytes[1]);
+    return HAL_OK;
 }
 
 /**
   * @brief  Prepare configuration frame for transmission
+  * @note   Encoded straight from the handle, so a channel or range switch costs a
+  *         few shifts and the 3-byte write, without copying the configuration.
+  *         The comparator is disabled if the gate excludes the selected channel.
   * @param  pOutFrame: Output buffer (3 bytes)
-  * @param  config: Configuration structure
+  * @param  pConfig: Pointer to handle structure
+  * @param  mode: Operating mode to encode (overrides config.operatingMode)
   * @retval None
   */
-static void prepareConfigFrame(uint8_t *pOutFrame, ADS1115_Config_t config)
+static void prepareConfigFrame(uint8_t *pOutFrame, const ADS1115_Handle_t *pConfig,
+                               ADS1115_OperatingMode_t mode)
 {
-    pOutFrame[0] = 0x01;  // Config register address
+    const ADS1115_Config_t *config = &pConfig->config;
+    ADS1115_QueueComparator_t queue = config->queueComparator;
+
+    if (pConfig->comparatorGated && config->channel != pConfig->comparatorChannel)
+        queue = ADS1115_QUE_DISABLE;
+
+    pOutFrame[0] = ADS1115_REG_CONFIG;  // Config register address
     
     // Byte 1: MUX (bits 14-12), PGA (bits 11-9), MODE (bit 8)
-    // Original code: (config.channel << 4) | (config.pgaConfig << 1) | (config.operatingMode << 0)
-    pOutFrame[1] = 0;
-    pOutFrame[1] |= (config.channel << 4);        // MUX: bits 6-4
-    pOutFrame[1] |= (config.pgaConfig << 1);      // PGA: bits 3-1
-    pOutFrame[1] |= (config.operatingMode << 0);   // MODE: bit 0
+    pOutFrame[1] = (uint8_t)((config->channel << 4) |       // MUX: bits 6-4
+                             (config->pgaConfig << 1) |     // PGA: bits 3-1
+                             (mode << 0));                  // MODE: bit 0
     
     // Byte 2: DR (bits 7-5), COMP_MODE (bit 4), POL (bit 3), LAT (bit 2), QUE (bits 1-0)
-    // Original code: (config.dataRate << 5) | (config.compareMode << 4) | (config.polarityMode << 3)
-    //                | (config.latchingMode << 2) | (config.queueComparator << 0)
-    pOutFrame[2] = 0;
-    pOutFrame[2] |= (config.dataRate << 5);           // Data rate: bits 7-5
-    pOutFrame[2] |= (config.compareMode << 4);        // Compare mode: bit 4
-    pOutFrame[2] |= (config.polarityMode << 3);      // Polarity: bit 3
-    pOutFrame[2] |= (config.latchingMode << 2);      // Latching: bit 2
-    pOutFrame[2] |= (config.queueComparator << 0);   // Queue: bits 1-0
+    pOutFrame[2] = (uint8_t)((config->dataRate << 5) |      // Data rate: bits 7-5
+                             (config->compareMode << 4) |   // Compare mode: bit 4
+                             (config->polarityMode << 3) |  // Polarity: bit 3
+                             (config->latchingMode << 2) |  // Latching: bit 2
+                             (queue << 0));                 // Queue: bits 1-0
+}
+
+/**
+  * @brief  Blocking write to the device, timed and error-counted for "stats"
+  * @param  pConfig: Pointer to handle structure
+  * @param  data: Bytes to send
+  * @param  size: Number of bytes
+  * @param  timeout: HAL timeout in ms
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef i2cTransmit(ADS1115_Handle_t *pConfig, uint8_t *data, uint16_t size,
+                                     uint32_t timeout)
+{
+    uint32_t start = Stats_Cycles();
+    HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(pConfig->hi2c, (pConfig->address << 1),
+                                                       data, size, timeout);
+    Stats_Record(STATS_ADC_I2C, start);
+    if (status != HAL_OK)
+        Stats_Count(STATS_ADC_I2C_ERRORS);
+    return status;
 }
 
+/**
+  * @brief  Blocking read from the device, timed and error-counted for "stats"
+  * @param  pConfig: Pointer to handle structure
+  * @param  data: Output buffer
+  * @param  size: Number of bytes
+  * @param  timeout: HAL timeout in ms
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef i2cReceive(ADS1115_Handle_t *pConfig, uint8_t *data, uint16_t size,
+                                    uint32_t timeout)
+{
+    uint32_t start = Stats_Cycles();
+    HAL_StatusTypeDef status = HAL_I2C_Master_Receive(pConfig->hi2c, (pConfig->address << 1),
+                                                      data, size, timeout);
+    Stats_Record(STATS_ADC_I2C, start);
+    if (status != HAL_OK)
+        Stats_Count(STATS_ADC_I2C_ERRORS);
+    return status;
+}
@@ -24,6 +24,12 @@ extern "C" {
 #define ADS1115_ADDR_SDA    0x4A  // ADDR pin to SDA
 #define ADS1115_ADDR_SCL    0x4B  // ADDR pin to SCL
 
+/* ADS1115_init allocates the handle with malloc; the firmware uses ADS1115_initHandle
+   with static storage and links without a heap */
+#ifndef ADS1115_USE_HEAP
+#define ADS1115_USE_HEAP    0
+#endif
+
 /* Register addresses */
 #define ADS1115_REG_CONVERSION  0x00
 #define ADS1115_REG_CONFIG      0x01
@@ -96,6 +102,16 @@ typedef enum {
     ADS1115_QUE_DISABLE = 3
 } ADS1115_QueueComparator_t;
 
+/* Conversion wait strategy used by ADS1115_oneShotMeasure */
+typedef enum {
+    ADS1115_WAIT_FIXED_DELAY = 0,  // HAL_Delay for the data-rate conversion time
+    ADS1115_WAIT_POLL_OS = 1,      // Poll the OS bit of the config register
+    ADS1115_WAIT_RDY_PIN = 2       // ALERT/RDY pin on EXTI, see ADS1115_conversionReadyCallback
+} ADS1115_WaitMode_t;
+
+/* MUX setting of single-ended input AINn (n = 0-3) */
+#define ADS1115_MUX_SINGLE_ENDED(n)   ((ADS1115_MUX_t)(ADS1115_MUX_AIN0_GND + ((n) & 0x03)))
+
 /* Configuration structure */
 typedef struct {
     ADS1115_MUX_t channel;           // Input channel selection
@@ -113,19 +129,36 @@ typedef struct ADS1115_Config_Tag {
     I2C_HandleTypeDef *hi2c;
     uint16_t address;
     ADS1115_Config_t config;
+    ADS1115_WaitMode_t waitMode;        // How oneShotMeasure waits for the result
+    volatile uint8_t conversionReady;   // Set from the ALERT/RDY EXTI interrupt
+    uint8_t comparatorGated;            // 1: comparator only evaluates comparatorChannel
+    ADS1115_MUX_t comparatorChannel;
 } ADS1115_Handle_t;
 
 /* Function Prototypes */
+HAL_StatusTypeDef ADS1115_initHandle(ADS1115_Handle_t *pConfig, I2C_HandleTypeDef *hi2c,
+                                     uint16_t Addr, ADS1115_Config_t config);
+#if ADS1115_USE_HEAP
 ADS1115_Handle_t* ADS1115_init(I2C_HandleTypeDef *hi2c, uint16_t Addr, ADS1115_Config_t config);
 void ADS1115_deinit(ADS1115_Handle_t* pConfig);
+#endif
 void ADS1115_updateConfig(ADS1115_Handle_t *pConfig, ADS1115_Config_t config);
 void ADS1115_updateI2Chandler(ADS1115_Handle_t *pConfig, I2C_HandleTypeDef *hi2c);
 void ADS1115_updateAddress(ADS1115_Handle_t *pConfig, uint16_t address);
 int16_t ADS1115_oneShotMeasure(ADS1115_Handle_t *pConfig);
+HAL_StatusTypeDef ADS1115_startConversion(ADS1115_Handle_t *pConfig);
+HAL_StatusTypeDef ADS1115_readConversion(ADS1115_Handle_t *pConfig, int16_t *value);
 int16_t ADS1115_getData(ADS1115_Handle_t *pConfig);
 void ADS1115_setThresholds(ADS1115_Handle_t *pConfig, int16_t lowValue, int16_t highValue);
 void ADS1115_flushData(ADS1115_Handle_t* pConfig);
 void ADS1115_setConversionReadyPin(ADS1115_Handle_t* pConfig);
+void ADS1115_setWaitMode(ADS1115_Handle_t *pConfig, ADS1115_WaitMode_t mode);
+void ADS1115_setComparatorGate(ADS1115_Handle_t *pConfig, uint8_t enable, ADS1115_MUX_t channel);
+void ADS1115_conversionReadyCallback(ADS1115_Handle_t *pConfig);
+uint8_t ADS1115_isConversionReady(ADS1115_Handle_t *pConfig);
+uint32_t ADS1115_getConversionTimeUs(ADS1115_DataRate_t dataRate);
+ADS1115_DataRate_t ADS1115_dataRateFromSps(uint16_t sps);
+uint16_t ADS1115_dataRateToSps(ADS1115_DataRate_t dataRate);
 void ADS1115_startContinousMode(ADS1115_Handle_t *pConfig);
 void ADS1115_stopContinousMode(ADS1115_Handle_t *pConfig);
 
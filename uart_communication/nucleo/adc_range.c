@@ -0,0 +1,177 @@
+/**
+  ******************************************************************************
+  * @file    adc_range.c
+  * @brief   Per-channel automatic PGA ranging for ADS1115 single-shot readings
+  * @date    October 2025
+  ******************************************************************************
+  * With autoranging on, each channel remembers the range its next conversion
+  * uses: the tightest PGA that kept the previous result below
+  * ADC_RANGE_HEADROOM_PCT of full scale. A conversion that clips is repeated
+  * one range wider within the same call, so a step up in signal costs one
+  * extra conversion per range instead of a wrong reading. 1 mA through a
+  * 1 Ohm shunt is ~5 codes at +/-6.144 V and 128 codes at +/-0.256 V.
+  *
+  * Results are codes at the reported range. ADC_Range_ToMicrovolts rescales
+  * them to fractional +/-6.144 V codes, so the stored calibration (which is in
+  * those codes and corrects the external front end) applies at every range.
+  ******************************************************************************
+  */
+
+#include "adc_range.h"
+#include "calibration.h"
+
+/* Full scale of ADS1115_PGA_6V144 .. ADS1115_PGA_0V256 in millivolts */
+static const uint16_t full_scale_mv[6] = {6144, 4096, 2048, 1024, 512, 256};
+
+static uint8_t automatic[4] = {0};
+static ADS1115_PGA_t cached[4] = {
+    ADS1115_PGA_6V144, ADS1115_PGA_6V144, ADS1115_PGA_6V144, ADS1115_PGA_6V144
+};
+
+static ADS1115_PGA_t Tightest(int16_t code, ADS1115_PGA_t pga);
+static int64_t RoundDiv(int64_t numerator, int64_t denominator);
+
+/**
+  * @brief  Switch autoranging for a channel (the cached range restarts at +/-6.144 V)
+  * @param  channel: AIN channel (0-3)
+  * @param  enable: 1 to autorange, 0 for the fixed +/-6.144 V range
+  * @retval None
+  */
+void ADC_Range_SetAuto(uint8_t channel, uint8_t enable)
+{
+    if (channel > 3)
+        return;
+
+    automatic[channel] = enable ? 1 : 0;
+    cached[channel] = ADS1115_PGA_6V144;
+}
+
+/**
+  * @brief  1 if a channel autoranges
+  * @param  channel: AIN channel (0-3)
+  * @retval Autorange flag
+  */
+uint8_t ADC_Range_IsAuto(uint8_t channel)
+{
+    return (channel > 3) ? 0 : automatic[channel];
+}
+
+/**
+  * @brief  Range the next conversion of a channel starts at
+  * @param  channel: AIN channel (0-3)
+  * @retval PGA setting
+  */
+ADS1115_PGA_t ADC_Range_Get(uint8_t channel)
+{
+    return (channel > 3) ? ADS1115_PGA_6V144 : cached[channel];
+}
+
+/**
+  * @brief  Full scale of a PGA setting
+  * @param  pga: PGA setting
+  * @retval Millivolts
+  */
+uint16_t ADC_Range_FullScaleMv(ADS1115_PGA_t pga)
+{
+    return (pga > ADS1115_PGA_0V256) ? 256 : full_scale_mv[pga];
+}
+
+/**
+  * @brief  One single-ended conversion at the channel's range, widened on overflow
+  * @note   The handle's PGA is restored afterwards; its MUX is left on the channel.
+  *         Channels not autoranging convert at +/-6.144 V.
+  * @param  adc: ADS1115 handle
+  * @param  channel: AIN channel (0-3)
+  * @param  pga: Output, range of the returned code (may be NULL)
+  * @retval Raw code at *pga
+  */
+int16_t ADC_Range_Measure(ADS1115_Handle_t *adc, uint8_t channel, ADS1115_PGA_t *pga)
+{
+    ADS1115_PGA_t previous_pga = adc->config.pgaConfig;
+    ADS1115_PGA_t range = ADC_Range_Get(channel);
+    int16_t code;
+
+    adc->config.channel = ADS1115_MUX_SINGLE_ENDED(channel);
+    while (1)
+    {
+        adc->config.pgaConfig = range;
+        code = ADS1115_oneShotMeasure(adc);
+        if ((code < ADC_RANGE_OVERFLOW_CODE && code > -ADC_RANGE_OVERFLOW_CODE) ||
+            range == ADS1115_PGA_6V144)
+            break;
+        range = (ADS1115_PGA_t)(range - 1);
+    }
+    adc->config.pgaConfig = previous_pga;
+
+    if (ADC_Range_IsAuto(channel))
+        cached[channel] = Tightest(code, range);
+    if (pga != NULL)
+        *pga = range;
+    return code;
+}
+
+/**
+  * @brief  Calibrated input voltage of a (possibly filtered) code at a given range
+  * @param  channel: AIN channel (0-3), selects the calibration entry
+  * @param  value: Code at pga with frac_bits fraction bits
+  * @param  frac_bits: Fraction bits of value (0-ADC_RANGE_FINE_BITS)
+  * @param  pga: Range value was converted at
+  * @retval Microvolts
+  */
+int32_t ADC_Range_ToMicrovolts(uint8_t channel, int32_t value, uint8_t frac_bits, ADS1115_PGA_t pga)
+{
+    // Rescale to +/-6.144 V codes with ADC_RANGE_FINE_BITS fraction bits
+    int64_t scaled = (int64_t)value * ADC_Range_FullScaleMv(pga) *
+                     (1 << (ADC_RANGE_FINE_BITS - frac_bits));
+    int32_t fine = (int32_t)RoundDiv(scaled, full_scale_mv[ADS1115_PGA_6V144]);
+
+    fine = Cal_AdcFine(channel, fine, ADC_RANGE_FINE_BITS);
+    return (int32_t)RoundDiv((int64_t)fine * full_scale_mv[ADS1115_PGA_6V144] * 1000,
+                             (int64_t)32768 << ADC_RANGE_FINE_BITS);
+}
+
+/**
+  * @brief  Nominal size of a code span (e.g. a standard deviation) at a given range
+  * @param  value: Span at pga with frac_bits fraction bits
+  * @param  frac_bits: Fraction bits of value
+  * @param  pga: Range
+  * @retval Microvolts
+  */
+uint32_t ADC_Range_SpanMicrovolts(uint32_t value, uint8_t frac_bits, ADS1115_PGA_t pga)
+{
+    return (uint32_t)RoundDiv((int64_t)value * ADC_Range_FullScaleMv(pga) * 1000,
+                              (int64_t)32768 << frac_bits);
+}
+
+/**
+  * @brief  Tightest range that keeps a conversion below the headroom limit
+  * @param  code: Conversion result
+  * @param  pga: Range it was taken at
+  * @retval PGA setting for the next conversion
+  */
+static ADS1115_PGA_t Tightest(int16_t code, ADS1115_PGA_t pga)
+{
+    // Signal in mV * 32768 * 100, compared against full scale * 32768 * headroom
+    uint32_t magnitude = (code < 0) ? (uint32_t)(-(int32_t)code) : (uint32_t)code;
+    uint64_t signal = (uint64_t)magnitude * ADC_Range_FullScaleMv(pga) * 100;
+
+    for (ADS1115_PGA_t range = ADS1115_PGA_0V256; range > ADS1115_PGA_6V144;
+         range = (ADS1115_PGA_t)(range - 1))
+    {
+        if (signal < (uint64_t)full_scale_mv[range] * 32768 * ADC_RANGE_HEADROOM_PCT)
+            return range;
+    }
+    return ADS1115_PGA_6V144;
+}
+
+/**
+  * @brief  Signed division rounded to nearest
+  * @param  numerator: Dividend
+  * @param  denominator: Divisor (> 0)
+  * @retval Quotient
+  */
+static int64_t RoundDiv(int64_t numerator, int64_t denominator)
+{
+    int64_t half = (numerator >= 0) ? denominator / 2 : -(denominator / 2);
+    return (numerator + half) / denominator;
+}
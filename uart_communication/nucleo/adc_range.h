@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file    adc_range.h
+  * @brief   Per-channel automatic PGA ranging for ADS1115 single-shot readings
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_ADC_RANGE_H_
+#define INC_ADC_RANGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "ADS1115.h"
+
+/* A code of this magnitude is taken as clipped and re-converted one range wider */
+#define ADC_RANGE_OVERFLOW_CODE     32767
+
+/* The next reading uses the tightest range whose full scale keeps the last signal
+   below this share of it, so it can grow by a third before clipping */
+#define ADC_RANGE_HEADROOM_PCT      75
+
+/* Fraction bits of the +/-6.144 V codes calibration is applied to (an LSB at
+   the +/-0.256 V range is 1/24 of a +/-6.144 V code) */
+#define ADC_RANGE_FINE_BITS         8
+
+/* Function Prototypes */
+void ADC_Range_SetAuto(uint8_t channel, uint8_t enable);
+uint8_t ADC_Range_IsAuto(uint8_t channel);
+ADS1115_PGA_t ADC_Range_Get(uint8_t channel);
+uint16_t ADC_Range_FullScaleMv(ADS1115_PGA_t pga);
+int16_t ADC_Range_Measure(ADS1115_Handle_t *adc, uint8_t channel, ADS1115_PGA_t *pga);
+int32_t ADC_Range_ToMicrovolts(uint8_t channel, int32_t value, uint8_t frac_bits, ADS1115_PGA_t pga);
+uint32_t ADC_Range_SpanMicrovolts(uint32_t value, uint8_t frac_bits, ADS1115_PGA_t pga);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_ADC_RANGE_H_ */
@@ -0,0 +1,288 @@
+/**
+  ******************************************************************************
+  * @file    adc_stream.c
+  * @brief   Continuous-mode ADS1115 acquisition into a double-buffered RAM block
+  * @date    October 2025
+  ******************************************************************************
+  * The ADS1115 free-runs in continuous mode. Each conversion is read into the
+  * block being filled; when it is full the fill side switches to the other
+  * block and the main loop ships the full one. Samples are taken either:
+  *  - on the ALERT/RDY falling edge, with an interrupt-driven I2C read, or
+  *  - from the main loop, paced by the nominal conversion period.
+  * A sample that finds both blocks full is dropped and counted as an overrun.
+  * A paced stream the main loop fell a period or more behind on skips the missed
+  * slots rather than reading the same conversion back to back.
+  * Samples are stored calibrated (calibration.c). Each block keeps the time
+  * its first sample became ready; the rest follow at the data rate.
+  ******************************************************************************
+  */
+
+#include "adc_stream.h"
+#include "calibration.h"
+#include "smu_stats.h"
+
+static ADS1115_Handle_t *stream_adc = NULL;
+
+static int16_t blocks[2][ADC_STREAM_BLOCK_SAMPLES];
+static volatile uint16_t block_count[2];     // Samples in each block
+static volatile uint8_t block_full[2];       // Set when block waits for the main loop
+static volatile uint32_t block_time[2];      // Ready time of each block's first sample (us)
+static volatile uint8_t fill_block = 0;      // Block currently being filled
+static uint8_t send_block = 0;               // Next block the main loop ships
+static uint16_t block_size = ADC_STREAM_BLOCK_SAMPLES;
+
+static volatile uint32_t samples_left = 0;
+static volatile uint32_t overruns = 0;
+static volatile uint8_t active = 0;
+static volatile uint8_t read_pending = 0;
+static uint8_t use_rdy = 0;
+static uint8_t cal_channel = 0;
+static uint8_t read_bytes[2];
+static uint32_t ready_us = 0;                // RDY edge time of the pending read
+
+static uint32_t period_us = 0;
+static uint32_t next_sample_us = 0;
+
+static void StoreSample(int16_t sample, uint32_t now_us);
+
+/**
+  * @brief  Put the ADC in continuous mode and start collecting samples
+  * @param  adc: ADS1115 handle
+  * @param  channel: MUX setting to stream
+  * @param  calChannel: Calibration channel applied to the samples (Cal_AdcCode,
+  *         anything above 3 stores raw codes)
+  * @param  dataRate: Conversion rate
+  * @param  count: Number of samples to collect (> 0)
+  * @param  useRdyPin: 1 to sample on ALERT/RDY interrupts, 0 to pace from the main loop
+  * @param  now_us: Current time in microseconds
+  * @retval HAL status
+  */
+HAL_StatusTypeDef ADC_Stream_Start(ADS1115_Handle_t *adc, ADS1115_MUX_t channel,
+                                   uint8_t calChannel, ADS1115_DataRate_t dataRate, uint32_t count,
+                                   uint8_t useRdyPin, uint32_t now_us)
+{
+    if (adc == NULL || count == 0)
+        return HAL_ERROR;
+
+    stream_adc = adc;
+    cal_channel = calChannel;
+    stream_adc->config.channel = channel;
+    stream_adc->config.dataRate = dataRate;
+
+    // ~16 blocks per second keeps latency low at slow rates and overhead low at fast ones
+    block_size = ADS1115_dataRateToSps(dataRate) / 16;
+    if (block_size < 1)
+        block_size = 1;
+    if (block_size > ADC_STREAM_BLOCK_SAMPLES)
+        block_size = ADC_STREAM_BLOCK_SAMPLES;
+
+    block_count[0] = block_count[1] = 0;
+    block_full[0] = block_full[1] = 0;
+    fill_block = 0;
+    send_block = 0;
+    overruns = 0;
+    read_pending = 0;
+    samples_left = count;
+    use_rdy = useRdyPin;
+
+    period_us = ADS1115_getConversionTimeUs(dataRate);
+    // First result is available one conversion after the mode switch
+    next_sample_us = now_us + period_us;
+
+    active = 1;
+    ADS1115_startContinousMode(stream_adc);
+    return HAL_OK;
+}
+
+/**
+  * @brief  Return the ADC to single-shot mode
+  * @note   Blocks with samples stay available to ADC_Stream_GetBlock
+  * @retval None
+  */
+void ADC_Stream_Stop(void)
+{
+    active = 0;
+
+    // Let an in-flight interrupt read finish before using the bus
+    while (read_pending) {}
+
+    if (stream_adc != NULL)
+        ADS1115_stopContinousMode(stream_adc);
+
+    // Hand over the partially filled block
+    uint8_t block = fill_block;
+    if (block_count[block] > 0 && !block_full[block])
+        block_full[block] = 1;
+}
+
+/**
+  * @brief  Check whether samples are still being collected
+  */
+uint8_t ADC_Stream_IsActive(void)
+{
+    return active;
+}
+
+/**
+  * @brief  Check whether the requested number of samples has been collected
+  */
+uint8_t ADC_Stream_IsDone(void)
+{
+    return samples_left == 0;
+}
+
+/**
+  * @brief  Main loop service: take paced samples when not using the RDY pin
+  * @note   Called a period or more late it takes one sample and restarts the pacing
+  *         from now_us, counting STATS_STREAM_SKIPS
+  * @param  now_us: Current time in microseconds
+  * @retval None
+  */
+void ADC_Stream_Poll(uint32_t now_us)
+{
+    if (!active || use_rdy)
+        return;
+
+    if ((int32_t)(now_us - next_sample_us) >= 0)
+    {
+        if (now_us - next_sample_us >= period_us)
+        {
+            next_sample_us = now_us + period_us;
+            Stats_Count(STATS_STREAM_SKIPS);
+        }
+        else
+            next_sample_us += period_us;
+        StoreSample(ADS1115_getData(stream_adc), now_us);
+    }
+}
+
+/**
+  * @brief  Get the next full block to ship
+  * @param  count: Set to the number of samples in the block
+  * @retval Pointer to samples, or NULL if no block is ready
+  */
+const int16_t* ADC_Stream_GetBlock(uint16_t *count)
+{
+    if (!block_full[send_block])
+        return NULL;
+
+    *count = block_count[send_block];
+    return blocks[send_block];
+}
+
+/**
+  * @brief  Time the first sample of the block returned by ADC_Stream_GetBlock was ready
+  * @retval Microseconds on the time base passed to ADC_Stream_Poll / ADC_Stream_OnReady
+  */
+uint32_t ADC_Stream_GetBlockTime(void)
+{
+    return block_time[send_block];
+}
+
+/**
+  * @brief  Give the block returned by ADC_Stream_GetBlock back to the fill side
+  * @retval None
+  */
+void ADC_Stream_ReleaseBlock(void)
+{
+    block_count[send_block] = 0;
+    __DMB();
+    block_full[send_block] = 0;
+    send_block ^= 1;
+}
+
+/**
+  * @brief  Number of samples dropped because both blocks were full
+  */
+uint32_t ADC_Stream_GetOverruns(void)
+{
+    return overruns;
+}
+
+/**
+  * @brief  ALERT/RDY falling edge: start reading the conversion register
+  * @note   Call from the EXTI callback
+  * @param  now_us: Current time in microseconds
+  * @retval None
+  */
+void ADC_Stream_OnReady(uint32_t now_us)
+{
+    if (!active || !use_rdy)
+        return;
+
+    if (read_pending ||
+        HAL_I2C_Mem_Read_IT(stream_adc->hi2c, (stream_adc->address << 1), ADS1115_REG_CONVERSION,
+                            I2C_MEMADD_SIZE_8BIT, read_bytes, 2) != HAL_OK)
+    {
+        // Previous read still running, this conversion is lost
+        overruns++;
+        return;
+    }
+    ready_us = now_us;
+    read_pending = 1;
+}
+
+/**
+  * @brief  Interrupt-driven conversion read finished
+  * @note   Call from HAL_I2C_MemRxCpltCallback
+  * @param  hi2c: I2C handle that completed
+  * @retval None
+  */
+void ADC_Stream_OnReadComplete(I2C_HandleTypeDef *hi2c)
+{
+    if (stream_adc == NULL || hi2c != stream_adc->hi2c || !read_pending)
+        return;
+
+    read_pending = 0;
+    StoreSample((int16_t)((read_bytes[0] << 8) | read_bytes[1]), ready_us);
+}
+
+/**
+  * @brief  Interrupt-driven conversion read failed
+  * @note   Call from HAL_I2C_ErrorCallback
+  * @param  hi2c: I2C handle that failed
+  * @retval None
+  */
+void ADC_Stream_OnReadError(I2C_HandleTypeDef *hi2c)
+{
+    if (stream_adc == NULL || hi2c != stream_adc->hi2c || !read_pending)
+        return;
+
+    read_pending = 0;
+    overruns++;
+}
+
+/**
+  * @brief  Append one sample to the fill block, switching blocks when full
+  * @param  sample: Raw conversion result
+  * @param  now_us: Time the sample was ready
+  * @retval None
+  */
+static void StoreSample(int16_t sample, uint32_t now_us)
+{
+    if (samples_left == 0)
+        return;
+
+    uint8_t block = fill_block;
+    if (block_full[block])
+    {
+        // Main loop has not shipped this block yet
+        overruns++;
+        return;
+    }
+
+    if (block_count[block] == 0)
+        block_time[block] = now_us;
+    blocks[block][block_count[block]++] =
+        Cal_AdcCode(cal_channel, sample);
+    samples_left--;
+
+    if (block_count[block] >= block_size || samples_left == 0)
+    {
+        block_full[block] = 1;
+        fill_block = block ^ 1;
+    }
+
+    if (samples_left == 0)
+        active = 0;
+}
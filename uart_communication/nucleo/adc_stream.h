@@ -0,0 +1,44 @@
+/**
+  ******************************************************************************
+  * @file    adc_stream.h
+  * @brief   Continuous-mode ADS1115 acquisition into a double-buffered RAM block
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_ADC_STREAM_H_
+#define INC_ADC_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "ADS1115.h"
+
+/* Largest block; actual block size is chosen so a block spans ~60 ms */
+#define ADC_STREAM_BLOCK_SAMPLES    128
+
+/* Function Prototypes */
+HAL_StatusTypeDef ADC_Stream_Start(ADS1115_Handle_t *adc, ADS1115_MUX_t channel,
+                                   uint8_t calChannel, ADS1115_DataRate_t dataRate, uint32_t count,
+                                   uint8_t useRdyPin, uint32_t now_us);
+void ADC_Stream_Stop(void);
+uint8_t ADC_Stream_IsActive(void);
+uint8_t ADC_Stream_IsDone(void);
+void ADC_Stream_Poll(uint32_t now_us);
+const int16_t* ADC_Stream_GetBlock(uint16_t *count);
+uint32_t ADC_Stream_GetBlockTime(void);
+void ADC_Stream_ReleaseBlock(void);
+uint32_t ADC_Stream_GetOverruns(void);
+
+/* Call from the matching interrupt callbacks */
+void ADC_Stream_OnReady(uint32_t now_us);
+void ADC_Stream_OnReadComplete(I2C_HandleTypeDef *hi2c);
+void ADC_Stream_OnReadError(I2C_HandleTypeDef *hi2c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_ADC_STREAM_H_ */
@@ -0,0 +1,377 @@
+/**
+  ******************************************************************************
+  * @file    calibration.c
+  * @brief   Per-channel ADC/DAC calibration (gain/offset or piecewise-linear LUT) in flash
+  * @date    October 2025
+  ******************************************************************************
+  * Corrections work on codes, so every path that moves codes (ASCII volts,
+  * binary replies, streams, the CC loop) sees calibrated values without the
+  * host correcting each sample. ADC entries map the raw conversion to the code
+  * an ideal ADS1115 would return; DAC entries map the requested code (ideal
+  * 5 V / 4096 scale) to the code that produces that output. All math is
+  * integer: Q16 gain plus offset, or linear interpolation between breakpoints.
+  * Identity entries return their input unchanged, so uncalibrated channels
+  * cost one comparison. The table lives in its own flash sector with a magic,
+  * version and CRC; a blank or corrupt sector boots with identity entries.
+  ******************************************************************************
+  */
+
+#include "calibration.h"
+#include "smu_protocol.h"
+#include <stddef.h>
+#include <string.h>
+
+#define CAL_MAGIC                   0x314C4143U  // "CAL1"
+#define CAL_VERSION                 1
+#define CAL_GAIN_MAX_Q16            (4 * CAL_GAIN_ONE_Q16)
+
+/* Flash image; length is a multiple of 4 for word programming */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    Cal_Channel_t channel[2][4];        // [Cal_Target_t][channel]
+    uint32_t crc;                       // Proto_CRC16 over everything before it
+} Cal_Image_t;
+
+static Cal_Image_t image;
+static uint8_t identity[2][4];
+
+static void SetIdentity(Cal_Channel_t *cal);
+static void UpdateIdentity(void);
+static uint32_t ImageCRC(const Cal_Image_t *img);
+static int32_t Apply(const Cal_Channel_t *cal, int32_t value, uint8_t frac_bits);
+static int32_t Invert(const Cal_Channel_t *cal, int32_t value);
+static int32_t Interpolate(const int16_t *x, const int16_t *y, uint8_t points, int32_t value,
+                           uint8_t frac_bits);
+
+/**
+  * @brief  Load the calibration from flash, identity entries if none is stored
+  * @retval 1 if a valid table was loaded, 0 if running uncalibrated
+  */
+uint8_t Cal_Init(void)
+{
+    if (Cal_Load() == HAL_OK)
+        return 1;
+    Cal_Reset();
+    return 0;
+}
+
+/**
+  * @brief  Set a channel's gain and offset (clears its LUT)
+  * @param  target: CAL_ADC or CAL_DAC
+  * @param  channel: Channel (0-3)
+  * @param  gain_q16: Gain in Q16 (1 to 4.0)
+  * @param  offset: Offset in output codes (-32768 to 32767)
+  * @retval HAL_OK, HAL_ERROR for a bad argument
+  */
+HAL_StatusTypeDef Cal_SetLinear(Cal_Target_t target, uint8_t channel, int32_t gain_q16, int32_t offset)
+{
+    if (target > CAL_DAC || channel > 3 || gain_q16 <= 0 || gain_q16 > CAL_GAIN_MAX_Q16 ||
+        offset < INT16_MIN || offset > INT16_MAX)
+        return HAL_ERROR;
+
+    Cal_Channel_t *cal = &image.channel[target][channel];
+    cal->gain_q16 = gain_q16;
+    cal->offset = offset;
+    cal->points = 0;
+    UpdateIdentity();
+    return HAL_OK;
+}
+
+/**
+  * @brief  Set one LUT breakpoint
+  * @note   Index 0 starts a new table; points must follow in order with input and
+  *         output strictly ascending. The table is used from its second point on.
+  * @param  target: CAL_ADC or CAL_DAC
+  * @param  channel: Channel (0-3)
+  * @param  index: Breakpoint (0-CAL_LUT_POINTS-1), at most the current point count
+  * @param  in: Input code
+  * @param  out: Output code
+  * @retval HAL_OK, HAL_ERROR for a bad argument or out-of-order point
+  */
+HAL_StatusTypeDef Cal_SetPoint(Cal_Target_t target, uint8_t channel, uint8_t index,
+                               int16_t in, int16_t out)
+{
+    if (target > CAL_DAC || channel > 3 || index >= CAL_LUT_POINTS)
+        return HAL_ERROR;
+
+    Cal_Channel_t *cal = &image.channel[target][channel];
+    if (index > cal->points)
+        return HAL_ERROR;
+    if (index > 0 && (in <= cal->lut_in[index - 1] || out <= cal->lut_out[index - 1]))
+        return HAL_ERROR;
+
+    cal->lut_in[index] = in;
+    cal->lut_out[index] = out;
+    cal->points = index + 1;
+    UpdateIdentity();
+    return HAL_OK;
+}
+
+/**
+  * @brief  Copy a channel's entry
+  * @param  target: CAL_ADC or CAL_DAC
+  * @param  channel: Channel (0-3)
+  * @param  cal: Output
+  * @retval HAL_OK, HAL_ERROR for a bad argument
+  */
+HAL_StatusTypeDef Cal_Get(Cal_Target_t target, uint8_t channel, Cal_Channel_t *cal)
+{
+    if (target > CAL_DAC || channel > 3)
+        return HAL_ERROR;
+    *cal = image.channel[target][channel];
+    return HAL_OK;
+}
+
+/**
+  * @brief  Reset every entry to identity (flash is unchanged until Cal_Save)
+  * @retval None
+  */
+void Cal_Reset(void)
+{
+    memset(&image, 0, sizeof(image));
+    for (uint8_t target = 0; target < 2; target++)
+    {
+        for (uint8_t ch = 0; ch < 4; ch++)
+        {
+            SetIdentity(&image.channel[target][ch]);
+        }
+    }
+    UpdateIdentity();
+}
+
+/**
+  * @brief  Write the table to flash
+  * @note   Erasing the sector stalls the CPU for up to ~2 s (flash reads wait); the
+  *         UART keeps receiving into its DMA ring meanwhile.
+  * @retval HAL status of the erase/program sequence
+  */
+HAL_StatusTypeDef Cal_Save(void)
+{
+    image.magic = CAL_MAGIC;
+    image.version = CAL_VERSION;
+    image.size = sizeof(image);
+    image.crc = ImageCRC(&image);
+
+    FLASH_EraseInitTypeDef erase = {0};
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = CAL_FLASH_SECTOR;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+    uint32_t sector_error = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+
+    const uint8_t *src = (const uint8_t*)&image;
+    for (uint32_t i = 0; status == HAL_OK && i < sizeof(image); i += 4)
+    {
+        uint32_t word;
+        memcpy(&word, src + i, sizeof(word));
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, CAL_FLASH_ADDR + i, word);
+    }
+    HAL_FLASH_Lock();
+
+    if (status == HAL_OK && memcmp((const void*)CAL_FLASH_ADDR, &image, sizeof(image)) != 0)
+        status = HAL_ERROR;
+    return status;
+}
+
+/**
+  * @brief  Replace the table with the one stored in flash
+  * @retval HAL_OK, HAL_ERROR if flash holds no valid table (the current one is kept)
+  */
+HAL_StatusTypeDef Cal_Load(void)
+{
+    const Cal_Image_t *stored = (const Cal_Image_t*)CAL_FLASH_ADDR;
+
+    if (stored->magic != CAL_MAGIC || stored->version != CAL_VERSION ||
+        stored->size != sizeof(Cal_Image_t) || stored->crc != ImageCRC(stored))
+        return HAL_ERROR;
+
+    memcpy(&image, stored, sizeof(image));
+    UpdateIdentity();
+    return HAL_OK;
+}
+
+/**
+  * @brief  Correct a raw ADS1115 code
+  * @param  channel: AIN channel (0-3)
+  * @param  raw: Conversion result
+  * @retval Calibrated code, saturated to int16
+  */
+int16_t Cal_AdcCode(uint8_t channel, int16_t raw)
+{
+    if (channel > 3 || identity[CAL_ADC][channel])
+        return raw;
+
+    int32_t code = Apply(&image.channel[CAL_ADC][channel], raw, 0);
+    if (code > INT16_MAX)
+        return INT16_MAX;
+    if (code < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)code;
+}
+
+/**
+  * @brief  Correct a fractional ADC value (autoranged conversions rescaled to the
+  *         +/-6.144 V code range)
+  * @param  channel: AIN channel (0-3)
+  * @param  value: Raw value in +/-6.144 V codes with frac_bits fraction bits
+  * @param  frac_bits: Fraction bits of value and of the result (0-12)
+  * @retval Calibrated value, same scaling (not saturated)
+  */
+int32_t Cal_AdcFine(uint8_t channel, int32_t value, uint8_t frac_bits)
+{
+    if (channel > 3 || identity[CAL_ADC][channel])
+        return value;
+
+    return Apply(&image.channel[CAL_ADC][channel], value, frac_bits);
+}
+
+/**
+  * @brief  Raw ADS1115 code that calibrates to a given code (for comparator thresholds)
+  * @param  channel: AIN channel (0-3)
+  * @param  code: Calibrated code
+  * @retval Raw code, saturated to int16
+  */
+int16_t Cal_AdcRaw(uint8_t channel, int16_t code)
+{
+    if (channel > 3 || identity[CAL_ADC][channel])
+        return code;
+
+    int32_t raw = Invert(&image.channel[CAL_ADC][channel], code);
+    if (raw > INT16_MAX)
+        return INT16_MAX;
+    if (raw < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)raw;
+}
+
+/**
+  * @brief  Correct a requested DAC code
+  * @param  channel: DAC channel (0-3)
+  * @param  code: Requested code (0-4095)
+  * @retval Code to write, saturated to 0-4095
+  */
+uint16_t Cal_DacCode(uint8_t channel, uint16_t code)
+{
+    if (channel > 3 || identity[CAL_DAC][channel])
+        return code;
+
+    int32_t out = Apply(&image.channel[CAL_DAC][channel], code, 0);
+    if (out > 4095)
+        return 4095;
+    if (out < 0)
+        return 0;
+    return (uint16_t)out;
+}
+
+/**
+  * @brief  Correct several requested DAC codes in place
+  * @param  values: Four codes (A-D)
+  * @param  mask: Channels to correct, bit n selects channel n
+  * @retval None
+  */
+void Cal_DacCodes(uint16_t values[4], uint8_t mask)
+{
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if (mask & (1 << ch))
+            values[ch] = Cal_DacCode(ch, values[ch]);
+    }
+}
+
+/**
+  * @brief  Identity entry: unity gain, no offset, no LUT
+  * @param  cal: Entry to reset
+  * @retval None
+  */
+static void SetIdentity(Cal_Channel_t *cal)
+{
+    memset(cal, 0, sizeof(*cal));
+    cal->gain_q16 = CAL_GAIN_ONE_Q16;
+}
+
+/**
+  * @brief  Refresh the per-channel identity flags after a change
+  * @retval None
+  */
+static void UpdateIdentity(void)
+{
+    for (uint8_t target = 0; target < 2; target++)
+    {
+        for (uint8_t ch = 0; ch < 4; ch++)
+        {
+            const Cal_Channel_t *cal = &image.channel[target][ch];
+            identity[target][ch] = (cal->points < 2 && cal->gain_q16 == CAL_GAIN_ONE_Q16 &&
+                                    cal->offset == 0);
+        }
+    }
+}
+
+/**
+  * @brief  CRC of an image, excluding its crc field
+  * @param  img: Image
+  * @retval CRC-16 (in a 32-bit field)
+  */
+static uint32_t ImageCRC(const Cal_Image_t *img)
+{
+    return Proto_CRC16(0xFFFF, (const uint8_t*)img, (uint16_t)offsetof(Cal_Image_t, crc));
+}
+
+/**
+  * @brief  Apply an entry: LUT interpolation, else gain and offset (rounded)
+  * @param  cal: Entry
+  * @param  value: Input code with frac_bits fraction bits
+  * @param  frac_bits: Fraction bits of value and of the result
+  * @retval Output code (not saturated)
+  */
+static int32_t Apply(const Cal_Channel_t *cal, int32_t value, uint8_t frac_bits)
+{
+    if (cal->points >= 2)
+        return Interpolate(cal->lut_in, cal->lut_out, cal->points, value, frac_bits);
+
+    return (int32_t)(((int64_t)value * cal->gain_q16 + (1 << 15)) >> 16) +
+           cal->offset * (1 << frac_bits);
+}
+
+/**
+  * @brief  Inverse of Apply (both directions are strictly increasing)
+  * @param  cal: Entry
+  * @param  value: Output code
+  * @retval Input code (not saturated)
+  */
+static int32_t Invert(const Cal_Channel_t *cal, int32_t value)
+{
+    if (cal->points >= 2)
+        return Interpolate(cal->lut_out, cal->lut_in, cal->points, value, 0);
+
+    int64_t numerator = ((int64_t)(value - cal->offset) << 16);
+    int64_t half = (numerator >= 0) ? cal->gain_q16 / 2 : -(cal->gain_q16 / 2);
+    return (int32_t)((numerator + half) / cal->gain_q16);
+}
+
+/**
+  * @brief  Piecewise-linear interpolation, extrapolating from the end segments
+  * @param  x: Strictly ascending breakpoints
+  * @param  y: Values at the breakpoints
+  * @param  points: Number of breakpoints (>= 2)
+  * @param  value: Input with frac_bits fraction bits (breakpoints are whole codes)
+  * @param  frac_bits: Fraction bits of value and of the result
+  * @retval Interpolated value, rounded to nearest
+  */
+static int32_t Interpolate(const int16_t *x, const int16_t *y, uint8_t points, int32_t value,
+                           uint8_t frac_bits)
+{
+    int32_t one = 1 << frac_bits;
+    uint8_t i = 1;
+    while (i < points - 1 && value > x[i] * one)
+        i++;
+
+    int32_t dx = (int32_t)x[i] - x[i - 1];
+    int64_t numerator = (int64_t)(value - x[i - 1] * one) * ((int32_t)y[i] - y[i - 1]);
+    int64_t half = (numerator >= 0) ? dx / 2 : -(dx / 2);
+    return y[i - 1] * one + (int32_t)((numerator + half) / dx);
+}
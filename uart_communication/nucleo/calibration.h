@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file    calibration.h
+  * @brief   Per-channel ADC/DAC calibration (gain/offset or piecewise-linear LUT) in flash
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_CALIBRATION_H_
+#define INC_CALIBRATION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Flash sector holding the calibration (STM32F446RE sector 7, last 128 KB); the
+   application image must end below CAL_FLASH_ADDR */
+#ifndef CAL_FLASH_SECTOR
+#define CAL_FLASH_SECTOR            FLASH_SECTOR_7
+#define CAL_FLASH_ADDR              0x08060000U
+#endif
+
+/* Breakpoints per channel table */
+#define CAL_LUT_POINTS              8
+
+/* Unity gain in Q16 */
+#define CAL_GAIN_ONE_Q16            65536
+
+/* Converter a calibration entry belongs to */
+typedef enum {
+    CAL_ADC = 0,    // Raw conversion code -> corrected code
+    CAL_DAC = 1     // Requested code -> code written to the MCP4728
+} Cal_Target_t;
+
+/* One channel's correction. With 2 or more LUT points the table is interpolated
+   (and extrapolated from its end segments) instead of applying gain and offset. */
+typedef struct {
+    int32_t gain_q16;                   // Output codes per input code, Q16
+    int32_t offset;                     // Codes added after the gain
+    uint8_t points;                     // LUT points in use (0-CAL_LUT_POINTS)
+    int16_t lut_in[CAL_LUT_POINTS];     // Strictly ascending input codes
+    int16_t lut_out[CAL_LUT_POINTS];    // Strictly ascending output codes
+} Cal_Channel_t;
+
+/* Function Prototypes */
+uint8_t Cal_Init(void);
+HAL_StatusTypeDef Cal_SetLinear(Cal_Target_t target, uint8_t channel, int32_t gain_q16, int32_t offset);
+HAL_StatusTypeDef Cal_SetPoint(Cal_Target_t target, uint8_t channel, uint8_t index,
+                               int16_t in, int16_t out);
+HAL_StatusTypeDef Cal_Get(Cal_Target_t target, uint8_t channel, Cal_Channel_t *cal);
+void Cal_Reset(void);
+HAL_StatusTypeDef Cal_Save(void);
+HAL_StatusTypeDef Cal_Load(void);
+
+int16_t Cal_AdcCode(uint8_t channel, int16_t raw);
+int32_t Cal_AdcFine(uint8_t channel, int32_t value, uint8_t frac_bits);
+int16_t Cal_AdcRaw(uint8_t channel, int16_t code);
+uint16_t Cal_DacCode(uint8_t channel, uint16_t code);
+void Cal_DacCodes(uint16_t values[4], uint8_t mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CALIBRATION_H_ */
@@ -0,0 +1,194 @@
+/**
+  ******************************************************************************
+  * @file    cc_loop.c
+  * @brief   Fixed-point PI constant-current regulation (DAC channel n, shunt on AINn)
+  * @date    October 2025
+  ******************************************************************************
+  * Each CC_Poll() takes one single-shot conversion of the shunt channel at
+  * 860 SPS and updates the DAC, so the loop runs at the ADC data rate whenever
+  * the main loop is idle. The setpoint is converted to ADC codes once, in
+  * CC_Start, and the controller works on codes: error is in ADC codes, the
+  * integrator and output are Q16 DAC codes. The integrator is clamped to
+  * [0, max_code] (compliance limit), so it does not wind up while the load
+  * cannot reach the setpoint. The loop owns its DAC channel while active.
+  ******************************************************************************
+  */
+
+#include "cc_loop.h"
+#include "mcp4728.h"
+#include "calibration.h"
+
+static uint32_t shunt[4] = {
+    CC_DEFAULT_SHUNT_MOHM, CC_DEFAULT_SHUNT_MOHM,
+    CC_DEFAULT_SHUNT_MOHM, CC_DEFAULT_SHUNT_MOHM
+};
+static int32_t gain_kp = CC_DEFAULT_KP_Q16;
+static int32_t gain_ki = CC_DEFAULT_KI_Q16;
+
+static I2C_HandleTypeDef *cc_i2c = NULL;
+static ADS1115_Handle_t *cc_adc = NULL;
+static uint16_t limit_code = 4095;
+static int64_t integrator = 0;  // Q16 DAC code
+static CC_Status_t state = {0};
+
+/**
+  * @brief  Set the shunt resistance used to convert the current setpoint
+  * @param  channel: Channel (0-3)
+  * @param  shunt_mohm: Shunt resistance in milliohms (> 0)
+  * @retval HAL_OK, HAL_ERROR for a bad argument, HAL_BUSY for a new value while the
+  *         channel regulates
+  */
+HAL_StatusTypeDef CC_SetShunt(uint8_t channel, uint32_t shunt_mohm)
+{
+    if (channel > 3 || shunt_mohm == 0)
+        return HAL_ERROR;
+    if (shunt[channel] == shunt_mohm)
+        return HAL_OK;
+    if (state.active && state.channel == channel)
+        return HAL_BUSY;
+
+    shunt[channel] = shunt_mohm;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Shunt resistance of a channel
+  * @param  channel: Channel (0-3)
+  * @retval Milliohms, 0 for a bad channel
+  */
+uint32_t CC_GetShunt(uint8_t channel)
+{
+    return (channel > 3) ? 0 : shunt[channel];
+}
+
+/**
+  * @brief  Set the PI gains (takes effect on the next iteration)
+  * @param  kp_q16: Proportional gain, Q16 DAC codes per ADC code
+  * @param  ki_q16: Integral gain, Q16 DAC codes per ADC code per conversion
+  * @retval None
+  */
+void CC_SetGains(int32_t kp_q16, int32_t ki_q16)
+{
+    gain_kp = kp_q16;
+    gain_ki = ki_q16;
+}
+
+/**
+  * @brief  Start regulating a channel's shunt current
+  * @note   The integrator starts from the channel's present DAC code, so switching
+  *         the loop on does not step the output.
+  * @param  hi2c: MCP4728 bus
+  * @param  adc: ADS1115 handle
+  * @param  channel: DAC channel driving the load, AIN of the same number reads its shunt
+  * @param  target_ua: Setpoint in microamps (>= 0)
+  * @param  max_code: Compliance limit, highest DAC code the loop may write (1-4095)
+  * @retval HAL_OK, HAL_ERROR for a bad argument or a setpoint beyond the ADC range
+  */
+HAL_StatusTypeDef CC_Start(I2C_HandleTypeDef *hi2c, ADS1115_Handle_t *adc, uint8_t channel,
+                           int32_t target_ua, uint16_t max_code)
+{
+    if (hi2c == NULL || adc == NULL || channel > 3 || target_ua < 0 ||
+        max_code == 0 || max_code > 4095)
+        return HAL_ERROR;
+
+    // uA * mOhm = nV
+    int64_t target = ((int64_t)target_ua * shunt[channel] + CC_ADC_LSB_NV / 2) / CC_ADC_LSB_NV;
+    if (target > INT16_MAX)
+        return HAL_ERROR;
+
+    uint16_t start_code = MCP4728_GetChannel((MCP4728_Channel)channel);
+    if (start_code > max_code)
+        start_code = max_code;
+
+    cc_i2c = hi2c;
+    cc_adc = adc;
+    limit_code = max_code;
+    integrator = (int64_t)start_code << 16;
+
+    state.channel = channel;
+    state.target_code = (int16_t)target;
+    state.adc_code = 0;
+    state.dac_code = start_code;
+    state.compliance = 0;
+    state.iterations = 0;
+    state.active = 1;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop regulating; the DAC keeps the last written code (callable from an ISR)
+  * @retval None
+  */
+void CC_Stop(void)
+{
+    state.active = 0;
+}
+
+/**
+  * @brief  1 while a channel is regulated
+  * @retval Active flag
+  */
+uint8_t CC_IsActive(void)
+{
+    return state.active;
+}
+
+/**
+  * @brief  Copy the loop state
+  * @param  status: Output
+  * @retval None
+  */
+void CC_GetStatus(CC_Status_t *status)
+{
+    *status = state;
+}
+
+/**
+  * @brief  One loop iteration: convert the shunt voltage, update the PI output, write the DAC
+  * @note   The ADC channel and data rate are restored afterwards, so commands between
+  *         iterations see the configuration they set.
+  * @retval None
+  */
+void CC_Poll(void)
+{
+    if (!state.active)
+        return;
+
+    ADS1115_MUX_t previous_channel = cc_adc->config.channel;
+    ADS1115_DataRate_t previous_rate = cc_adc->config.dataRate;
+
+    cc_adc->config.channel = ADS1115_MUX_SINGLE_ENDED(state.channel);
+    cc_adc->config.dataRate = ADS1115_DR_860SPS;
+    int16_t measured = Cal_AdcCode(state.channel, ADS1115_oneShotMeasure(cc_adc));
+    cc_adc->config.channel = previous_channel;
+    cc_adc->config.dataRate = previous_rate;
+
+    // Stopped from an interrupt (current limit trip) during the conversion
+    if (!state.active)
+        return;
+
+    int32_t error = (int32_t)state.target_code - measured;
+    int64_t upper = (int64_t)limit_code << 16;
+
+    // Anti-windup: the integrator never leaves the output range
+    integrator += (int64_t)gain_ki * error;
+    if (integrator < 0)
+        integrator = 0;
+    else if (integrator > upper)
+        integrator = upper;
+
+    int64_t output = integrator + (int64_t)gain_kp * error;
+    if (output < 0)
+        output = 0;
+    else if (output > upper)
+        output = upper;
+
+    uint16_t code = (uint16_t)((output + (1 << 15)) >> 16);
+    if (code != state.dac_code)
+        MCP4728_WriteChannel(cc_i2c, (MCP4728_Channel)state.channel, code);
+
+    state.adc_code = measured;
+    state.dac_code = code;
+    state.compliance = (code >= limit_code && error > 0) ? 1 : 0;
+    state.iterations++;
+}
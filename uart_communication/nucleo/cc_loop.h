@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    cc_loop.h
+  * @brief   Fixed-point PI constant-current regulation (DAC channel n, shunt on AINn)
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_CC_LOOP_H_
+#define INC_CC_LOOP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "ADS1115.h"
+
+/* ADC LSB at the +/-6.144 V PGA in nanovolts (6.144 V / 32768) */
+#define CC_ADC_LSB_NV               187500
+
+/* Default shunt per channel, matches the host's default of 1 Ohm */
+#define CC_DEFAULT_SHUNT_MOHM       1000
+
+/* Default gains in Q16 DAC codes per ADC code of error. With a 5 V DAC one DAC code
+   moves the shunt voltage by at most ~6.5 ADC codes, so ki below ~0.15 stays stable
+   for any load. */
+#define CC_DEFAULT_KP_Q16           3277    // 0.05
+#define CC_DEFAULT_KI_Q16           6554    // 0.1 per conversion
+
+/* Loop state for "cc_status" */
+typedef struct {
+    uint8_t active;
+    uint8_t channel;
+    int16_t target_code;    // Shunt voltage setpoint in ADC codes
+    int16_t adc_code;       // Last shunt conversion
+    uint16_t dac_code;      // Last DAC output
+    uint8_t compliance;     // 1 while the output is pinned at max_code below the setpoint
+    uint32_t iterations;    // Conversions since CC_Start
+} CC_Status_t;
+
+/* Function Prototypes */
+HAL_StatusTypeDef CC_SetShunt(uint8_t channel, uint32_t shunt_mohm);
+uint32_t CC_GetShunt(uint8_t channel);
+void CC_SetGains(int32_t kp_q16, int32_t ki_q16);
+HAL_StatusTypeDef CC_Start(I2C_HandleTypeDef *hi2c, ADS1115_Handle_t *adc, uint8_t channel,
+                           int32_t target_ua, uint16_t max_code);
+void CC_Stop(void);
+uint8_t CC_IsActive(void);
+void CC_GetStatus(CC_Status_t *status);
+
+/* Call from the main loop; runs one loop iteration per call */
+void CC_Poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CC_LOOP_H_ */
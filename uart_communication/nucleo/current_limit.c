@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * @file    current_limit.c
+  * @brief   Over-current trip on the ADS1115 ALERT comparator (DAC channel n, shunt on AINn)
+  * @date    October 2025
+  ******************************************************************************
+  * The ADS1115 compares every conversion of the protected channel with a
+  * threshold programmed from the limit and the shunt, and pulls ALERT low as
+  * soon as one exceeds it. The ALERT EXTI zeroes the channel's DAC with one
+  * interrupt-mode write, so the reaction time is the end of the conversion plus
+  * one I2C transaction (~70 us at 400 kHz) instead of a host round trip. If I2C1
+  * is busy at that moment the write is retried from the next MCP4728 completion
+  * or, for blocking transfers, from the main loop. The main loop then reports
+  * the trip. While armed, ALERT cannot serve as the RDY signal, so conversions
+  * poll the OS bit until Limit_Disarm restores the previous wait mode.
+  ******************************************************************************
+  */
+
+#include "current_limit.h"
+#include "cc_loop.h"
+#include "mcp4728.h"
+#include "calibration.h"
+
+/* State of the zeroing write */
+#define ZERO_DONE       0
+#define ZERO_PENDING    1   // Could not be started, retry
+#define ZERO_IN_FLIGHT  2   // Interrupt-mode write started
+
+static I2C_HandleTypeDef *limit_i2c = NULL;
+static ADS1115_Handle_t *limit_adc = NULL;
+static ADS1115_WaitMode_t saved_wait = ADS1115_WAIT_FIXED_DELAY;
+static volatile uint8_t zero_state = ZERO_DONE;
+static volatile uint8_t trip_unreported = 0;
+static volatile Limit_Status_t state = {0};
+
+static void StartZeroWrite(void);
+
+/**
+  * @brief  Arm the trip on a channel's shunt current (re-arming clears a trip)
+  * @param  hi2c: MCP4728 bus
+  * @param  adc: ADS1115 handle
+  * @param  channel: DAC channel driving the load, AIN of the same number reads its shunt
+  * @param  limit_ua: Trip current in microamps (> 0)
+  * @param  shunt_mohm: Shunt resistance in milliohms (> 0)
+  * @retval HAL_OK, HAL_ERROR for a bad argument or a limit beyond the ADC range
+  */
+HAL_StatusTypeDef Limit_Arm(I2C_HandleTypeDef *hi2c, ADS1115_Handle_t *adc, uint8_t channel,
+                            int32_t limit_ua, uint32_t shunt_mohm)
+{
+    if (hi2c == NULL || adc == NULL || channel > 3 || limit_ua <= 0 || shunt_mohm == 0)
+        return HAL_ERROR;
+
+    // uA * mOhm = nV
+    int64_t high = ((int64_t)limit_ua * shunt_mohm + CC_ADC_LSB_NV / 2) / CC_ADC_LSB_NV;
+    if (high < 1 || high > INT16_MAX)
+        return HAL_ERROR;
+    int64_t low = high - (high * LIMIT_HYSTERESIS_PCT) / 100;
+
+    // ALERT is ignored while the comparator is reprogrammed
+    if (!state.armed)
+        saved_wait = adc->waitMode;
+    state.armed = 0;
+
+    limit_i2c = hi2c;
+    limit_adc = adc;
+
+    if (adc->waitMode == ADS1115_WAIT_RDY_PIN)
+        ADS1115_setWaitMode(adc, ADS1115_WAIT_POLL_OS);
+    adc->config.compareMode = ADS1115_COMP_MODE_TRAD;
+    adc->config.polarityMode = ADS1115_POL_ACTIVE_LOW;
+    adc->config.latchingMode = ADS1115_LAT_NON_LATCHING;
+    adc->config.queueComparator = ADS1115_QUE_1_CONV;
+    ADS1115_setComparatorGate(adc, 1, ADS1115_MUX_SINGLE_ENDED(channel));
+    // The comparator sees raw codes
+    ADS1115_setThresholds(adc, Cal_AdcRaw(channel, (int16_t)low), Cal_AdcRaw(channel, (int16_t)high));
+
+    state.channel = channel;
+    state.threshold_code = (int16_t)high;
+    state.tripped = 0;
+    state.trips = 0;
+    zero_state = ZERO_DONE;
+    trip_unreported = 0;
+    state.armed = 1;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Disarm the trip and give ALERT back to its previous use
+  * @retval None
+  */
+void Limit_Disarm(void)
+{
+    if (!state.armed)
+        return;
+    state.armed = 0;
+    state.tripped = 0;
+    trip_unreported = 0;
+
+    // Writing the config with the comparator disabled releases ALERT right away
+    ADS1115_setComparatorGate(limit_adc, 0, limit_adc->comparatorChannel);
+    limit_adc->config.queueComparator = ADS1115_QUE_DISABLE;
+    ADS1115_updateConfig(limit_adc, limit_adc->config);
+
+    if (saved_wait == ADS1115_WAIT_RDY_PIN)
+        ADS1115_setWaitMode(limit_adc, ADS1115_WAIT_RDY_PIN);
+}
+
+/**
+  * @brief  1 while the trip is armed
+  * @retval Armed flag
+  */
+uint8_t Limit_IsArmed(void)
+{
+    return state.armed;
+}
+
+/**
+  * @brief  1 once the limit has tripped (until re-armed or disarmed)
+  * @retval Tripped flag
+  */
+uint8_t Limit_IsTripped(void)
+{
+    return state.armed && state.tripped;
+}
+
+/**
+  * @brief  Copy the limit state
+  * @param  status: Output
+  * @retval None
+  */
+void Limit_GetStatus(Limit_Status_t *status)
+{
+    *status = state;
+}
+
+/**
+  * @brief  Report a trip once
+  * @param  status: Output, the limit state at the time of the call
+  * @retval 1 if a trip happened since the last call, 0 otherwise
+  */
+uint8_t Limit_TakeTrip(Limit_Status_t *status)
+{
+    if (!trip_unreported)
+        return 0;
+    trip_unreported = 0;
+    *status = state;
+    return 1;
+}
+
+/**
+  * @brief  Finish a zeroing write that I2C1 refused, and keep the channel's conversions
+  *         flowing to the comparator
+  * @note   One single-shot conversion at 860 SPS per call; the ADC channel and data
+  *         rate are restored afterwards.
+  * @param  convert: 1 to take a conversion of the protected channel
+  * @retval None
+  */
+void Limit_Poll(uint8_t convert)
+{
+    if (!state.armed)
+        return;
+
+    if (zero_state == ZERO_PENDING && !MCP4728_IsBusy())
+    {
+        zero_state = ZERO_DONE;
+        if (MCP4728_WriteChannel(limit_i2c, (MCP4728_Channel)state.channel, 0) != HAL_OK)
+            zero_state = ZERO_PENDING;
+    }
+
+    if (!convert)
+        return;
+
+    ADS1115_MUX_t previous_channel = limit_adc->config.channel;
+    ADS1115_DataRate_t previous_rate = limit_adc->config.dataRate;
+
+    limit_adc->config.channel = limit_adc->comparatorChannel;
+    limit_adc->config.dataRate = ADS1115_DR_860SPS;
+    ADS1115_oneShotMeasure(limit_adc);
+    limit_adc->config.channel = previous_channel;
+    limit_adc->config.dataRate = previous_rate;
+}
+
+/**
+  * @brief  ALERT falling edge: zero the protected DAC channel
+  * @note   Call from the EXTI callback while armed. Every edge zeroes the output
+  *         again, so a channel driven back up after a trip is caught as well.
+  * @retval 1 for the first edge after arming (the caller stops whatever drives the
+  *         channel), 0 otherwise
+  */
+uint8_t Limit_OnAlert(void)
+{
+    if (!state.armed)
+        return 0;
+
+    state.trips++;
+    StartZeroWrite();
+    if (state.tripped)
+        return 0;
+
+    state.tripped = 1;
+    trip_unreported = 1;
+    return 1;
+}
+
+/**
+  * @brief  MCP4728 interrupt-mode write finished; start a zeroing write that was refused
+  * @note   A zeroing write that fails on the bus is left to Limit_Poll.
+  * @param  failed: 1 if the write ended with an I2C error
+  * @retval None
+  */
+void Limit_OnWriteComplete(uint8_t failed)
+{
+    if (zero_state == ZERO_IN_FLIGHT)
+        zero_state = failed ? ZERO_PENDING : ZERO_DONE;
+    else if (zero_state == ZERO_PENDING && !failed)
+        StartZeroWrite();
+}
+
+/**
+  * @brief  Start the interrupt-mode write that zeroes the protected channel
+  * @retval None
+  */
+static void StartZeroWrite(void)
+{
+    uint16_t values[4] = {0};
+
+    if (MCP4728_WriteChannelsIT(limit_i2c, values, (uint8_t)(1 << state.channel)) == HAL_OK)
+        zero_state = ZERO_IN_FLIGHT;
+    else
+        zero_state = ZERO_PENDING;
+}
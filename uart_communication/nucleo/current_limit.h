@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    current_limit.h
+  * @brief   Over-current trip on the ADS1115 ALERT comparator (DAC channel n, shunt on AINn)
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_CURRENT_LIMIT_H_
+#define INC_CURRENT_LIMIT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include "ADS1115.h"
+
+/* ALERT releases once the shunt voltage falls this far below the trip threshold */
+#define LIMIT_HYSTERESIS_PCT        10
+
+/* Limit state for "limit_status" */
+typedef struct {
+    uint8_t armed;
+    uint8_t channel;
+    int16_t threshold_code; // Shunt voltage trip threshold in ADC codes
+    uint8_t tripped;        // 1 from the trip until the limit is re-armed or cleared
+    uint32_t trips;         // ALERT edges since Limit_Arm
+} Limit_Status_t;
+
+/* Function Prototypes */
+HAL_StatusTypeDef Limit_Arm(I2C_HandleTypeDef *hi2c, ADS1115_Handle_t *adc, uint8_t channel,
+                            int32_t limit_ua, uint32_t shunt_mohm);
+void Limit_Disarm(void);
+uint8_t Limit_IsArmed(void);
+uint8_t Limit_IsTripped(void);
+void Limit_GetStatus(Limit_Status_t *status);
+uint8_t Limit_TakeTrip(Limit_Status_t *status);
+
+/* Call from the main loop; convert = 0 when another loop already converts the channel */
+void Limit_Poll(uint8_t convert);
+
+/* Call from the matching interrupt callbacks */
+uint8_t Limit_OnAlert(void);
+void Limit_OnWriteComplete(uint8_t failed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CURRENT_LIMIT_H_ */
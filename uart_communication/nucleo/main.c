@@ -7,6 +7,20 @@
 #include "main.h"
 #include "mcp4728.h"
 #include "ADS1115.h"
+#include "smu_protocol.h"
+#include "uart_dma.h"
+#if SMU_USE_USB_CDC
+#include "usb_device.h"
+#include "usb_cdc.h"
+#endif
+#include "adc_stream.h"
+#include "wave_player.h"
+#include "smu_filter.h"
+#include "cc_loop.h"
+#include "current_limit.h"
+#include "calibration.h"
+#include "adc_range.h"
+#include "smu_stats.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -14,31 +28,161 @@
 I2C_HandleTypeDef hi2c1;  // For MCP4728 DAC
 I2C_HandleTypeDef hi2c2;  // For ADS1115 ADC
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
+TIM_HandleTypeDef htim2;  // Free-running 1 MHz time base (sweep settle timing)
+TIM_HandleTypeDef htim6;  // Waveform step clock (reprogrammed per wave_play)
 
-// ADS1115 handle
+// ADS1115 handles (static storage, the firmware links without a heap);
+// adc_handle (chip 0, AIN0-3) stays NULL until the driver is initialized.
+// adc_chips[n] serves scan/stream channels 4n-4n+3, NULL if the chip did not answer
+static ADS1115_Handle_t adc_storage[SMU_ADC_COUNT];
+static ADS1115_Handle_t* adc_chips[SMU_ADC_COUNT];
 ADS1115_Handle_t* adc_handle = NULL;
 
-uint8_t tx_buffer[128];
+static const uint16_t adc_addresses[4] = {
+    ADS1115_ADDR_GND, ADS1115_ADDR_VDD, ADS1115_ADDR_SDA, ADS1115_ADDR_SCL
+};
+
+#if SMU_ADC_COUNT < 1 || SMU_ADC_COUNT > 4
+#error "SMU_ADC_COUNT must be 1-4, the ADS1115 has four addresses"
+#endif
+
+uint8_t tx_buffer[192];
 uint8_t rx_buffer[64];
 uint8_t rx_index = 0;
+static uint8_t rx_line_dropped = 0;  // Current line overflowed rx_buffer, skip to its end
+
+// Binary framed protocol, enabled by "COMM_OK,BIN"
+static uint8_t binary_mode = 0;
+static Proto_Parser_t proto_parser;
+
+// ASCII reply tag: a command line "#<seq>:<command>" gets "#<seq>:" in front of
+// every reply line, so the host can keep several commands in flight
+#define REPLY_TAG_MAX_DIGITS  5
+static char reply_tag[REPLY_TAG_MAX_DIGITS + 3];
+static uint8_t reply_tag_len = 0;
+static uint8_t reply_line_start = 1;
+
+// On-MCU sweep engine: ADC codes captured per step, streamed back after the sweep
+#define SWEEP_MAX_POINTS  4096
+static int16_t sweep_codes[SWEEP_MAX_POINTS];
+static uint32_t sweep_times[SWEEP_MAX_POINTS];  // TIM2 us at each point's conversion start
+static uint32_t sweep_settle[SWEEP_MAX_POINTS]; // Adaptive settle: us from DAC write to settled
+
+// Adaptive sweep settling: after each DAC step, 860 SPS readings are taken until
+// SWEEP_SETTLE_AGREE consecutive ones stay within the tolerance of the one before
+#define SWEEP_SETTLE_AGREE    2
+// Longest settle_us and adaptive max_us per point; settling busy-waits the main loop
+#define SWEEP_MAX_SETTLE_US   5000000
+
+// Sample timestamps: with "timestamps,1" every reading, sweep point, stream block and
+// waveform capture also carries the 32-bit TIM2 microsecond count it was taken at
+static uint8_t timestamps_on = 0;
+
+// I2C1/I2C2 have no Fast Mode Plus, 400 kHz is the ceiling
+#define I2C_MIN_SPEED_HZ      10000
+#define I2C_MAX_SPEED_HZ      400000
+
+// Scan list: channel mask over AIN0-3 of every ADS1115 (bit 4n+k = chip n AINk)
+// and per-channel oversampling limit
+#define ADC_CHANNELS          (4 * SMU_ADC_COUNT)
+#define SCAN_MAX_OVERSAMPLE   64
+
+// Waveform playback limits; capture needs one 860 SPS conversion per step
+#define WAVE_MAX_RATE         5000
+#define WAVE_MAX_CAPTURE_RATE 500
+#define WAVE_MAX_LOOPS        65535
+#define WAVE_NO_CAPTURE       0xFF
+
+// OPM trigger output: 1 pulses OPM_TRIG_Pin after every settled sweep step
+static uint8_t opm_trigger_per_step = 0;
+
+// Host link: USART2 through the ST-LINK VCP, or the native USB CDC port
+#if SMU_USE_USB_CDC
+#if SMU_LOW_POWER_CLOCK
+#error "SMU_USE_USB_CDC needs the 48 MHz PLLSAI clock, not available with SMU_LOW_POWER_CLOCK"
+#endif
+#define LINK_READ(data, len)  USB_CDC_Read(data, len)
+#define LINK_SEND(data, len)  USB_CDC_Send(data, len)
+#else
+#define LINK_READ(data, len)  UART_DMA_Read(data, len)
+#define LINK_SEND(data, len)  UART_DMA_Send(data, len)
+#endif
+
+// Continuous-mode streaming limits
+#define STREAM_MAX_SAMPLES    1000000
+#define STREAM_STALL_MS       1000
 
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_I2C2_Init(void);
 static void MX_USART2_UART_Init(void);
+static void MX_TIM2_Init(void);
+static void MX_TIM6_Init(void);
+static uint32_t TIM_GetAPB1TimerClock(void);
+static uint32_t I2C_SelectDutyCycle(uint32_t speed_hz);
+static HAL_StatusTypeDef I2C_SetSpeed(I2C_HandleTypeDef *hi2c, uint32_t speed_hz);
+static uint32_t I2C_GetSpeed(I2C_HandleTypeDef *hi2c);
+static void Delay_us(uint32_t us);
+static uint32_t Micros(void);
+static void PulseOPMTrigger(void);
+static uint8_t ParseUIntList(char *str, uint32_t *values, uint8_t max_values);
+static uint8_t ParseIntList(char *str, int32_t *values, uint8_t max_values);
+static int8_t ParseCalTarget(char **str);
+static char* ParseFixed(char *str, uint8_t decimals, int32_t *value);
+static int FormatFixed(char *out, float value, uint8_t decimals);
+static HAL_StatusTypeDef ADC_Convert(ADS1115_Handle_t *adc, int16_t *value);
+static void RunSweep(uint8_t dac_channel, uint8_t adc_channel, uint16_t start,
+                     uint16_t stop, uint16_t steps, uint32_t settle_us,
+                     uint16_t tolerance, uint32_t max_settle_us);
+static void SendSweepASCII(uint16_t start, uint16_t stop, uint16_t steps, uint8_t adaptive);
+static void SendStatsASCII(void);
+static void SendStatsFrame(uint8_t seq);
+static uint16_t AdcChannelMask(void);
+static uint8_t RunScan(uint16_t mask, uint8_t oversample, int16_t *codes);
+static void RunStream(uint8_t adc_channel, uint16_t sps, uint32_t count,
+                      uint8_t binary, uint8_t seq);
+static void RunWave(uint16_t rate, uint16_t loops, uint8_t adc_channel,
+                    uint8_t binary, uint8_t seq);
+static void SendFrame(uint8_t opcode, uint8_t seq, const uint8_t *payload, uint16_t length);
+static void SendFrameSplit(uint8_t opcode, uint8_t seq, const uint8_t *first, uint16_t first_length,
+                           const uint8_t *second, uint16_t second_length);
+static void SendFrameParts(uint8_t opcode, uint8_t seq, const uint8_t *const *parts,
+                           const uint16_t *lengths, uint8_t count);
+static void SendErrorFrame(uint8_t opcode, uint8_t seq, Proto_Error_t error);
+static void HandleRxByte(uint8_t byte);
+static void StripReplyTag(void);
+static void SendASCII(const uint8_t *data, uint16_t len);
+static void SendLimitTrip(void);
+static void Command_InitIndex(void);
 void ProcessUARTCommand(void);
-float ADS1115_ReadVoltage(uint8_t channel);
+void ProcessBinaryCommand(void);
+static uint8_t ADC_ReadFiltered(uint8_t channel, uint16_t oversample, SMU_Filter_t filter,
+                               SMU_FilterResult_t *result, ADS1115_PGA_t *range);
+static uint8_t ADC_Autoranges(uint8_t channel, SMU_Filter_t filter);
+float ADS1115_ReadVoltage(uint8_t channel, uint16_t oversample, SMU_Filter_t filter, float *stddev,
+                          ADS1115_PGA_t *range);
+static float ADS1115_CodeToVoltage(int16_t adc_value);
 
 int main(void)
 {
     HAL_Init();
     SystemClock_Config();
+    Stats_Init();
 
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_I2C1_Init();
     MX_I2C2_Init();
     MX_USART2_UART_Init();
+    MX_TIM2_Init();
+    MX_TIM6_Init();
+
+    // Per-channel ADC/DAC calibration from flash (identity if none is stored)
+    Cal_Init();
 
     // Initialize MCP4728 on I2C1
     HAL_StatusTypeDef init_status = MCP4728_Init(&hi2c1);
@@ -51,6 +195,10 @@ int main(void)
         }
     }
     
+#if SMU_DAC_USE_LDAC_PIN
+    MCP4728_SetLDACPin(MCP4728_LDAC_GPIO_Port, MCP4728_LDAC_Pin);
+#endif
+
     // Initialize all DAC channels to 0
     uint16_t dac_values[4] = {0, 0, 0, 0};
     MCP4728_SetAllChannels(&hi2c1, dac_values);
@@ -68,8 +216,7 @@ int main(void)
         .queueComparator = ADS1115_QUE_DISABLE
     };
     
-    adc_handle = ADS1115_init(&hi2c2, ADS1115_ADDR_GND, adc_config);
-    if (adc_handle == NULL)
+    if (ADS1115_initHandle(&adc_storage[0], &hi2c2, ADS1115_ADDR_GND, adc_config) != HAL_OK)
     {
         // If initialization failed, enter error state
         while (1)
@@ -77,64 +224,264 @@ int main(void)
             HAL_Delay(1000);
         }
     }
+    adc_handle = &adc_storage[0];
+    adc_chips[0] = adc_handle;
+
+    // Return from each conversion as soon as it is done rather than after a fixed delay
+#if SMU_ADC_USE_RDY_PIN
+    ADS1115_setWaitMode(adc_handle, ADS1115_WAIT_RDY_PIN);
+#else
+    ADS1115_setWaitMode(adc_handle, ADS1115_WAIT_POLL_OS);
+#endif
+
+    // Further chips are optional; only chip 0's ALERT/RDY is wired, so they poll OS
+    for (uint8_t chip = 1; chip < SMU_ADC_COUNT; chip++)
+    {
+        if (HAL_I2C_IsDeviceReady(&hi2c2, adc_addresses[chip] << 1, 2, 10) != HAL_OK ||
+            ADS1115_initHandle(&adc_storage[chip], &hi2c2, adc_addresses[chip], adc_config) != HAL_OK)
+            continue;
+        ADS1115_setWaitMode(&adc_storage[chip], ADS1115_WAIT_POLL_OS);
+        adc_chips[chip] = &adc_storage[chip];
+    }
     
     // Clear receive buffer
     memset(rx_buffer, 0, sizeof(rx_buffer));
     rx_index = 0;
+    Proto_ParserReset(&proto_parser);
+    Command_InitIndex();
 
-    // Main loop: receive and process UART commands
+    // Start reception; commands queue up in the RX ring while we are busy
+#if SMU_USE_USB_CDC
+    MX_USB_DEVICE_Init();
+    if (USB_CDC_Init() != HAL_OK) Error_Handler();
+#else
+    if (UART_DMA_Init(&huart2) != HAL_OK) Error_Handler();
+#endif
+
+    // Main loop: drain the RX ring and process UART commands; the constant-current
+    // loop and the current limit run one iteration whenever no command is pending
     while (1)
     {
         uint8_t byte;
-        // Try to receive one byte (non-blocking)
-        if (HAL_UART_Receive(&huart2, &byte, 1, 10) == HAL_OK)
+        while (LINK_READ(&byte, 1) == 1)
         {
-            // Check for newline or carriage return (end of command)
-            if (byte == '\n' || byte == '\r')
-            {
-                if (rx_index > 0)
-                {
-                    rx_buffer[rx_index] = '\0';  // Null terminate
-                    ProcessUARTCommand();
-                    rx_index = 0;  // Reset for next command
-                    memset(rx_buffer, 0, sizeof(rx_buffer));
-                }
-            }
-            else if (rx_index < (sizeof(rx_buffer) - 1))
-            {
-                // Add byte to buffer
-                rx_buffer[rx_index++] = byte;
-            }
-            else
-            {
-                // Buffer overflow, reset
-                rx_index = 0;
-                memset(rx_buffer, 0, sizeof(rx_buffer));
-            }
+            HandleRxByte(byte);
+        }
+        CC_Poll();
+
+        // The CC loop's conversions already reach the comparator when it regulates
+        // the protected channel
+        CC_Status_t cc;
+        Limit_Status_t limit;
+        CC_GetStatus(&cc);
+        Limit_GetStatus(&limit);
+        Limit_Poll(!(cc.active && cc.channel == limit.channel));
+        SendLimitTrip();
+    }
+}
+
+/**
+  * @brief  Feed one received byte to the binary frame parser or the ASCII line buffer
+  * @param  byte: Received byte
+  * @retval None
+  */
+static void HandleRxByte(uint8_t byte)
+{
+    // Binary frames start with PROTO_SYNC0, which never appears in ASCII commands
+    if (binary_mode && (byte == PROTO_SYNC0 || !Proto_ParserIdle(&proto_parser)))
+    {
+        Proto_Result_t result = Proto_ParseByte(&proto_parser, byte);
+        if (result == PROTO_FRAME_READY)
+        {
+            uint32_t start = Stats_Cycles();
+            ProcessBinaryCommand();
+            Stats_Record(STATS_COMMAND, start);
+        }
+        else if (result == PROTO_FRAME_BAD_CRC)
+        {
+            Stats_Count(STATS_BAD_FRAMES);
+            SendErrorFrame(proto_parser.opcode, proto_parser.seq, PROTO_ERR_BAD_CRC);
+        }
+        return;
+    }
+
+    // Check for newline or carriage return (end of command)
+    if (byte == '\n' || byte == '\r')
+    {
+        if (rx_line_dropped)
+        {
+            // The overlong line still gets its reply, untagged (the tag was dropped with it)
+            rx_line_dropped = 0;
+            reply_tag_len = 0;
+            reply_line_start = 1;
+            int len = sprintf((char*)tx_buffer, "ERR,%u\r\n", (unsigned)PROTO_ERR_BAD_ARG);
+            SendASCII(tx_buffer, len);
         }
+        else if (rx_index > 0)
+        {
+            uint32_t start = Stats_Cycles();
+            rx_buffer[rx_index] = '\0';  // Null terminate
+            StripReplyTag();
+            ProcessUARTCommand();
+            Stats_Record(STATS_COMMAND, start);
+            reply_tag_len = 0;
+            rx_index = 0;  // Reset for next command
+            memset(rx_buffer, 0, sizeof(rx_buffer));
+        }
+    }
+    else if (rx_line_dropped)
+    {
+        // Discard the rest of an overlong line
+    }
+    else if (rx_index < (sizeof(rx_buffer) - 1))
+    {
+        // Add byte to buffer
+        rx_buffer[rx_index++] = byte;
+    }
+    else
+    {
+        // Buffer overflow, drop the line up to its end
+        Stats_Count(STATS_LINE_OVERFLOWS);
+        rx_line_dropped = 1;
+        rx_index = 0;
+        memset(rx_buffer, 0, sizeof(rx_buffer));
     }
 }
  
+/**
+  * @brief  Move a leading "#<seq>:" tag from rx_buffer into reply_tag
+  * @note   seq is 1-REPLY_TAG_MAX_DIGITS decimal digits and is echoed verbatim.
+  *         A line without a well-formed tag is left untouched and replied to untagged.
+  * @retval None
+  */
+static void StripReplyTag(void)
+{
+    reply_tag_len = 0;
+    reply_line_start = 1;
+    if (rx_buffer[0] != '#')
+        return;
+
+    uint8_t digits = 0;
+    while (rx_buffer[1 + digits] >= '0' && rx_buffer[1 + digits] <= '9' && digits <= REPLY_TAG_MAX_DIGITS)
+        digits++;
+    if (digits == 0 || digits > REPLY_TAG_MAX_DIGITS || rx_buffer[1 + digits] != ':')
+        return;
+
+    reply_tag_len = digits + 2;
+    memcpy(reply_tag, rx_buffer, reply_tag_len);
+    rx_index -= reply_tag_len;
+    memmove(rx_buffer, rx_buffer + reply_tag_len, rx_index + 1);
+}
+
+/**
+  * @brief  Queue ASCII reply text, prefixing each new line with the command's reply tag
+  * @param  data: Reply text (lines end in "\r\n" and may span several calls)
+  * @param  len: Number of bytes
+  * @retval None
+  */
+static void SendASCII(const uint8_t *data, uint16_t len)
+{
+    while (len > 0)
+    {
+        if (reply_line_start && reply_tag_len > 0)
+            LINK_SEND((const uint8_t*)reply_tag, reply_tag_len);
+
+        const uint8_t *newline = memchr(data, '\n', len);
+        uint16_t chunk = (newline != NULL) ? (uint16_t)(newline - data + 1) : len;
+        LINK_SEND(data, chunk);
+        reply_line_start = (newline != NULL);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+  * @brief  Report a current limit trip once, outside any reply
+  * @note   ASCII: untagged "TRIP,<ch>,<threshold>\r\n". Binary: PROTO_OP_EVENT frame with
+  *         seq 0, [PROTO_EVENT_LIMIT_TRIP u8][ch u8][threshold i16].
+  * @retval None
+  */
+static void SendLimitTrip(void)
+{
+    Limit_Status_t limit;
+
+    if (!Limit_TakeTrip(&limit))
+        return;
+
+    if (binary_mode)
+    {
+        uint8_t payload[4] = {PROTO_EVENT_LIMIT_TRIP, limit.channel};
+        Proto_PutU16(&payload[2], (uint16_t)limit.threshold_code);
+        SendFrame(PROTO_OP_EVENT | PROTO_REPLY_FLAG, 0, payload, sizeof(payload));
+        return;
+    }
+
+    int len = sprintf((char*)tx_buffer, "TRIP,%u,%d\r\n", limit.channel, limit.threshold_code);
+    SendASCII(tx_buffer, len);
+}
+
+/**
+  * @brief  System clock configuration
+  * @note   Default: HSI (16 MHz) / M 8 * N 180 / P 2 = 180 MHz SYSCLK with over-drive,
+  *         voltage scale 1 and 5 flash wait states; APB1 45 MHz, APB2 90 MHz.
+  *         SMU_LOW_POWER_CLOCK: HSI straight to SYSCLK at 16 MHz, scale 3, 0 wait states.
+  *         SMU_USE_USB_CDC: HSE bypass (8 MHz MCO from the ST-LINK) / M 4 * N 180 / P 2
+  *         for the same 180 MHz, since USB needs a crystal-accurate 48 MHz; PLLSAI
+  *         8 MHz / M 4 * N 96 / P 4 supplies the 48 MHz CLK48.
+  *         Peripheral init reads the bus clocks back, so both profiles keep the same
+  *         UART baud, I2C speed and TIM2 tick.
+  * @retval None
+  */
 void SystemClock_Config(void)
 {
     RCC_OscInitTypeDef RCC_OscInitStruct = {0};
     RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
 
     __HAL_RCC_PWR_CLK_ENABLE();
+#if SMU_LOW_POWER_CLOCK
     __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE3);
+#else
+    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+#endif
 
+#if SMU_USE_USB_CDC
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+    RCC_OscInitStruct.HSEState = RCC_HSE_BYPASS;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+    RCC_OscInitStruct.PLL.PLLM = 4;       // 2 MHz VCO input
+#else
     RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
     RCC_OscInitStruct.HSIState = RCC_HSI_ON;
     RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
+#endif
+#if SMU_LOW_POWER_CLOCK
     RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
+#else
+#if !SMU_USE_USB_CDC
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI;
+    RCC_OscInitStruct.PLL.PLLM = 8;       // 2 MHz VCO input
+#endif
+    RCC_OscInitStruct.PLL.PLLN = 180;     // 360 MHz VCO
+    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+    RCC_OscInitStruct.PLL.PLLQ = 2;
+    RCC_OscInitStruct.PLL.PLLR = 2;
+#endif
 
     if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) Error_Handler();
 
+#if !SMU_LOW_POWER_CLOCK
+    // 180 MHz needs over-drive; must be on before switching SYSCLK to the PLL
+    if (HAL_PWREx_EnableOverDrive() != HAL_OK) Error_Handler();
+#endif
+
     RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK |
                                   RCC_CLOCKTYPE_SYSCLK |
                                   RCC_CLOCKTYPE_PCLK1 |
                                   RCC_CLOCKTYPE_PCLK2;
 
+#if SMU_LOW_POWER_CLOCK
     RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
     RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
     RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
@@ -142,13 +489,35 @@ void SystemClock_Config(void)
 
     if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
         Error_Handler();
+#else
+    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;   // 45 MHz max
+    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;   // 90 MHz max
+
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK)
+        Error_Handler();
+#endif
+
+#if SMU_USE_USB_CDC
+    RCC_PeriphCLKInitTypeDef PeriphClkInitStruct = {0};
+
+    PeriphClkInitStruct.PeriphClockSelection = RCC_PERIPHCLK_CLK48;
+    PeriphClkInitStruct.PLLSAI.PLLSAIM = 4;                 // 2 MHz VCO input
+    PeriphClkInitStruct.PLLSAI.PLLSAIN = 96;                // 192 MHz VCO
+    PeriphClkInitStruct.PLLSAI.PLLSAIP = RCC_PLLSAIP_DIV4;  // 48 MHz
+    PeriphClkInitStruct.PLLSAI.PLLSAIQ = 2;
+    PeriphClkInitStruct.Clk48ClockSelection = RCC_CLK48CLKSOURCE_PLLSAIP;
+
+    if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInitStruct) != HAL_OK) Error_Handler();
+#endif
 }
 
 static void MX_I2C1_Init(void)
 {
     hi2c1.Instance = I2C1;
-    hi2c1.Init.ClockSpeed = 100000;
-    hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+    hi2c1.Init.ClockSpeed = SMU_I2C1_SPEED_HZ;
+    hi2c1.Init.DutyCycle = I2C_SelectDutyCycle(SMU_I2C1_SPEED_HZ);
     hi2c1.Init.OwnAddress1 = 0;
     hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
     hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
@@ -157,13 +526,19 @@ static void MX_I2C1_Init(void)
     hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
 
     if (HAL_I2C_Init(&hi2c1) != HAL_OK) Error_Handler();
+
+    // Interrupt-driven DAC writes during waveform playback
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
 }
 
 static void MX_I2C2_Init(void)
 {
     hi2c2.Instance = I2C2;
-    hi2c2.Init.ClockSpeed = 100000;
-    hi2c2.Init.DutyCycle = I2C_DUTYCYCLE_2;
+    hi2c2.Init.ClockSpeed = SMU_I2C2_SPEED_HZ;
+    hi2c2.Init.DutyCycle = I2C_SelectDutyCycle(SMU_I2C2_SPEED_HZ);
     hi2c2.Init.OwnAddress1 = 0;
     hi2c2.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
     hi2c2.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
@@ -172,6 +547,70 @@ static void MX_I2C2_Init(void)
     hi2c2.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
 
     if (HAL_I2C_Init(&hi2c2) != HAL_OK) Error_Handler();
+
+    // Interrupt-driven conversion reads while streaming
+    HAL_NVIC_SetPriority(I2C2_EV_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(I2C2_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C2_ER_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(I2C2_ER_IRQn);
+}
+
+/**
+  * @brief  Pick the fast-mode duty cycle for a bus speed
+  * @note   16/9 only divides cleanly when PCLK1 is a multiple of 25 x speed (e.g. 10 MHz
+  *         for 400 kHz). Otherwise HAL rounds CCR up and SCL lands well below the
+  *         request (45 MHz PCLK1: CCR 5, 360 kHz instead of 400 kHz), so use 2:1, whose
+  *         steps are 3 PCLK1 periods and land within a few percent (CCR 38, 395 kHz).
+  * @param  speed_hz: Bus speed in Hz
+  * @retval I2C_DUTYCYCLE_2 or I2C_DUTYCYCLE_16_9
+  */
+static uint32_t I2C_SelectDutyCycle(uint32_t speed_hz)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+
+    if (speed_hz > 100000 && (pclk1 % (speed_hz * 25)) == 0)
+        return I2C_DUTYCYCLE_16_9;
+    return I2C_DUTYCYCLE_2;
+}
+
+/**
+  * @brief  Re-initialise an I2C bus at a new speed
+  * @note   HAL_I2C_Init reprograms CCR/TRISE and skips the MSP init once the handle has
+  *         been set up, so pins and NVIC stay as they are.
+  * @param  hi2c: Bus handle
+  * @param  speed_hz: Bus speed in Hz (I2C_MIN_SPEED_HZ-I2C_MAX_SPEED_HZ)
+  * @retval HAL_OK, HAL_ERROR for an out-of-range speed, HAL_BUSY if a transfer is running
+  */
+static HAL_StatusTypeDef I2C_SetSpeed(I2C_HandleTypeDef *hi2c, uint32_t speed_hz)
+{
+    if (speed_hz < I2C_MIN_SPEED_HZ || speed_hz > I2C_MAX_SPEED_HZ)
+        return HAL_ERROR;
+    if (hi2c->State != HAL_I2C_STATE_READY)
+        return HAL_BUSY;
+
+    hi2c->Init.ClockSpeed = speed_hz;
+    hi2c->Init.DutyCycle = I2C_SelectDutyCycle(speed_hz);
+    return HAL_I2C_Init(hi2c);
+}
+
+/**
+  * @brief  SCL frequency actually produced by the current CCR setting
+  * @param  hi2c: Bus handle
+  * @retval Bus speed in Hz
+  */
+static uint32_t I2C_GetSpeed(I2C_HandleTypeDef *hi2c)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    uint32_t ccr = hi2c->Instance->CCR;
+    uint32_t divider = ccr & I2C_CCR_CCR;
+
+    if (divider == 0)
+        return 0;
+    if ((ccr & I2C_CCR_FS) == 0)
+        return pclk1 / (2 * divider);
+    if ((ccr & I2C_CCR_DUTY) == 0)
+        return pclk1 / (3 * divider);
+    return pclk1 / (25 * divider);
 }
 
 static void MX_USART2_UART_Init(void)
@@ -186,212 +625,2240 @@ static void MX_USART2_UART_Init(void)
     huart2.Init.OverSampling = UART_OVERSAMPLING_16;
 
     if (HAL_UART_Init(&huart2) != HAL_OK) Error_Handler();
+
+    // USART2_RX: DMA1 Stream5 Channel4, circular
+    hdma_usart2_rx.Instance = DMA1_Stream5;
+    hdma_usart2_rx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK) Error_Handler();
+    __HAL_LINKDMA(&huart2, hdmarx, hdma_usart2_rx);
+
+    // USART2_TX: DMA1 Stream6 Channel4, normal
+    hdma_usart2_tx.Instance = DMA1_Stream6;
+    hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK) Error_Handler();
+    __HAL_LINKDMA(&huart2, hdmatx, hdma_usart2_tx);
+
+    // USART2 interrupt is needed for idle-line detection and TX completion
+    HAL_NVIC_SetPriority(USART2_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+}
+
+static void MX_DMA_Init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+}
+
+/**
+  * @brief  Kernel clock of the APB1 timers (TIM2-TIM7)
+  * @retval Clock in Hz
+  */
+static uint32_t TIM_GetAPB1TimerClock(void)
+{
+    RCC_ClkInitTypeDef clk_config = {0};
+    uint32_t flash_latency = 0;
+    HAL_RCC_GetClockConfig(&clk_config, &flash_latency);
+
+    // APB1 timers run at 2x PCLK1 whenever the APB1 prescaler is not 1
+    uint32_t timer_clock = HAL_RCC_GetPCLK1Freq();
+    if (clk_config.APB1CLKDivider != RCC_HCLK_DIV1)
+        timer_clock *= 2;
+    return timer_clock;
+}
+
+/**
+  * @brief  Configure TIM2 as a free-running 32-bit counter ticking at 1 MHz
+  * @note   Prescaler is derived from the actual APB1 timer clock, so it stays
+  *         correct whatever SystemClock_Config selects
+  */
+static void MX_TIM2_Init(void)
+{
+    uint32_t timer_clock = TIM_GetAPB1TimerClock();
+
+    __HAL_RCC_TIM2_CLK_ENABLE();
+
+    htim2.Instance = TIM2;
+    htim2.Init.Prescaler = (timer_clock / 1000000U) - 1;
+    htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim2.Init.Period = 0xFFFFFFFF;
+    htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+    if (HAL_TIM_Base_Init(&htim2) != HAL_OK) Error_Handler();
+    if (HAL_TIM_Base_Start(&htim2) != HAL_OK) Error_Handler();
+}
+
+static void MX_TIM6_Init(void)
+{
+    __HAL_RCC_TIM6_CLK_ENABLE();
+
+    // Placeholder 1 kHz; Wave_Start sets prescaler and period for the requested rate
+    htim6.Instance = TIM6;
+    htim6.Init.Prescaler = (TIM_GetAPB1TimerClock() / 1000000U) - 1;
+    htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim6.Init.Period = 1000 - 1;
+    htim6.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+    if (HAL_TIM_Base_Init(&htim6) != HAL_OK) Error_Handler();
+
+    // Above UART DMA so step timing is not disturbed by host traffic
+    HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
+}
+
+/**
+  * @brief  Busy-wait for a number of microseconds using the TIM2 time base
+  * @param  us: Delay in microseconds
+  * @retval None
+  */
+static void Delay_us(uint32_t us)
+{
+    uint32_t start = __HAL_TIM_GET_COUNTER(&htim2);
+    // Unsigned subtraction handles counter wrap-around
+    while ((__HAL_TIM_GET_COUNTER(&htim2) - start) < us) {}
+}
+
+/**
+  * @brief  Current TIM2 time in microseconds (wraps every ~71 minutes)
+  */
+static uint32_t Micros(void)
+{
+    return __HAL_TIM_GET_COUNTER(&htim2);
+}
+
+/**
+  * @brief  Emit one SMU_OPM_TRIG_PULSE_US pulse on OPM_TRIG_Pin
+  * @note   With the power meter logging in single-measurement-per-trigger mode,
+  *         each pulse records one point, so a whole sweep needs one trace read.
+  * @retval None
+  */
+static void PulseOPMTrigger(void)
+{
+    HAL_GPIO_WritePin(OPM_TRIG_GPIO_Port, OPM_TRIG_Pin, GPIO_PIN_SET);
+    Delay_us(SMU_OPM_TRIG_PULSE_US);
+    HAL_GPIO_WritePin(OPM_TRIG_GPIO_Port, OPM_TRIG_Pin, GPIO_PIN_RESET);
 }
 
 static void MX_GPIO_Init(void)
 {
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    // Optical power meter trigger output, idle low
+    HAL_GPIO_WritePin(OPM_TRIG_GPIO_Port, OPM_TRIG_Pin, GPIO_PIN_RESET);
+    GPIO_InitStruct.Pin = OPM_TRIG_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(OPM_TRIG_GPIO_Port, &GPIO_InitStruct);
+
+#if SMU_DAC_USE_LDAC_PIN
+    // MCP4728 LDAC: held high so staged values wait for the latch pulse
+    HAL_GPIO_WritePin(MCP4728_LDAC_GPIO_Port, MCP4728_LDAC_Pin, GPIO_PIN_SET);
+    GPIO_InitStruct.Pin = MCP4728_LDAC_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(MCP4728_LDAC_GPIO_Port, &GPIO_InitStruct);
+#endif
+
+    // ADS1115 ALERT/RDY: open-drain, active low. The falling edge marks conversion done
+    // (SMU_ADC_USE_RDY_PIN) or, while a current limit is armed, an over-current conversion
+    GPIO_InitStruct.Pin = ADS1115_RDY_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(ADS1115_RDY_GPIO_Port, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(ADS1115_RDY_EXTI_IRQn, 4, 0);
+    HAL_NVIC_EnableIRQ(ADS1115_RDY_EXTI_IRQn);
 }
 
-void ProcessUARTCommand(void)
+/*
+ * ASCII command handlers. Each gets the text after "<name>," (NULL for a bare
+ * "<name>", see Command_t.args), sends its own reply on success and returns
+ * PROTO_ERR_NONE; on failure it sends nothing and returns the error code that
+ * ProcessUARTCommand reports as "ERR,<code>".
+ */
+
+// "COMM_OK" / "COMM_OK,BIN" / "COMM_OK,ASCII" - communication check, negotiate the
+// binary framed protocol
+static Proto_Error_t Cmd_CommOk(char *args)
 {
-    // Handle COMM_OK command
-    if (strcmp((char*)rx_buffer, "COMM_OK") == 0)
+    if (args == NULL)
     {
         int len = sprintf((char*)tx_buffer, "COMM_OK\r\n");
-        HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        return;
-    }
-    
-    // Handle "test_adc" command - test I2C communication with ADC
-    if (strcmp((char*)rx_buffer, "test_adc") == 0)
-    {
-        if (adc_handle == NULL)
-        {
-            int len = sprintf((char*)tx_buffer, "ERROR:ADC_NOT_INIT\r\n");
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-            return;
-        }
-        
-        // Try to read config register to test I2C communication
-        uint8_t reg_addr = 0x01; // Config register
-        uint8_t config_bytes[2] = {0};
-        
-        HAL_StatusTypeDef status1 = HAL_I2C_Master_Transmit(&hi2c2, (ADS1115_ADDR_GND << 1), &reg_addr, 1, 100);
-        HAL_StatusTypeDef status2 = HAL_I2C_Master_Receive(&hi2c2, (ADS1115_ADDR_GND << 1), config_bytes, 2, 100);
-        
-        if (status1 == HAL_OK && status2 == HAL_OK)
-        {
-            int len = sprintf((char*)tx_buffer, "OK:0x%02X%02X\r\n", config_bytes[0], config_bytes[1]);
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        }
-        else
-        {
-            int len = sprintf((char*)tx_buffer, "ERROR:I2C_FAIL:%d,%d\r\n", status1, status2);
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        }
-        return;
-    }
-    
-    // Handle "read_adc_raw,channel" command - read raw ADC value for debugging
-    if (strncmp((char*)rx_buffer, "read_adc_raw,", 13) == 0)
-    {
-        uint8_t channel = (uint8_t)atoi((char*)rx_buffer + 13);
-        
-        if (adc_handle == NULL || channel > 3)
-        {
-            int len = sprintf((char*)tx_buffer, "ERROR\r\n");
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-            return;
-        }
-        
-        // Map channel to MUX setting
-        ADS1115_MUX_t mux_settings[4] = {
-            ADS1115_MUX_AIN0_GND, ADS1115_MUX_AIN1_GND,
-            ADS1115_MUX_AIN2_GND, ADS1115_MUX_AIN3_GND
-        };
-        
-        // Update config for selected channel
-        ADS1115_Config_t config = adc_handle->config;
-        config.channel = mux_settings[channel];
-        adc_handle->config = config;
-        
-        // Read raw ADC value
-        int16_t raw_adc = ADS1115_oneShotMeasure(adc_handle);
-        
-        // Send response: raw ADC value
-        int len = sprintf((char*)tx_buffer, "%d\r\n", raw_adc);
-        HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        return;
-    }
-    
-    // Handle "read_adc,channel" command - read ADC voltage
-    if (strncmp((char*)rx_buffer, "read_adc,", 9) == 0)
-    {
-        uint8_t channel = (uint8_t)atoi((char*)rx_buffer + 9);
-        
-        // Validate channel (0-3)
-        if (channel > 3)
-        {
-            // Invalid channel, ignore
-            return;
-        }
-        
-        // Read voltage from ADC (this also reads the raw ADC value internally)
-        float voltage = ADS1115_ReadVoltage(channel);
-        
-        // Send response: voltage as float string
-        int len = sprintf((char*)tx_buffer, "%.4f\r\n", voltage);
-        HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        return;
-    }
-    
-    // Handle "set_all,dac_value" command - set all channels to same value
-    if (strncmp((char*)rx_buffer, "set_all,", 8) == 0)
-    {
-        uint16_t dac_value = (uint16_t)atoi((char*)rx_buffer + 8);
-        
-        // Validate DAC value (0-4095)
-        if (dac_value > 4095)
-        {
-            // Invalid value, ignore
-            return;
-        }
-        
-        // Set all channels to the same value
-        uint16_t dac_values[4] = {dac_value, dac_value, dac_value, dac_value};
-        HAL_StatusTypeDef status = MCP4728_SetAllChannels(&hi2c1, dac_values);
-        
-        // Send response: 1 for success, 0 for failure
-        if (status == HAL_OK)
-        {
-            int len = sprintf((char*)tx_buffer, "1\r\n");
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        }
-        else
-        {
-            int len = sprintf((char*)tx_buffer, "0\r\n");
-            HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
-        }
-        return;
-    }
-    
-    // Parse "channel,dac_value" format
-    char* comma = strchr((char*)rx_buffer, ',');
-    if (comma == NULL)
-    {
-        // Invalid format, ignore
-        return;
-    }
-    
-    // Split string at comma
-    *comma = '\0';
-    uint8_t channel = (uint8_t)atoi((char*)rx_buffer);
-    uint16_t dac_value = (uint16_t)atoi(comma + 1);
-    
-    // Validate channel (0-3) and DAC value (0-4095)
-    if (channel > 3 || dac_value > 4095)
-    {
-        // Invalid values, ignore
-        return;
-    }
-    
-    // Set DAC channel
-    HAL_StatusTypeDef status = MCP4728_WriteChannel(&hi2c1, (MCP4728_Channel)channel, dac_value);
-    
-    // Send response: 1 for success, 0 for failure
-    if (status == HAL_OK)
-    {
-        int len = sprintf((char*)tx_buffer, "1\r\n");
-        HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
+        SendASCII(tx_buffer, len);
+        return PROTO_ERR_NONE;
     }
+
+    if (strcmp(args, "BIN") == 0)
+        binary_mode = 1;
+    else if (strcmp(args, "ASCII") == 0)
+        binary_mode = 0;
     else
+        return PROTO_ERR_BAD_ARG;
+
+    int len = sprintf((char*)tx_buffer, "COMM_OK,%s\r\n", binary_mode ? "BIN" : "ASCII");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "test_adc" - test I2C communication with the ADC: "OK:0x<config register>"
+static Proto_Error_t Cmd_TestAdc(char *args)
+{
+    if (adc_handle == NULL)
+        return PROTO_ERR_HW;
+
+    // Try to read config register to test I2C communication
+    uint8_t reg_addr = 0x01; // Config register
+    uint8_t config_bytes[2] = {0};
+
+    if (HAL_I2C_Master_Transmit(&hi2c2, (ADS1115_ADDR_GND << 1), &reg_addr, 1, 100) != HAL_OK ||
+        HAL_I2C_Master_Receive(&hi2c2, (ADS1115_ADDR_GND << 1), config_bytes, 2, 100) != HAL_OK)
+        return PROTO_ERR_HW;
+
+    int len = sprintf((char*)tx_buffer, "OK:0x%02X%02X\r\n", config_bytes[0], config_bytes[1]);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "sweep,dac_ch,adc_ch,start,stop,steps,settle_us[,tol,max_us]" - run a full DAC sweep
+// with ADC capture on the MCU and stream the results back as one block. With tol (ADC
+// codes) each point waits at least settle_us, then until the readings agree or max_us
+static Proto_Error_t Cmd_Sweep(char *args)
+{
+    uint32_t values[8] = {0};
+    uint8_t count = ParseUIntList(args, values, 8);
+
+    if (adc_handle == NULL || (count != 6 && count != 8) ||
+        values[0] > 3 || values[1] > 3 || values[2] > 4095 || values[3] > 4095 ||
+        values[4] < 1 || values[4] > SWEEP_MAX_POINTS || values[5] > SWEEP_MAX_SETTLE_US ||
+        (count == 8 && (values[6] < 1 || values[6] > INT16_MAX || values[7] < 1 ||
+                        values[7] > SWEEP_MAX_SETTLE_US || values[7] < values[5])))
+        return PROTO_ERR_BAD_ARG;
+
+    RunSweep((uint8_t)values[0], (uint8_t)values[1], (uint16_t)values[2],
+             (uint16_t)values[3], (uint16_t)values[4], values[5],
+             (uint16_t)values[6], values[7]);
+    SendSweepASCII((uint16_t)values[2], (uint16_t)values[3], (uint16_t)values[4], count == 8);
+    return PROTO_ERR_NONE;
+}
+
+// "scan,mask,oversample" - convert every channel in mask back-to-back and reply
+// with all voltages in one line
+static Proto_Error_t Cmd_Scan(char *args)
+{
+    uint32_t values[2] = {0};
+    uint8_t count = ParseUIntList(args, values, 2);
+
+    if (adc_handle == NULL || count != 2 || values[0] < 0x01 || (values[0] & ~AdcChannelMask()) ||
+        values[1] < 1 || values[1] > SCAN_MAX_OVERSAMPLE)
+        return PROTO_ERR_BAD_ARG;
+
+    int16_t codes[ADC_CHANNELS];
+    uint32_t time_us = Micros();
+    uint8_t n = RunScan((uint16_t)values[0], (uint8_t)values[1], codes);
+
+    int len = sprintf((char*)tx_buffer, "SCAN,%u", (unsigned int)values[0]);
+    for (uint8_t i = 0; i < n; i++)
     {
-        int len = sprintf((char*)tx_buffer, "0\r\n");
-        HAL_UART_Transmit(&huart2, tx_buffer, len, 100);
+        tx_buffer[len++] = ',';
+        if (codes[i] == INT16_MIN)
+            len += sprintf((char*)tx_buffer + len, "nan");
+        else
+            len += FormatFixed((char*)tx_buffer + len, ADS1115_CodeToVoltage(codes[i]), 4);
     }
+    if (timestamps_on)
+        len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)time_us);
+    len += sprintf((char*)tx_buffer + len, "\r\n");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
 }
 
-/**
-  * @brief  Read voltage from ADS1115 ADC channel
-  * @param  channel: ADC channel (0-3)
-  * @retval Voltage in Volts
-  */
-float ADS1115_ReadVoltage(uint8_t channel)
+// "wave_load,ch,offset,c0,c1,..." - append DAC codes to a channel's waveform table;
+// offset 0 starts a new table, "wave_load,ch,0" clears it
+static Proto_Error_t Cmd_WaveLoad(char *args)
 {
-    if (adc_handle == NULL || channel > 3)
+    uint32_t values[2 + 16] = {0};
+    uint16_t codes[16];
+    uint8_t count = ParseUIntList(args, values, 2 + 16);
+
+    if (count < 2 || values[0] > 3 || values[1] >= WAVE_MAX_POINTS)
+        return PROTO_ERR_BAD_ARG;
+
+    for (uint8_t i = 2; i < count; i++)
     {
-        return 0.0f;
+        codes[i - 2] = (values[i] > 4095) ? 0xFFFF : (uint16_t)values[i];
     }
-    
-    // Map channel to MUX setting (AINx vs GND)
-    ADS1115_MUX_t mux_settings[4] = {
-        ADS1115_MUX_AIN0_GND,  // Channel 0 -> AIN0 vs GND
-        ADS1115_MUX_AIN1_GND,  // Channel 1 -> AIN1 vs GND
-        ADS1115_MUX_AIN2_GND,  // Channel 2 -> AIN2 vs GND
-        ADS1115_MUX_AIN3_GND   // Channel 3 -> AIN3 vs GND
-    };
-    
-    // Update config for selected channel
-    ADS1115_Config_t config = adc_handle->config;
-    config.channel = mux_settings[channel];
-    // Update the handle's config so oneShotMeasure uses the correct channel
-    adc_handle->config = config;
-    
-    // Perform one-shot measurement (this function writes config and waits for conversion)
-    int16_t adc_value = ADS1115_oneShotMeasure(adc_handle);
-    
-    // Check if we got a valid reading (0 could mean error or actual 0V)
-    // For debugging, we'll check if I2C communication is working
-    // If adc_value is 0, it might be an error, but it could also be actual 0V
-    
-    // Convert to voltage
-    // ADS1115 with ±6.144V range: 
-    // - Full scale: ±32768 counts for ±6.144V
-    // - LSB = 6.144V / 32768 = 187.5 µV per count
-    // - For 0-5V input, we expect values from 0 to ~26666 (5V / 0.0001875V)
-    // Note: adc_value is signed, but for single-ended measurements (AINx vs GND),
+    if (Wave_Load((uint8_t)values[0], (uint16_t)values[1], codes, count - 2) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+
+    int len = sprintf((char*)tx_buffer, "1\r\n");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "wave_play,rate,loops[,adc_ch]" - clock the loaded tables out to the DAC from TIM6,
+// optionally capturing one ADC sample after each step
+static Proto_Error_t Cmd_WavePlay(char *args)
+{
+    uint32_t values[3] = {0, 0, WAVE_NO_CAPTURE};
+    uint8_t count = ParseUIntList(args, values, 3);
+
+    if (adc_handle == NULL || count < 2 || values[0] < 1 || values[0] > WAVE_MAX_RATE ||
+        values[1] < 1 || values[1] > WAVE_MAX_LOOPS ||
+        (count == 3 && (values[2] > 3 || values[0] > WAVE_MAX_CAPTURE_RATE ||
+                        (uint32_t)Wave_GetLength() * values[1] > SWEEP_MAX_POINTS)) ||
+        Wave_GetLength() == 0)
+        return PROTO_ERR_BAD_ARG;
+
+    RunWave((uint16_t)values[0], (uint16_t)values[1], (uint8_t)values[2], 0, 0);
+    return PROTO_ERR_NONE;
+}
+
+// "stream,ch,rate,n" - continuous-mode capture of n samples at up to 860 SPS,
+// shipped in blocks while acquisition continues
+static Proto_Error_t Cmd_Stream(char *args)
+{
+    uint32_t values[3] = {0};
+    uint8_t count = ParseUIntList(args, values, 3);
+
+    if (adc_handle == NULL || count != 3 || values[0] >= ADC_CHANNELS ||
+        adc_chips[values[0] / 4] == NULL || values[1] < 1 || values[1] > 860 || values[2] < 1 || values[2] > STREAM_MAX_SAMPLES)
+        return PROTO_ERR_BAD_ARG;
+
+    RunStream((uint8_t)values[0], (uint16_t)values[1], values[2], 0, 0);
+    return PROTO_ERR_NONE;
+}
+
+// "i2c_speed,bus,hz" - change I2C1 (DAC) or I2C2 (ADC) bus speed, replies with the
+// SCL rate the clock divider actually gives
+static Proto_Error_t Cmd_I2CSpeed(char *args)
+{
+    uint32_t values[2] = {0};
+    uint8_t count = ParseUIntList(args, values, 2);
+    I2C_HandleTypeDef *hi2c = NULL;
+
+    if (count == 2 && values[0] == 1)
+        hi2c = &hi2c1;
+    else if (count == 2 && values[0] == 2)
+        hi2c = &hi2c2;
+
+    if (hi2c == NULL || I2C_SetSpeed(hi2c, values[1]) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+
+    int len = sprintf((char*)tx_buffer, "I2C_SPEED,%u,%lu\r\n",
+                      (unsigned int)values[0], (unsigned long)I2C_GetSpeed(hi2c));
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "time" - current TIM2 time for host clock alignment: "TIME,<us>"
+static Proto_Error_t Cmd_Time(char *args)
+{
+    int len = sprintf((char*)tx_buffer, "TIME,%lu\r\n", (unsigned long)Micros());
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+/**
+  * @brief  Parse a "0" / "1" argument
+  * @param  args: Argument text
+  * @param  value: Output
+  * @retval PROTO_ERR_NONE, PROTO_ERR_BAD_ARG for anything else
+  */
+static Proto_Error_t ParseFlag(const char *args, uint8_t *value)
+{
+    if (strcmp(args, "0") != 0 && strcmp(args, "1") != 0)
+        return PROTO_ERR_BAD_ARG;
+    *value = (uint8_t)(args[0] - '0');
+    return PROTO_ERR_NONE;
+}
+
+/**
+  * @brief  Send the "1" acknowledgment of a command without other reply data
+  * @retval PROTO_ERR_NONE
+  */
+static Proto_Error_t SendAck(void)
+{
+    int len = sprintf((char*)tx_buffer, "1\r\n");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "timestamps,0|1" - append TIM2 microsecond timestamps to readings
+static Proto_Error_t Cmd_Timestamps(char *args)
+{
+    if (ParseFlag(args, &timestamps_on) != PROTO_ERR_NONE)
+        return PROTO_ERR_BAD_ARG;
+    return SendAck();
+}
+
+// "stats" / "stats,1" - dump the profiling counters (",1" clears them after)
+static Proto_Error_t Cmd_Stats(char *args)
+{
+    if (args != NULL && strcmp(args, "1") != 0)
+        return PROTO_ERR_BAD_ARG;
+
+    SendStatsASCII();
+    if (args != NULL)
+        Stats_Reset();
+    return PROTO_ERR_NONE;
+}
+
+// "trig" - pulse the OPM trigger output now
+static Proto_Error_t Cmd_Trig(char *args)
+{
+    PulseOPMTrigger();
+    return SendAck();
+}
+
+// "trig_out,0|1" - pulse the OPM trigger on every on-MCU sweep step
+static Proto_Error_t Cmd_TrigOut(char *args)
+{
+    if (ParseFlag(args, &opm_trigger_per_step) != PROTO_ERR_NONE)
+        return PROTO_ERR_BAD_ARG;
+    return SendAck();
+}
+
+// "shunt,ch,mohm" - shunt resistance for the constant-current setpoint
+static Proto_Error_t Cmd_Shunt(char *args)
+{
+    uint32_t values[2] = {0};
+    if (ParseUIntList(args, values, 2) != 2 || CC_SetShunt((uint8_t)values[0], values[1]) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+    return SendAck();
+}
+
+// "cc,ch,mA[,max_code]" - regulate the shunt current of channel ch on the MCU
+// (DAC ch drives, AIN ch reads the shunt); max_code is the compliance limit
+static Proto_Error_t Cmd_CC(char *args)
+{
+    char* field = args;
+    char* end;
+    uint32_t channel = strtoul(field, &end, 10);
+    HAL_StatusTypeDef status = HAL_ERROR;
+
+    if (end != field && *end == ',' && adc_handle != NULL)
+    {
+        field = end + 1;
+        int32_t target_ua = 0;
+        end = ParseFixed(field, 3, &target_ua);
+        uint32_t max_code = 4095;
+
+        if (end != field && *end == ',')
+        {
+            field = end + 1;
+            max_code = strtoul(field, &end, 10);
+            if (end == field)
+                end = NULL;
+        }
+        if (end != NULL && *end == '\0' && target_ua >= 0 && target_ua <= 1000000 &&
+            max_code <= 4095)
+            status = CC_Start(&hi2c1, adc_handle, (uint8_t)channel, target_ua, (uint16_t)max_code);
+    }
+
+    if (status != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+
+    CC_Status_t cc;
+    CC_GetStatus(&cc);
+    int len = sprintf((char*)tx_buffer, "CC,%u,%d\r\n", cc.channel, cc.target_code);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "cc_off" - stop the constant-current loop, DAC keeps its last code
+static Proto_Error_t Cmd_CCOff(char *args)
+{
+    CC_Stop();
+    return SendAck();
+}
+
+// "cc_gain,kp_q16,ki_q16" - PI gains in Q16 DAC codes per ADC code
+static Proto_Error_t Cmd_CCGain(char *args)
+{
+    uint32_t values[2] = {0};
+    if (ParseUIntList(args, values, 2) != 2 || values[0] > INT32_MAX || values[1] > INT32_MAX)
+        return PROTO_ERR_BAD_ARG;
+
+    CC_SetGains((int32_t)values[0], (int32_t)values[1]);
+    return SendAck();
+}
+
+// "cc_status" - "CC_STATUS,active,ch,target,adc,dac,compliance,iterations"
+static Proto_Error_t Cmd_CCStatus(char *args)
+{
+    CC_Status_t cc;
+    CC_GetStatus(&cc);
+    int len = sprintf((char*)tx_buffer, "CC_STATUS,%u,%u,%d,%d,%u,%u,%lu\r\n",
+                      cc.active, cc.channel, cc.target_code, cc.adc_code,
+                      cc.dac_code, cc.compliance, (unsigned long)cc.iterations);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "limit,ch,mA" - zero DAC ch from the ADS1115 ALERT interrupt as soon as a conversion
+// of AIN ch exceeds mA through the "shunt" resistance; re-arming clears a trip.
+// Replies "LIMIT,ch,threshold_code"
+static Proto_Error_t Cmd_Limit(char *args)
+{
+    char* field = args;
+    char* end;
+    uint32_t channel = strtoul(field, &end, 10);
+    HAL_StatusTypeDef status = HAL_ERROR;
+
+    if (end != field && *end == ',' && adc_handle != NULL && channel <= 3)
+    {
+        field = end + 1;
+        int32_t limit_ua = 0;
+        end = ParseFixed(field, 3, &limit_ua);
+        if (end != field && *end == '\0' && limit_ua > 0 && limit_ua <= 1000000)
+            status = Limit_Arm(&hi2c1, adc_handle, (uint8_t)channel, limit_ua,
+                               CC_GetShunt((uint8_t)channel));
+    }
+
+    if (status != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+
+    Limit_Status_t limit;
+    Limit_GetStatus(&limit);
+    int len = sprintf((char*)tx_buffer, "LIMIT,%u,%d\r\n", limit.channel, limit.threshold_code);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "limit_off" - disarm the current limit
+static Proto_Error_t Cmd_LimitOff(char *args)
+{
+    Limit_Disarm();
+    return SendAck();
+}
+
+// "limit_status" - "LIMIT_STATUS,armed,ch,threshold,tripped,trips"
+static Proto_Error_t Cmd_LimitStatus(char *args)
+{
+    Limit_Status_t limit;
+    Limit_GetStatus(&limit);
+    int len = sprintf((char*)tx_buffer, "LIMIT_STATUS,%u,%u,%d,%u,%lu\r\n",
+                      limit.armed, limit.channel, limit.threshold_code,
+                      limit.tripped, (unsigned long)limit.trips);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "cal_set,adc|dac,ch,gain_q16,offset" - linear correction of one channel
+// (ADC: raw code -> code, DAC: requested code -> written code); clears its LUT
+static Proto_Error_t Cmd_CalSet(char *args)
+{
+    char* field = args;
+    int8_t target = ParseCalTarget(&field);
+    int32_t values[3] = {0};
+
+    if (target < 0 || ParseIntList(field, values, 3) != 3 || values[0] < 0 || values[0] > 3 ||
+        Cal_SetLinear((Cal_Target_t)target, (uint8_t)values[0], values[1], values[2]) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+    return SendAck();
+}
+
+// "cal_pt,adc|dac,ch,index,in,out" - one piecewise-linear breakpoint; index 0 starts
+// a new table, points follow in ascending order
+static Proto_Error_t Cmd_CalPoint(char *args)
+{
+    char* field = args;
+    int8_t target = ParseCalTarget(&field);
+    int32_t values[4] = {0};
+
+    if (target < 0 || ParseIntList(field, values, 4) != 4 ||
+        values[0] < 0 || values[0] > 3 || values[1] < 0 || values[1] >= CAL_LUT_POINTS ||
+        values[2] < INT16_MIN || values[2] > INT16_MAX || values[3] < INT16_MIN || values[3] > INT16_MAX ||
+        Cal_SetPoint((Cal_Target_t)target, (uint8_t)values[0], (uint8_t)values[1],
+                     (int16_t)values[2], (int16_t)values[3]) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+    return SendAck();
+}
+
+// "cal_get,adc|dac,ch" - "CAL,adc|dac,ch,gain_q16,offset,points[,in,out]..."
+static Proto_Error_t Cmd_CalGet(char *args)
+{
+    char* field = args;
+    int8_t target = ParseCalTarget(&field);
+    uint32_t channel = 0;
+    Cal_Channel_t cal;
+
+    if (target < 0 || ParseUIntList(field, &channel, 1) != 1 ||
+        Cal_Get((Cal_Target_t)target, (uint8_t)channel, &cal) != HAL_OK)
+        return PROTO_ERR_BAD_ARG;
+
+    int len = sprintf((char*)tx_buffer, "CAL,%s,%lu,%ld,%ld,%u", (target == CAL_ADC) ? "adc" : "dac",
+                      (unsigned long)channel, (long)cal.gain_q16, (long)cal.offset, cal.points);
+    for (uint8_t i = 0; i < cal.points; i++)
+    {
+        // Longest pair is ",-32768,-32768" (14 bytes)
+        if (len > (int)sizeof(tx_buffer) - 18)
+        {
+            SendASCII(tx_buffer, len);
+            len = 0;
+        }
+        len += sprintf((char*)tx_buffer + len, ",%d,%d", cal.lut_in[i], cal.lut_out[i]);
+    }
+    len += sprintf((char*)tx_buffer + len, "\r\n");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "cal_save" - write the calibration to flash. The sector erase stalls the CPU, and
+// with it the current limit and the CC loop, so both must be off
+static Proto_Error_t Cmd_CalSave(char *args)
+{
+    if (Limit_IsArmed() || CC_IsActive())
+        return PROTO_ERR_BAD_ARG;
+    if (Cal_Save() != HAL_OK)
+        return PROTO_ERR_HW;
+    return SendAck();
+}
+
+// "cal_load" - discard unsaved changes and reload the flash copy
+static Proto_Error_t Cmd_CalLoad(char *args)
+{
+    if (Cal_Load() != HAL_OK)
+        return PROTO_ERR_HW;
+    return SendAck();
+}
+
+// "cal_clear" - every channel back to identity (flash keeps its copy until the next cal_save)
+static Proto_Error_t Cmd_CalClear(char *args)
+{
+    Cal_Reset();
+    return SendAck();
+}
+
+// "read_adc_raw,channel" - read the uncalibrated ADC code (debugging, calibration)
+static Proto_Error_t Cmd_ReadAdcRaw(char *args)
+{
+    uint32_t channel = 0;
+
+    if (adc_handle == NULL || ParseUIntList(args, &channel, 1) != 1 || channel > 3)
+        return PROTO_ERR_BAD_ARG;
+
+    // Select the channel (AINx vs GND)
+    adc_handle->config.channel = ADS1115_MUX_SINGLE_ENDED(channel);
+
+    // Read raw ADC value
+    int16_t raw_adc = ADS1115_oneShotMeasure(adc_handle);
+
+    int len = sprintf((char*)tx_buffer, "%d\r\n", raw_adc);
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "read_adc,channel[,oversample[,filter]]" - read ADC voltage, optionally filtered
+// on the MCU (replies "voltage,stddev" when oversampling)
+static Proto_Error_t Cmd_ReadAdc(char *args)
+{
+    uint32_t values[3] = {0, 1, SMU_FILTER_BOXCAR};
+    uint8_t count = ParseUIntList(args, values, 3);
+    uint8_t channel = (uint8_t)values[0];
+
+    if (adc_handle == NULL || count < 1 || values[0] > 3)
+        return PROTO_ERR_BAD_ARG;
+
+    if (count > 1 || ADC_Range_IsAuto(channel))
+    {
+        if (values[1] < 1 || values[1] > SMU_FILTER_MAX_SAMPLES || values[2] > SMU_FILTER_DECIMATE)
+            return PROTO_ERR_BAD_ARG;
+
+        float stddev = 0.0f;
+        ADS1115_PGA_t range = ADS1115_PGA_6V144;
+        uint32_t time_us = Micros();
+        float voltage = ADS1115_ReadVoltage(channel, (uint16_t)values[1], (SMU_Filter_t)values[2],
+                                            &stddev, &range);
+        int len = FormatFixed((char*)tx_buffer, voltage, 6);
+        tx_buffer[len++] = ',';
+        len += FormatFixed((char*)tx_buffer + len, stddev, 6);
+        // Autoranged channels always carry the range tag
+        if (ADC_Range_IsAuto(channel))
+            len += sprintf((char*)tx_buffer + len, ",%u", (unsigned)range);
+        if (timestamps_on)
+            len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)time_us);
+        len += sprintf((char*)tx_buffer + len, "\r\n");
+        SendASCII(tx_buffer, len);
+        return PROTO_ERR_NONE;
+    }
+
+    // Read voltage from ADC (this also reads the raw ADC value internally)
+    uint32_t time_us = Micros();
+    float voltage = ADS1115_ReadVoltage(channel, 1, SMU_FILTER_BOXCAR, NULL, NULL);
+
+    // Send response: voltage as float string, then the timestamp if enabled
+    int len = FormatFixed((char*)tx_buffer, voltage, 4);
+    if (timestamps_on)
+        len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)time_us);
+    len += sprintf((char*)tx_buffer + len, "\r\n");
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "autorange,channel,enable" - per-channel automatic PGA ranging for read_adc
+static Proto_Error_t Cmd_Autorange(char *args)
+{
+    uint32_t values[2] = {0, 0};
+
+    if (ParseUIntList(args, values, 2) != 2 || values[0] > 3 || values[1] > 1)
+        return PROTO_ERR_BAD_ARG;
+
+    ADC_Range_SetAuto((uint8_t)values[0], (uint8_t)values[1]);
+    return SendAck();
+}
+
+// "autorange_status" - reply: AUTORANGE,mask,pga0,pga1,pga2,pga3
+static Proto_Error_t Cmd_AutorangeStatus(char *args)
+{
+    uint8_t mask = 0;
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if (ADC_Range_IsAuto(ch))
+            mask |= (uint8_t)(1 << ch);
+    }
+    int len = sprintf((char*)tx_buffer, "AUTORANGE,%u,%u,%u,%u,%u\r\n", (unsigned)mask,
+                      (unsigned)ADC_Range_Get(0), (unsigned)ADC_Range_Get(1),
+                      (unsigned)ADC_Range_Get(2), (unsigned)ADC_Range_Get(3));
+    SendASCII(tx_buffer, len);
+    return PROTO_ERR_NONE;
+}
+
+// "set_all,dac_value" - set all channels to the same value
+static Proto_Error_t Cmd_SetAll(char *args)
+{
+    uint32_t dac_value = 0;
+
+    if (ParseUIntList(args, &dac_value, 1) != 1 || dac_value > 4095)
+        return PROTO_ERR_BAD_ARG;
+
+    uint16_t code = (uint16_t)dac_value;
+    uint16_t dac_values[4] = {code, code, code, code};
+    Cal_DacCodes(dac_values, 0x0F);
+    if (MCP4728_SetAllChannels(&hi2c1, dac_values) != HAL_OK)
+        return PROTO_ERR_HW;
+    return SendAck();
+}
+
+// "set_multi,v0,v1,v2,v3" - stage all given channels, then latch them together.
+// An empty or "-" field leaves that channel unchanged.
+static Proto_Error_t Cmd_SetMulti(char *args)
+{
+    uint16_t dac_values[4] = {0};
+    uint8_t mask = 0;
+    uint8_t fields = 0;
+    char* field = args;
+
+    while (fields < 4)
+    {
+        char* end = field;
+        if (*field != ',' && *field != '\0' && *field != '-')
+        {
+            unsigned long value = strtoul(field, &end, 10);
+            if (end == field || value > 4095)
+                return PROTO_ERR_BAD_ARG;
+            dac_values[fields] = (uint16_t)value;
+            mask |= (1 << fields);
+        }
+        else if (*field == '-')
+        {
+            end = field + 1;
+        }
+        fields++;
+
+        if (*end == ',')
+            field = end + 1;
+        else if (*end == '\0')
+            break;
+        else
+            return PROTO_ERR_BAD_ARG;
+    }
+
+    if (mask == 0)
+        return PROTO_ERR_BAD_ARG;
+
+    Cal_DacCodes(dac_values, mask);
+    if (MCP4728_SetChannelsSync(&hi2c1, dac_values, mask) != HAL_OK)
+        return PROTO_ERR_HW;
+    return SendAck();
+}
+
+// "channel,dac_value" - set one DAC channel (the hot path of host-driven sweeps,
+// dispatched on its leading digit without a table lookup)
+static Proto_Error_t Cmd_SetDac(char *line)
+{
+    uint32_t values[2] = {0};
+
+    if (ParseUIntList(line, values, 2) != 2 || values[0] > 3 || values[1] > 4095)
+        return PROTO_ERR_BAD_ARG;
+
+    if (MCP4728_WriteChannel(&hi2c1, (MCP4728_Channel)values[0],
+                             Cal_DacCode((uint8_t)values[0], (uint16_t)values[1])) != HAL_OK)
+        return PROTO_ERR_HW;
+    return SendAck();
+}
+
+// Command table, grouped by first character (Command_InitIndex relies on it).
+// args: what may follow the name
+typedef enum {
+    CMD_ARGS_NONE = 0,      // Bare "<name>"
+    CMD_ARGS_REQUIRED,      // "<name>,<args>"
+    CMD_ARGS_OPTIONAL       // Either form
+} Command_Args_t;
+
+typedef struct {
+    const char *name;
+    uint8_t length;
+    Command_Args_t args;
+    Proto_Error_t (*handler)(char *args);
+} Command_t;
+
+#define COMMAND(name, args, handler)  { name, sizeof(name) - 1, args, handler }
+
+static const Command_t commands[] = {
+    COMMAND("COMM_OK",          CMD_ARGS_OPTIONAL, Cmd_CommOk),
+    COMMAND("autorange",        CMD_ARGS_REQUIRED, Cmd_Autorange),
+    COMMAND("autorange_status", CMD_ARGS_NONE,     Cmd_AutorangeStatus),
+    COMMAND("cc",               CMD_ARGS_REQUIRED, Cmd_CC),
+    COMMAND("cc_off",           CMD_ARGS_NONE,     Cmd_CCOff),
+    COMMAND("cc_gain",          CMD_ARGS_REQUIRED, Cmd_CCGain),
+    COMMAND("cc_status",        CMD_ARGS_NONE,     Cmd_CCStatus),
+    COMMAND("cal_set",          CMD_ARGS_REQUIRED, Cmd_CalSet),
+    COMMAND("cal_pt",           CMD_ARGS_REQUIRED, Cmd_CalPoint),
+    COMMAND("cal_get",          CMD_ARGS_REQUIRED, Cmd_CalGet),
+    COMMAND("cal_save",         CMD_ARGS_NONE,     Cmd_CalSave),
+    COMMAND("cal_load",         CMD_ARGS_NONE,     Cmd_CalLoad),
+    COMMAND("cal_clear",        CMD_ARGS_NONE,     Cmd_CalClear),
+    COMMAND("i2c_speed",        CMD_ARGS_REQUIRED, Cmd_I2CSpeed),
+    COMMAND("limit",            CMD_ARGS_REQUIRED, Cmd_Limit),
+    COMMAND("limit_off",        CMD_ARGS_NONE,     Cmd_LimitOff),
+    COMMAND("limit_status",     CMD_ARGS_NONE,     Cmd_LimitStatus),
+    COMMAND("read_adc",         CMD_ARGS_REQUIRED, Cmd_ReadAdc),
+    COMMAND("read_adc_raw",     CMD_ARGS_REQUIRED, Cmd_ReadAdcRaw),
+    COMMAND("sweep",            CMD_ARGS_REQUIRED, Cmd_Sweep),
+    COMMAND("scan",             CMD_ARGS_REQUIRED, Cmd_Scan),
+    COMMAND("stream",           CMD_ARGS_REQUIRED, Cmd_Stream),
+    COMMAND("stats",            CMD_ARGS_OPTIONAL, Cmd_Stats),
+    COMMAND("shunt",            CMD_ARGS_REQUIRED, Cmd_Shunt),
+    COMMAND("set_all",          CMD_ARGS_REQUIRED, Cmd_SetAll),
+    COMMAND("set_multi",        CMD_ARGS_REQUIRED, Cmd_SetMulti),
+    COMMAND("test_adc",         CMD_ARGS_NONE,     Cmd_TestAdc),
+    COMMAND("time",             CMD_ARGS_NONE,     Cmd_Time),
+    COMMAND("timestamps",       CMD_ARGS_REQUIRED, Cmd_Timestamps),
+    COMMAND("trig",             CMD_ARGS_NONE,     Cmd_Trig),
+    COMMAND("trig_out",         CMD_ARGS_REQUIRED, Cmd_TrigOut),
+    COMMAND("wave_load",        CMD_ARGS_REQUIRED, Cmd_WaveLoad),
+    COMMAND("wave_play",        CMD_ARGS_REQUIRED, Cmd_WavePlay),
+};
+
+#define COMMAND_COUNT       (sizeof(commands) / sizeof(commands[0]))
+
+// First-character index into commands[]: entries command_first[c] to command_first[c + 1] - 1
+// start with character COMMAND_INDEX_BASE + c
+#define COMMAND_INDEX_BASE  'A'
+#define COMMAND_INDEX_SIZE  ('z' - COMMAND_INDEX_BASE + 1)
+static uint8_t command_first[COMMAND_INDEX_SIZE + 1];
+
+/**
+  * @brief  Build the first-character index of the command table
+  * @retval None
+  */
+static void Command_InitIndex(void)
+{
+    uint8_t entry = 0;
+
+    for (uint8_t c = 0; c <= COMMAND_INDEX_SIZE; c++)
+    {
+        command_first[c] = entry;
+        while (entry < COMMAND_COUNT &&
+               (uint8_t)(commands[entry].name[0] - COMMAND_INDEX_BASE) == c)
+            entry++;
+    }
+}
+
+/**
+  * @brief  Look up and run the ASCII command in rx_buffer
+  * @note   Lookup cost depends only on how many commands share the first character.
+  *         Every command gets a reply: its own on success, "ERR,<code>" (the
+  *         Proto_Error_t codes) on failure, so the host never waits out a timeout
+  * @retval None
+  */
+void ProcessUARTCommand(void)
+{
+    char *line = (char*)rx_buffer;
+    Proto_Error_t error = PROTO_ERR_UNKNOWN_OP;
+
+    if (line[0] >= '0' && line[0] <= '9')
+    {
+        error = Cmd_SetDac(line);
+    }
+    else if (line[0] >= COMMAND_INDEX_BASE && line[0] <= 'z')
+    {
+        uint8_t c = (uint8_t)(line[0] - COMMAND_INDEX_BASE);
+        char *comma = strchr(line, ',');
+        size_t length = (comma != NULL) ? (size_t)(comma - line) : strlen(line);
+
+        for (uint8_t i = command_first[c]; i < command_first[c + 1]; i++)
+        {
+            const Command_t *command = &commands[i];
+            if (command->length != length || memcmp(command->name, line, length) != 0)
+                continue;
+
+            if ((comma == NULL && command->args == CMD_ARGS_REQUIRED) ||
+                (comma != NULL && command->args == CMD_ARGS_NONE))
+                error = PROTO_ERR_BAD_ARG;
+            else
+                error = command->handler((comma != NULL) ? comma + 1 : NULL);
+            break;
+        }
+    }
+
+    if (error != PROTO_ERR_NONE)
+    {
+        int len = sprintf((char*)tx_buffer, "ERR,%u\r\n", (unsigned)error);
+        SendASCII(tx_buffer, len);
+    }
+}
+
+/**
+  * @brief  Parse a comma-separated list of unsigned integers in place
+  * @param  str: Input string, e.g. "0,1,0,4095,100,500"
+  * @param  values: Output array
+  * @param  max_values: Capacity of the output array
+  * @retval Number of values parsed (parsing stops at the first malformed field)
+  */
+static uint8_t ParseUIntList(char *str, uint32_t *values, uint8_t max_values)
+{
+    uint8_t count = 0;
+    char *end;
+
+    while (count < max_values && *str != '\0')
+    {
+        uint32_t value = strtoul(str, &end, 0);
+        if (end == str)
+            break;  // Not a number
+
+        values[count++] = value;
+
+        if (*end != ',')
+            break;
+        str = end + 1;
+    }
+    return count;
+}
+
+/**
+  * @brief  Parse a comma-separated list of signed decimal integers in place
+  * @param  str: Input string, e.g. "65536,-12"
+  * @param  values: Output array
+  * @param  max_values: Capacity of the output array
+  * @retval Number of values parsed (parsing stops at the first malformed field)
+  */
+static uint8_t ParseIntList(char *str, int32_t *values, uint8_t max_values)
+{
+    uint8_t count = 0;
+    char *end;
+
+    while (count < max_values && *str != '\0')
+    {
+        long value = strtol(str, &end, 10);
+        if (end == str)
+            break;  // Not a number
+
+        values[count++] = (int32_t)value;
+
+        if (*end != ',')
+            break;
+        str = end + 1;
+    }
+    return count;
+}
+
+/**
+  * @brief  Parse a decimal number into fixed point (newlib's strtof allocates)
+  * @param  str: Input, e.g. "12.5" or "-0.25"
+  * @param  decimals: Fraction digits kept (0-6); further digits are truncated
+  * @param  value: Output, the number times 10^decimals, saturated to int32
+  * @retval First character after the number, str if there is none
+  */
+static char* ParseFixed(char *str, uint8_t decimals, int32_t *value)
+{
+    char *p = str;
+    int64_t magnitude = 0;
+    uint8_t digits = 0;
+    uint8_t kept = 0;
+    int8_t sign = 1;
+
+    if (*p == '-' || *p == '+')
+        sign = (*p++ == '-') ? -1 : 1;
+
+    for (; *p >= '0' && *p <= '9'; p++, digits++)
+    {
+        if (magnitude <= INT32_MAX)
+            magnitude = magnitude * 10 + (*p - '0');
+    }
+    if (*p == '.')
+    {
+        for (p++; *p >= '0' && *p <= '9'; p++, digits++)
+        {
+            if (kept < decimals)
+            {
+                magnitude = magnitude * 10 + (*p - '0');
+                kept++;
+            }
+        }
+    }
+    if (digits == 0)
+        return str;
+
+    for (; kept < decimals; kept++)
+        magnitude *= 10;
+    if (magnitude > INT32_MAX)
+        magnitude = INT32_MAX;
+
+    *value = (int32_t)(sign * magnitude);
+    return p;
+}
+
+/**
+  * @brief  Print a value with a fixed number of decimals using integer formatting only
+  *         (newlib's %f pulls in its heap-allocating dtoa)
+  * @param  out: Output buffer
+  * @param  value: Value to print (|value| * 10^decimals below 2^31)
+  * @param  decimals: Fraction digits (1-6)
+  * @retval Characters written
+  */
+static int FormatFixed(char *out, float value, uint8_t decimals)
+{
+    static const uint32_t scale[7] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+    float scaled = value * (float)scale[decimals];
+    int32_t units = (int32_t)(scaled + ((scaled >= 0.0f) ? 0.5f : -0.5f));
+    uint32_t magnitude = (units < 0) ? (uint32_t)(-units) : (uint32_t)units;
+
+    return sprintf(out, "%s%lu.%0*lu", (units < 0) ? "-" : "",
+                   (unsigned long)(magnitude / scale[decimals]), (int)decimals,
+                   (unsigned long)(magnitude % scale[decimals]));
+}
+
+/**
+  * @brief  Parse the "adc," / "dac," selector of a cal_* command
+  * @param  str: In: start of the selector, out: first character after its comma
+  * @retval CAL_ADC, CAL_DAC, or -1 if neither
+  */
+static int8_t ParseCalTarget(char **str)
+{
+    if (strncmp(*str, "adc,", 4) == 0)
+    {
+        *str += 4;
+        return CAL_ADC;
+    }
+    if (strncmp(*str, "dac,", 4) == 0)
+    {
+        *str += 4;
+        return CAL_DAC;
+    }
+    return -1;
+}
+
+/**
+  * @brief  One single-shot conversion that reports I2C errors
+  * @note   ADS1115_oneShotMeasure reads 0 on an error, which is a valid code
+  * @param  adc: ADS1115 handle
+  * @param  value: Output, raw code (untouched on error)
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef ADC_Convert(ADS1115_Handle_t *adc, int16_t *value)
+{
+    if (ADS1115_startConversion(adc) != HAL_OK)
+        return HAL_ERROR;
+    return ADS1115_readConversion(adc, value);
+}
+
+/**
+  * @brief  Run a DAC sweep with ADC capture entirely on the MCU
+  * @note   Each step writes the DAC, waits settle_us on the TIM2 time base and takes
+  *         one ADC conversion. Raw codes are kept in sweep_codes[] until sent, the
+  *         conversion start times in sweep_times[].
+  *         With a tolerance the settle time adapts per point: after settle_us, 860 SPS
+  *         readings are taken until SWEEP_SETTLE_AGREE in a row are within tolerance
+  *         of the previous one (a failed read starts the count over), or max_settle_us
+  *         after the DAC write. The point is then
+  *         converted at the configured data rate as usual, and the time from the DAC
+  *         write to that conversion is kept in sweep_settle[] (>= max_settle_us means
+  *         it never settled).
+  *         With "trig_out,1" the OPM trigger is pulsed right before each conversion.
+  *         Points whose DAC write or ADC conversion failed, and all points after a
+  *         current limit trip, read INT16_MIN (not measured).
+  * @param  dac_channel: DAC channel to sweep (0-3)
+  * @param  adc_channel: ADC channel to measure (0-3)
+  * @param  start: First DAC code (0-4095)
+  * @param  stop: Last DAC code (0-4095), may be below start for a downward sweep
+  * @param  steps: Number of points (1-SWEEP_MAX_POINTS)
+  * @param  settle_us: Settle time after each DAC write in microseconds (minimum with a tolerance,
+  *         at most SWEEP_MAX_SETTLE_US)
+  * @param  tolerance: Largest change between settled readings in raw ADC codes, 0 for fixed settling
+  * @param  max_settle_us: Adaptive settle cap after each DAC write in microseconds
+  * @retval None
+  */
+static void RunSweep(uint8_t dac_channel, uint8_t adc_channel, uint16_t start,
+                     uint16_t stop, uint16_t steps, uint32_t settle_us,
+                     uint16_t tolerance, uint32_t max_settle_us)
+{
+    int32_t span = (int32_t)stop - (int32_t)start;
+    ADS1115_DataRate_t rate = adc_handle->config.dataRate;
+
+    // Channel does not change during the sweep, select it once
+    adc_handle->config.channel = ADS1115_MUX_SINGLE_ENDED(adc_channel);
+
+    for (uint16_t i = 0; i < steps; i++)
+    {
+        uint16_t dac_value = (steps > 1) ? (uint16_t)(start + (span * i) / (steps - 1)) : start;
+
+        // A current limit trip ends the sweep; the remaining points read as not measured
+        if (Limit_IsTripped())
+        {
+            Limit_Poll(0);
+            for (; i < steps; i++)
+            {
+                sweep_codes[i] = INT16_MIN;
+                sweep_times[i] = 0;
+                sweep_settle[i] = 0;
+            }
+            break;
+        }
+
+        // A failed DAC write leaves the previous step on the output; do not measure it
+        if (MCP4728_WriteChannel(&hi2c1, (MCP4728_Channel)dac_channel,
+                                 Cal_DacCode(dac_channel, dac_value)) != HAL_OK)
+        {
+            sweep_codes[i] = INT16_MIN;
+            sweep_times[i] = 0;
+            sweep_settle[i] = 0;
+            continue;
+        }
+        uint32_t written_us = Micros();
+        Delay_us(settle_us);
+
+        if (tolerance > 0)
+        {
+            adc_handle->config.dataRate = ADS1115_DR_860SPS;
+            int16_t previous = 0;
+            uint8_t have_previous = 0;
+            uint8_t agree = 0;
+
+            while (agree < SWEEP_SETTLE_AGREE && (Micros() - written_us) < max_settle_us)
+            {
+                int16_t reading;
+
+                // A failed read is no evidence of settling, start the count over
+                if (ADC_Convert(adc_handle, &reading) != HAL_OK)
+                {
+                    have_previous = 0;
+                    agree = 0;
+                    continue;
+                }
+                agree = (have_previous && abs(reading - previous) <= tolerance) ? agree + 1 : 0;
+                previous = reading;
+                have_previous = 1;
+            }
+            adc_handle->config.dataRate = rate;
+        }
+
+        if (opm_trigger_per_step)
+            PulseOPMTrigger();
+        sweep_times[i] = Micros();
+        sweep_settle[i] = sweep_times[i] - written_us;
+
+        int16_t code;
+        if (ADC_Convert(adc_handle, &code) == HAL_OK)
+            sweep_codes[i] = Cal_AdcCode(adc_channel, code);
+        else
+        {
+            sweep_codes[i] = INT16_MIN;
+            sweep_times[i] = 0;
+            sweep_settle[i] = 0;
+        }
+    }
+}
+
+/**
+  * @brief  Send sweep results as a single ASCII block
+  * @note   Format: "SWEEP,<steps>\r\n", one "<dac_value>,<voltage>\r\n" line per point, "END\r\n".
+  *         Points not measured (current limit trip, failed DAC write or conversion) read "nan". With
+  *         timestamps on each line ends in ",<us>" (0 for points not measured), then
+  *         for an adaptive sweep in ",<settle_us>".
+  * @param  start: First DAC code of the sweep
+  * @param  stop: Last DAC code of the sweep
+  * @param  steps: Number of points captured
+  * @param  adaptive: 1 to append each point's settle time
+  * @retval None
+  */
+static void SendSweepASCII(uint16_t start, uint16_t stop, uint16_t steps, uint8_t adaptive)
+{
+    int32_t span = (int32_t)stop - (int32_t)start;
+
+    int len = sprintf((char*)tx_buffer, "SWEEP,%u\r\n", steps);
+    SendASCII(tx_buffer, len);
+
+    // Pack as many lines as fit into tx_buffer per transmit call
+    len = 0;
+    for (uint16_t i = 0; i < steps; i++)
+    {
+        uint16_t dac_value = (steps > 1) ? (uint16_t)(start + (span * i) / (steps - 1)) : start;
+
+        if (sweep_codes[i] == INT16_MIN)
+            len += sprintf((char*)tx_buffer + len, "%u,nan", dac_value);
+        else
+        {
+            len += sprintf((char*)tx_buffer + len, "%u,", dac_value);
+            len += FormatFixed((char*)tx_buffer + len, ADS1115_CodeToVoltage(sweep_codes[i]), 4);
+        }
+        if (timestamps_on)
+            len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)sweep_times[i]);
+        if (adaptive)
+            len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)sweep_settle[i]);
+        len += sprintf((char*)tx_buffer + len, "\r\n");
+
+        // Longest line is "4095,-6.1440,4294967295,4294967295\r\n" (36 bytes)
+        if (len > (int)sizeof(tx_buffer) - 38)
+        {
+            SendASCII(tx_buffer, len);
+            len = 0;
+        }
+    }
+    len += sprintf((char*)tx_buffer + len, "END\r\n");
+    SendASCII(tx_buffer, len);
+}
+
+/**
+  * @brief  Send the profiling statistics as ASCII lines
+  * @note   Format: "STATS,<core_hz>,<uptime_ms>\r\n", per timed path
+  *         "T,<name>,<count>,<min>,<mean>,<max>,<h0>,...,<h15>\r\n" (CPU cycles, then the
+  *         log2 microsecond histogram), per counter "C,<name>,<value>\r\n", "END\r\n".
+  * @retval None
+  */
+static void SendStatsASCII(void)
+{
+    int len = sprintf((char*)tx_buffer, "STATS,%lu,%lu\r\n",
+                      (unsigned long)SystemCoreClock, (unsigned long)HAL_GetTick());
+    SendASCII(tx_buffer, len);
+
+    for (uint8_t t = 0; t < STATS_TIMER_COUNT; t++)
+    {
+        Stats_Timing_t timing;
+        Stats_GetTiming((Stats_Timer_t)t, &timing);
+        uint32_t mean = (timing.count > 0) ? (uint32_t)(timing.total / timing.count) : 0;
+
+        len = sprintf((char*)tx_buffer, "T,%s,%lu,%lu,%lu,%lu", Stats_TimerName((Stats_Timer_t)t),
+                      (unsigned long)timing.count, (unsigned long)timing.min,
+                      (unsigned long)mean, (unsigned long)timing.max);
+        SendASCII(tx_buffer, len);
+
+        // Histogram in two halves, each fits tx_buffer even with 10-digit counts
+        for (uint8_t half = 0; half < 2; half++)
+        {
+            len = 0;
+            for (uint8_t b = half * STATS_HIST_BUCKETS / 2; b < (half + 1) * STATS_HIST_BUCKETS / 2; b++)
+                len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)timing.histogram[b]);
+            SendASCII(tx_buffer, len);
+        }
+        SendASCII((const uint8_t*)"\r\n", 2);
+    }
+
+    for (uint8_t c = 0; c < STATS_COUNTER_COUNT; c++)
+    {
+        len = sprintf((char*)tx_buffer, "C,%s,%lu\r\n", Stats_CounterName((Stats_Counter_t)c),
+                      (unsigned long)Stats_GetCounter((Stats_Counter_t)c));
+        SendASCII(tx_buffer, len);
+    }
+
+    len = sprintf((char*)tx_buffer, "END\r\n");
+    SendASCII(tx_buffer, len);
+}
+
+/**
+  * @brief  Send the profiling statistics as one PROTO_OP_STATS reply
+  * @note   Payload: [core_hz u32][uptime_ms u32][timers u8][counters u8], per timed path
+  *         [count u32][min u32][max u32][total u64][histogram u32 x STATS_HIST_BUCKETS]
+  *         (cycles, order of Stats_Timer_t), then [value u32] per counter.
+  * @param  seq: Sequence number of the request
+  * @retval None
+  */
+static void SendStatsFrame(uint8_t seq)
+{
+    uint8_t reply[10 + STATS_TIMER_COUNT * (20 + 4 * STATS_HIST_BUCKETS) + STATS_COUNTER_COUNT * 4];
+    uint8_t *out = reply;
+    uint32_t tick = HAL_GetTick();
+
+    memcpy(out, &SystemCoreClock, 4);
+    memcpy(out + 4, &tick, 4);
+    out[8] = STATS_TIMER_COUNT;
+    out[9] = STATS_COUNTER_COUNT;
+    out += 10;
+
+    for (uint8_t t = 0; t < STATS_TIMER_COUNT; t++)
+    {
+        Stats_Timing_t timing;
+        Stats_GetTiming((Stats_Timer_t)t, &timing);
+        memcpy(out, &timing.count, 4);
+        memcpy(out + 4, &timing.min, 4);
+        memcpy(out + 8, &timing.max, 4);
+        memcpy(out + 12, &timing.total, 8);
+        memcpy(out + 20, timing.histogram, sizeof(timing.histogram));
+        out += 20 + sizeof(timing.histogram);
+    }
+
+    for (uint8_t c = 0; c < STATS_COUNTER_COUNT; c++)
+    {
+        uint32_t value = Stats_GetCounter((Stats_Counter_t)c);
+        memcpy(out, &value, 4);
+        out += 4;
+    }
+
+    SendFrame(PROTO_OP_STATS | PROTO_REPLY_FLAG, seq, reply, sizeof(reply));
+}
+
+/**
+  * @brief  Channels of the ADS1115s that answered at init, as a scan mask
+  * @retval Bit 4n+k set for AINk of every present chip n
+  */
+static uint16_t AdcChannelMask(void)
+{
+    uint16_t mask = 0;
+
+    for (uint8_t chip = 0; chip < SMU_ADC_COUNT; chip++)
+    {
+        if (adc_chips[chip] != NULL)
+            mask |= (uint16_t)(0x0F << (4 * chip));
+    }
+    return mask;
+}
+
+/**
+  * @brief  Convert each channel in a mask back-to-back, averaging oversample conversions
+  * @note   Each pass starts a conversion on every chip that still has a channel pending
+  *         (its lowest one), then reads them all back, so the chips convert in parallel
+  *         and a full 16-channel scan takes as long as a 4-channel one. Only the MUX
+  *         field changes between conversions, so each one costs a single config write,
+  *         the conversion time and a data read, with no UART traffic in between.
+  *         Channels 4-15 are reported raw, calibration covers AIN0-3 of chip 0.
+  *         Conversions lost to an I2C error are left out of the average; a channel
+  *         with none left reads INT16_MIN.
+  * @param  mask: Channel bit mask, bit 4n+k selects AINk of chip n (see AdcChannelMask)
+  * @param  oversample: Conversions averaged per channel (1-SCAN_MAX_OVERSAMPLE)
+  * @param  codes: Output array with room for ADC_CHANNELS averaged codes, ascending channel order
+  * @retval Number of channels converted
+  */
+static uint8_t RunScan(uint16_t mask, uint8_t oversample, int16_t *codes)
+{
+    int32_t sums[ADC_CHANNELS] = {0};
+    uint8_t counts[ADC_CHANNELS] = {0};
+    uint16_t pending = mask & AdcChannelMask();
+    uint8_t n = 0;
+
+    while (pending != 0)
+    {
+        uint8_t ain[SMU_ADC_COUNT];
+        uint8_t started[SMU_ADC_COUNT];
+
+        for (uint8_t chip = 0; chip < SMU_ADC_COUNT; chip++)
+        {
+            ain[chip] = 0xFF;
+            for (uint8_t k = 0; k < 4; k++)
+            {
+                if (pending & (1 << (4 * chip + k)))
+                {
+                    ain[chip] = k;
+                    adc_chips[chip]->config.channel = ADS1115_MUX_SINGLE_ENDED(k);
+                    break;
+                }
+            }
+        }
+
+        for (uint8_t i = 0; i < oversample; i++)
+        {
+            for (uint8_t chip = 0; chip < SMU_ADC_COUNT; chip++)
+            {
+                started[chip] = (ain[chip] != 0xFF) &&
+                                ADS1115_startConversion(adc_chips[chip]) == HAL_OK;
+            }
+            for (uint8_t chip = 0; chip < SMU_ADC_COUNT; chip++)
+            {
+                int16_t value;
+                uint8_t ch = 4 * chip + ain[chip];
+
+                if (started[chip] && ADS1115_readConversion(adc_chips[chip], &value) == HAL_OK)
+                {
+                    sums[ch] += value;
+                    counts[ch]++;
+                }
+            }
+        }
+
+        for (uint8_t chip = 0; chip < SMU_ADC_COUNT; chip++)
+        {
+            if (ain[chip] != 0xFF)
+                pending &= (uint16_t)~(1 << (4 * chip + ain[chip]));
+        }
+    }
+
+    for (uint8_t ch = 0; ch < ADC_CHANNELS; ch++)
+    {
+        if ((mask & (1 << ch)) == 0)
+            continue;
+
+        if (counts[ch] == 0)
+        {
+            codes[n++] = INT16_MIN;
+            continue;
+        }
+
+        // Round to nearest rather than truncate toward zero
+        int32_t sum = sums[ch];
+        int32_t half = (sum >= 0) ? (counts[ch] / 2) : -(counts[ch] / 2);
+        codes[n++] = Cal_AdcCode(ch, (int16_t)((sum + half) / counts[ch]));
+    }
+    return n;
+}
+
+/**
+  * @brief  Stream continuous-mode conversions until count samples are shipped
+  * @note   ASCII: "STREAM,<count>,<sps>\r\n", then "D,<code>,<code>,...\r\n" per block,
+  *         then "END,<overruns>\r\n". Binary: one PROTO_OP_STREAM frame per block, then
+  *         PROTO_OP_STREAM_END [samples u32][overruns u32]. Codes are calibrated (Cal_AdcCode).
+  *         With timestamps on each block starts with the ready time of its first
+  *         sample ("D,<us>,<code>,..." / [us u32][code i16 x n]).
+  *         Aborts early if no sample arrives for STREAM_STALL_MS.
+  * @param  adc_channel: ADC channel (0-15, AIN(adc_channel % 4) of chip adc_channel / 4)
+  * @param  sps: Requested rate, rounded up to the next ADS1115 data rate
+  * @param  count: Number of samples
+  * @param  binary: 1 to reply with binary frames
+  * @param  seq: Sequence number of the binary request
+  * @retval None
+  */
+static void RunStream(uint8_t adc_channel, uint16_t sps, uint32_t count,
+                      uint8_t binary, uint8_t seq)
+{
+    ADS1115_Handle_t *adc = adc_chips[adc_channel / 4];
+    ADS1115_DataRate_t previous_rate = adc->config.dataRate;
+    ADS1115_DataRate_t rate = ADS1115_dataRateFromSps(sps);
+    uint32_t shipped = 0;
+    int len;
+
+    if (!binary)
+    {
+        len = sprintf((char*)tx_buffer, "STREAM,%lu,%u\r\n",
+                      (unsigned long)count, ADS1115_dataRateToSps(rate));
+        SendASCII(tx_buffer, len);
+    }
+
+    // ALERT belongs to the current limit while it is armed; only chip 0's is wired
+    ADC_Stream_Start(adc, ADS1115_MUX_SINGLE_ENDED(adc_channel % 4), adc_channel, rate, count,
+                     SMU_ADC_USE_RDY_PIN && !Limit_IsArmed() && adc == adc_handle, Micros());
+
+    uint32_t last_progress = HAL_GetTick();
+    uint8_t acquiring = 1;
+
+    while (1)
+    {
+        ADC_Stream_Poll(Micros());
+
+        const int16_t* block;
+        uint16_t samples;
+        while ((block = ADC_Stream_GetBlock(&samples)) != NULL)
+        {
+            uint32_t block_us = ADC_Stream_GetBlockTime();
+            if (binary)
+            {
+                SendFrameSplit(PROTO_OP_STREAM | PROTO_REPLY_FLAG, seq,
+                               (const uint8_t*)&block_us, timestamps_on ? sizeof(block_us) : 0,
+                               (const uint8_t*)block, samples * sizeof(int16_t));
+            }
+            else
+            {
+                len = sprintf((char*)tx_buffer, "D");
+                if (timestamps_on)
+                    len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)block_us);
+                for (uint16_t i = 0; i < samples; i++)
+                {
+                    len += sprintf((char*)tx_buffer + len, ",%d", block[i]);
+                    // Longest field is ",-32768" (7 bytes)
+                    if (len > (int)sizeof(tx_buffer) - 10)
+                    {
+                        SendASCII(tx_buffer, len);
+                        len = 0;
+                    }
+                }
+                len += sprintf((char*)tx_buffer + len, "\r\n");
+                SendASCII(tx_buffer, len);
+            }
+
+            shipped += samples;
+            ADC_Stream_ReleaseBlock();
+            last_progress = HAL_GetTick();
+        }
+
+        if (!acquiring)
+            break;  // Remaining blocks shipped after stop
+
+        if (!ADC_Stream_IsActive() || (HAL_GetTick() - last_progress) > STREAM_STALL_MS)
+        {
+            ADC_Stream_Stop();
+            acquiring = 0;
+        }
+    }
+
+    adc->config.dataRate = previous_rate;
+
+    if (binary)
+    {
+        uint32_t summary[2] = {shipped, ADC_Stream_GetOverruns()};
+        SendFrame(PROTO_OP_STREAM_END | PROTO_REPLY_FLAG, seq, (const uint8_t*)summary, sizeof(summary));
+    }
+    else
+    {
+        len = sprintf((char*)tx_buffer, "END,%lu\r\n", (unsigned long)ADC_Stream_GetOverruns());
+        SendASCII(tx_buffer, len);
+    }
+}
+
+/**
+  * @brief  Play the loaded waveform tables and report the result
+  * @note   ASCII: "WAVE,<steps>,<captured>\r\n", then (with capture) "D,<code>,...\r\n"
+  *         lines, then "END,<missed>\r\n". Binary: (with capture) PROTO_OP_WAVE_PLAY
+  *         frames of codes, then PROTO_OP_WAVE_END [steps u32][missed u32].
+  *         Captured code i belongs to step i; a step the capture fell behind on is
+  *         reported as INT16_MIN. Step 0 is written when playback starts and step i
+  *         follows i / rate later on TIM6; with timestamps on the start time is
+  *         appended to "WAVE,..." and to the WAVE_END payload [start us u32].
+  * @param  rate: Steps per second
+  * @param  loops: Number of passes over the table
+  * @param  adc_channel: ADC channel to capture after each step, or WAVE_NO_CAPTURE
+  * @param  binary: 1 to reply with binary frames
+  * @param  seq: Sequence number of the binary request
+  * @retval None
+  */
+static void RunWave(uint16_t rate, uint16_t loops, uint8_t adc_channel,
+                    uint8_t binary, uint8_t seq)
+{
+    ADS1115_DataRate_t previous_rate = adc_handle->config.dataRate;
+    uint8_t capture = (adc_channel <= 3);
+    uint32_t steps_total = (uint32_t)Wave_GetLength() * loops;
+    uint32_t captured = 0;
+    uint32_t capture_missed = 0;
+    int len;
+
+    if (capture)
+    {
+        adc_handle->config.channel = ADS1115_MUX_SINGLE_ENDED(adc_channel);
+        adc_handle->config.dataRate = ADS1115_DR_860SPS;
+    }
+
+    uint32_t last_progress = HAL_GetTick();
+    uint32_t last_done = 0;
+    uint32_t stall_ms = STREAM_STALL_MS + 2000U / rate;
+    uint32_t start_us = Micros();
+
+    if (Wave_Start(&hi2c1, &htim6, TIM_GetAPB1TimerClock(), rate, loops) != HAL_OK)
+        steps_total = 0;
+
+    while (steps_total > 0)
+    {
+        uint32_t done = Wave_GetStepsDone();
+
+        if (done != last_done)
+        {
+            last_done = done;
+            last_progress = HAL_GetTick();
+        }
+
+        if (capture && captured < done)
+        {
+            // Only the latest step is worth converting once the capture falls behind
+            while (captured + 1 < done)
+            {
+                sweep_codes[captured++] = INT16_MIN;
+                capture_missed++;
+            }
+            sweep_codes[captured++] = Cal_AdcCode(adc_channel, ADS1115_oneShotMeasure(adc_handle));
+            continue;
+        }
+
+        if (!Wave_IsActive() && (!capture || captured >= done))
+            break;
+
+        if ((HAL_GetTick() - last_progress) > stall_ms)
+            break;
+    }
+
+    Wave_Stop();
+    adc_handle->config.dataRate = previous_rate;
+
+    uint32_t steps_done = Wave_GetStepsDone();
+    uint32_t missed = Wave_GetMissed() + capture_missed;
+
+    if (binary)
+    {
+        for (uint32_t i = 0; i < captured; i += ADC_STREAM_BLOCK_SAMPLES)
+        {
+            uint32_t n = captured - i;
+            if (n > ADC_STREAM_BLOCK_SAMPLES)
+                n = ADC_STREAM_BLOCK_SAMPLES;
+            SendFrame(PROTO_OP_WAVE_PLAY | PROTO_REPLY_FLAG, seq,
+                      (const uint8_t*)&sweep_codes[i], n * sizeof(int16_t));
+        }
+        uint32_t summary[3] = {steps_done, missed, start_us};
+        SendFrame(PROTO_OP_WAVE_END | PROTO_REPLY_FLAG, seq, (const uint8_t*)summary,
+                  timestamps_on ? sizeof(summary) : 2 * sizeof(uint32_t));
+        return;
+    }
+
+    len = sprintf((char*)tx_buffer, "WAVE,%lu,%lu", (unsigned long)steps_done, (unsigned long)captured);
+    if (timestamps_on)
+        len += sprintf((char*)tx_buffer + len, ",%lu", (unsigned long)start_us);
+    len += sprintf((char*)tx_buffer + len, "\r\n");
+    SendASCII(tx_buffer, len);
+
+    for (uint32_t i = 0; i < captured; i += ADC_STREAM_BLOCK_SAMPLES)
+    {
+        uint32_t end = i + ADC_STREAM_BLOCK_SAMPLES;
+        if (end > captured)
+            end = captured;
+
+        len = sprintf((char*)tx_buffer, "D");
+        for (uint32_t j = i; j < end; j++)
+        {
+            len += sprintf((char*)tx_buffer + len, ",%d", sweep_codes[j]);
+            // Longest field is ",-32768" (7 bytes)
+            if (len > (int)sizeof(tx_buffer) - 10)
+            {
+                SendASCII(tx_buffer, len);
+                len = 0;
+            }
+        }
+        len += sprintf((char*)tx_buffer + len, "\r\n");
+        SendASCII(tx_buffer, len);
+    }
+
+    len = sprintf((char*)tx_buffer, "END,%lu\r\n", (unsigned long)missed);
+    SendASCII(tx_buffer, len);
+}
+
+/**
+  * @brief  Send a binary protocol frame without copying the payload
+  * @param  opcode: Frame opcode
+  * @param  seq: Sequence number (echo of the request)
+  * @param  payload: Payload bytes (may be NULL when length is 0)
+  * @param  length: Payload length in bytes
+  * @retval None
+  */
+static void SendFrame(uint8_t opcode, uint8_t seq, const uint8_t *payload, uint16_t length)
+{
+    SendFrameSplit(opcode, seq, payload, length, NULL, 0);
+}
+
+/**
+  * @brief  Send a binary protocol frame whose payload is two separate buffers
+  *         (e.g. a timestamp then a sample block), without copying either
+  * @param  opcode: Frame opcode
+  * @param  seq: Sequence number (echo of the request)
+  * @param  first: First part of the payload (may be NULL when first_length is 0)
+  * @param  first_length: Length of the first part in bytes
+  * @param  second: Second part of the payload (may be NULL when second_length is 0)
+  * @param  second_length: Length of the second part in bytes
+  * @retval None
+  */
+static void SendFrameSplit(uint8_t opcode, uint8_t seq, const uint8_t *first, uint16_t first_length,
+                           const uint8_t *second, uint16_t second_length)
+{
+    const uint8_t *parts[2] = {first, second};
+    uint16_t lengths[2] = {first_length, second_length};
+
+    SendFrameParts(opcode, seq, parts, lengths, 2);
+}
+
+/**
+  * @brief  Send a binary protocol frame whose payload is several separate buffers
+  *         (e.g. sweep codes, timestamps and settle times), without copying any
+  * @param  opcode: Frame opcode
+  * @param  seq: Sequence number (echo of the request)
+  * @param  parts: Payload parts in order (entries may be NULL when their length is 0)
+  * @param  lengths: Length of each part in bytes
+  * @param  count: Number of parts
+  * @retval None
+  */
+static void SendFrameParts(uint8_t opcode, uint8_t seq, const uint8_t *const *parts,
+                           const uint16_t *lengths, uint8_t count)
+{
+    uint8_t header[PROTO_HEADER_SIZE];
+    uint8_t crc_bytes[PROTO_CRC_SIZE];
+    uint16_t total = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+        total += lengths[i];
+    Proto_BuildHeader(header, opcode, seq, total);
+
+    // CRC covers everything after the sync bytes
+    uint16_t crc = Proto_CRC16(0xFFFF, header + 2, PROTO_HEADER_SIZE - 2);
+    for (uint8_t i = 0; i < count; i++)
+        crc = Proto_CRC16(crc, parts[i], lengths[i]);
+    Proto_PutU16(crc_bytes, crc);
+
+    LINK_SEND(header, PROTO_HEADER_SIZE);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (lengths[i] > 0)
+            LINK_SEND(parts[i], lengths[i]);
+    }
+    LINK_SEND(crc_bytes, PROTO_CRC_SIZE);
+}
+
+/**
+  * @brief  Send a PROTO_OP_ERROR reply
+  * @param  opcode: Opcode of the failed request
+  * @param  seq: Sequence number of the failed request
+  * @param  error: Error code
+  * @retval None
+  */
+static void SendErrorFrame(uint8_t opcode, uint8_t seq, Proto_Error_t error)
+{
+    uint8_t payload[2] = {opcode, (uint8_t)error};
+    SendFrame(PROTO_OP_ERROR | PROTO_REPLY_FLAG, seq, payload, sizeof(payload));
+}
+
+/**
+  * @brief  Handle a complete binary frame from proto_parser
+  * @note   Replies carry the request opcode with PROTO_REPLY_FLAG set and the same seq.
+  *         Multi-byte fields are little-endian, which matches the Cortex-M4 memory
+  *         layout, so int16_t buffers are sent as-is.
+  * @retval None
+  */
+void ProcessBinaryCommand(void)
+{
+    uint8_t opcode = proto_parser.opcode;
+    uint8_t seq = proto_parser.seq;
+    uint16_t length = proto_parser.length;
+    uint8_t* payload = proto_parser.payload;
+    uint8_t reply_opcode = opcode | PROTO_REPLY_FLAG;
+
+    switch (opcode)
+    {
+    case PROTO_OP_COMM_OK:
+    {
+        uint8_t version = PROTO_VERSION;
+        SendFrame(reply_opcode, seq, &version, 1);
+        break;
+    }
+
+    case PROTO_OP_STATS:
+    {
+        if (length > 1 || (length == 1 && payload[0] > 1))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        SendStatsFrame(seq);
+        if (length == 1 && payload[0] == 1)
+            Stats_Reset();
+        break;
+    }
+
+    case PROTO_OP_TIME:
+    {
+        if (length > 1 || (length == 1 && payload[0] > 1))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        if (length == 1)
+            timestamps_on = payload[0];
+        uint32_t now_us = Micros();
+        SendFrame(reply_opcode, seq, (const uint8_t*)&now_us, sizeof(now_us));
+        break;
+    }
+
+    case PROTO_OP_SET_DAC:
+    {
+        if (length != 3 || payload[0] > 3 || Proto_GetU16(&payload[1]) > 4095)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        HAL_StatusTypeDef status = MCP4728_WriteChannel(&hi2c1, (MCP4728_Channel)payload[0],
+                                                        Cal_DacCode(payload[0], Proto_GetU16(&payload[1])));
+        uint8_t ok = (status == HAL_OK) ? 1 : 0;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    case PROTO_OP_SET_ALL:
+    {
+        uint16_t dac_value = (length == 2) ? Proto_GetU16(&payload[0]) : 0xFFFF;
+        if (dac_value > 4095)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        uint16_t dac_values[4] = {dac_value, dac_value, dac_value, dac_value};
+        Cal_DacCodes(dac_values, 0x0F);
+        uint8_t ok = (MCP4728_SetAllChannels(&hi2c1, dac_values) == HAL_OK) ? 1 : 0;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    case PROTO_OP_SET_MULTI:
+    {
+        uint8_t mask = (length == 9) ? payload[0] : 0;
+        uint16_t dac_values[4] = {0};
+        uint8_t valid = (mask >= 0x01 && mask <= 0x0F);
+
+        for (uint8_t i = 0; valid && i < 4; i++)
+        {
+            dac_values[i] = Proto_GetU16(&payload[1 + i * 2]);
+            if ((mask & (1 << i)) && dac_values[i] > 4095)
+                valid = 0;
+        }
+        if (!valid)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        Cal_DacCodes(dac_values, mask);
+        uint8_t ok = (MCP4728_SetChannelsSync(&hi2c1, dac_values, mask) == HAL_OK) ? 1 : 0;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    case PROTO_OP_READ_ADC:
+    {
+        if (adc_handle == NULL || length != 1 || payload[0] > 3)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        adc_handle->config.channel = ADS1115_MUX_SINGLE_ENDED(payload[0]);
+        uint32_t time_us = Micros();
+        int16_t adc_code = Cal_AdcCode(payload[0], ADS1115_oneShotMeasure(adc_handle));
+        SendFrameSplit(reply_opcode, seq, (uint8_t*)&adc_code, sizeof(adc_code),
+                       (const uint8_t*)&time_us, timestamps_on ? sizeof(time_us) : 0);
+        break;
+    }
+
+    case PROTO_OP_SCAN:
+    {
+        // [mask u8][oversample u8] or, for the AIN of further chips, [mask u16][oversample u8]
+        uint16_t mask = (length == 3) ? Proto_GetU16(payload) : payload[0];
+        uint8_t oversample = (length == 2 || length == 3) ? payload[length - 1] : 0;
+        if (adc_handle == NULL || mask == 0 || (mask & ~AdcChannelMask()) ||
+            oversample < 1 || oversample > SCAN_MAX_OVERSAMPLE)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        int16_t codes[ADC_CHANNELS];
+        uint32_t time_us = Micros();
+        uint8_t n = RunScan(mask, oversample, codes);
+        SendFrameSplit(reply_opcode, seq, (uint8_t*)codes, n * sizeof(int16_t),
+                       (const uint8_t*)&time_us, timestamps_on ? sizeof(time_us) : 0);
+        break;
+    }
+
+    case PROTO_OP_READ_ADC_FILTERED:
+    {
+        uint16_t oversample = (length == 4) ? Proto_GetU16(&payload[1]) : 0;
+        if (adc_handle == NULL || length != 4 || payload[0] > 3 || oversample < 1 ||
+            oversample > SMU_FILTER_MAX_SAMPLES || payload[3] > SMU_FILTER_DECIMATE)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        SMU_FilterResult_t result;
+        uint32_t time_us = Micros();
+        if (!ADC_ReadFiltered(payload[0], oversample, (SMU_Filter_t)payload[3], &result, NULL))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_HW);
+            break;
+        }
+        uint8_t reply[14];
+        memcpy(&reply[0], &result.value, 4);
+        memcpy(&reply[4], &result.stddev, 4);
+        memcpy(&reply[8], &result.count, 2);
+        memcpy(&reply[10], &time_us, 4);
+        SendFrame(reply_opcode, seq, reply, timestamps_on ? 14 : 10);
+        break;
+    }
+
+    case PROTO_OP_READ_ADC_RANGED:
+    {
+        uint16_t oversample = (length == 4) ? Proto_GetU16(&payload[1]) : 0;
+        if (adc_handle == NULL || length != 4 || payload[0] > 3 || oversample < 1 ||
+            oversample > SMU_FILTER_MAX_SAMPLES || payload[3] > SMU_FILTER_DECIMATE)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        SMU_FilterResult_t result;
+        ADS1115_PGA_t range = ADS1115_PGA_6V144;
+        uint32_t time_us = Micros();
+        if (!ADC_ReadFiltered(payload[0], oversample, (SMU_Filter_t)payload[3], &result, &range))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_HW);
+            break;
+        }
+        int32_t microvolts;
+        uint32_t stddev_uv;
+        if (ADC_Autoranges(payload[0], (SMU_Filter_t)payload[3]))
+        {
+            microvolts = ADC_Range_ToMicrovolts(payload[0], result.value, SMU_FILTER_FRAC_BITS, range);
+            stddev_uv = ADC_Range_SpanMicrovolts(result.stddev, SMU_FILTER_FRAC_BITS, range);
+        }
+        else
+        {
+            // Already calibrated +/-6.144 V codes
+            microvolts = (int32_t)(((int64_t)result.value * 6144000) / (32768 << SMU_FILTER_FRAC_BITS));
+            stddev_uv = ADC_Range_SpanMicrovolts(result.stddev, SMU_FILTER_FRAC_BITS, ADS1115_PGA_6V144);
+        }
+        uint8_t reply[15];
+        memcpy(&reply[0], &microvolts, 4);
+        memcpy(&reply[4], &stddev_uv, 4);
+        memcpy(&reply[8], &result.count, 2);
+        reply[10] = (uint8_t)range;
+        memcpy(&reply[11], &time_us, 4);
+        SendFrame(reply_opcode, seq, reply, timestamps_on ? 15 : 11);
+        break;
+    }
+
+    case PROTO_OP_AUTORANGE:
+    {
+        if (length != 2 || payload[0] > 3 || payload[1] > 1)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        ADC_Range_SetAuto(payload[0], payload[1]);
+        uint8_t ok = 1;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    case PROTO_OP_SWEEP:
+    {
+        if (adc_handle == NULL || (length != 12 && length != 18) || payload[0] > 3 || payload[1] > 3)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        uint16_t start = Proto_GetU16(&payload[2]);
+        uint16_t stop = Proto_GetU16(&payload[4]);
+        uint16_t steps = Proto_GetU16(&payload[6]);
+        uint32_t settle_us = Proto_GetU32(&payload[8]);
+        uint8_t adaptive = (length == 18);
+        uint16_t tolerance = adaptive ? Proto_GetU16(&payload[12]) : 0;
+        uint32_t max_settle_us = adaptive ? Proto_GetU32(&payload[14]) : 0;
+
+        if (start > 4095 || stop > 4095 || steps < 1 || steps > SWEEP_MAX_POINTS ||
+            settle_us > SWEEP_MAX_SETTLE_US ||
+            (adaptive && (tolerance < 1 || tolerance > INT16_MAX ||
+                          max_settle_us < 1 || max_settle_us > SWEEP_MAX_SETTLE_US ||
+                          max_settle_us < settle_us)))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        RunSweep(payload[0], payload[1], start, stop, steps, settle_us, tolerance, max_settle_us);
+
+        const uint8_t *parts[3] = {
+            (const uint8_t*)sweep_codes, (const uint8_t*)sweep_times, (const uint8_t*)sweep_settle
+        };
+        uint16_t lengths[3] = {
+            steps * sizeof(int16_t),
+            timestamps_on ? steps * sizeof(uint32_t) : 0,
+            adaptive ? steps * sizeof(uint32_t) : 0
+        };
+        SendFrameParts(reply_opcode, seq, parts, lengths, 3);
+        break;
+    }
+
+    case PROTO_OP_WAVE_LOAD:
+    {
+        uint16_t count = (length >= 3) ? (length - 3) / 2 : 0;
+        uint16_t codes[(PROTO_MAX_PAYLOAD - 3) / 2];
+        HAL_StatusTypeDef status = HAL_ERROR;
+
+        if (length >= 3 && ((length - 3) % 2) == 0)
+        {
+            for (uint16_t i = 0; i < count; i++)
+            {
+                codes[i] = Proto_GetU16(&payload[3 + i * 2]);
+            }
+            status = Wave_Load(payload[0], Proto_GetU16(&payload[1]), codes, count);
+        }
+        if (status == HAL_ERROR)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        uint8_t ok = (status == HAL_OK) ? 1 : 0;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    case PROTO_OP_WAVE_PLAY:
+    {
+        uint16_t rate = (length == 5) ? Proto_GetU16(&payload[0]) : 0;
+        uint16_t loops = (length == 5) ? Proto_GetU16(&payload[2]) : 0;
+        uint8_t adc_channel = (length == 5) ? payload[4] : WAVE_NO_CAPTURE;
+        uint8_t capture = (adc_channel != WAVE_NO_CAPTURE);
+
+        if (adc_handle == NULL || rate < 1 || rate > WAVE_MAX_RATE || loops < 1 ||
+            (capture && (adc_channel > 3 || rate > WAVE_MAX_CAPTURE_RATE ||
+                         (uint32_t)Wave_GetLength() * loops > SWEEP_MAX_POINTS)) ||
+            Wave_GetLength() == 0)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        RunWave(rate, loops, adc_channel, 1, seq);
+        break;
+    }
+
+    case PROTO_OP_STREAM:
+    {
+        if (adc_handle == NULL || length != 7 || payload[0] >= ADC_CHANNELS ||
+            adc_chips[payload[0] / 4] == NULL)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        uint16_t sps = Proto_GetU16(&payload[1]);
+        uint32_t count = Proto_GetU32(&payload[3]);
+
+        if (sps < 1 || sps > 860 || count < 1 || count > STREAM_MAX_SAMPLES)
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        RunStream(payload[0], sps, count, 1, seq);
+        break;
+    }
+
+    case PROTO_OP_TRIGGER:
+    {
+        if (length > 1 || (length == 1 && payload[0] > 1))
+        {
+            SendErrorFrame(opcode, seq, PROTO_ERR_BAD_ARG);
+            break;
+        }
+        if (length == 0)
+            PulseOPMTrigger();
+        else
+            opm_trigger_per_step = payload[0];
+        uint8_t ok = 1;
+        SendFrame(reply_opcode, seq, &ok, 1);
+        break;
+    }
+
+    default:
+        SendErrorFrame(opcode, seq, PROTO_ERR_UNKNOWN_OP);
+        break;
+    }
+}
+
+/**
+  * @brief  Take oversample conversions of one channel and filter them
+  * @note   BOXCAR/MEDIAN use single-shot conversions at the configured data rate.
+  *         DECIMATE runs the ADC in continuous mode at 860 SPS through adc_stream
+  *         and averages the run. Raw samples are collected in sweep_codes.
+  *         With range non-NULL an autoranging channel picks its range on the first
+  *         conversion (BOXCAR/MEDIAN only) and the result is left uncalibrated at
+  *         that range (see ADC_Range_ToMicrovolts); otherwise the result is in
+  *         calibrated +/-6.144 V codes.
+  * @param  channel: ADC channel (0-3)
+  * @param  oversample: Number of conversions (1-SMU_FILTER_MAX_SAMPLES)
+  * @param  filter: Filter to apply
+  * @param  result: Filtered reading
+  * @param  range: Output, range of an autoranged result, ADS1115_PGA_6V144 for
+  *         calibrated codes (NULL for a fixed-range reading)
+  * @retval 1 if all conversions were collected, 0 otherwise
+  */
+static uint8_t ADC_ReadFiltered(uint8_t channel, uint16_t oversample, SMU_Filter_t filter,
+                               SMU_FilterResult_t *result, ADS1115_PGA_t *range)
+{
+    uint16_t collected = 0;
+
+    if (oversample > SMU_FILTER_MAX_SAMPLES)
+        oversample = SMU_FILTER_MAX_SAMPLES;
+
+    if (range != NULL)
+        *range = ADS1115_PGA_6V144;
+
+    if (filter == SMU_FILTER_DECIMATE)
+    {
+        ADS1115_DataRate_t previous_rate = adc_handle->config.dataRate;
+        uint32_t last_progress = HAL_GetTick();
+        uint8_t acquiring = 1;
+
+        ADC_Stream_Start(adc_handle, ADS1115_MUX_SINGLE_ENDED(channel), channel, ADS1115_DR_860SPS, oversample,
+                         SMU_ADC_USE_RDY_PIN && !Limit_IsArmed(), Micros());
+
+        while (1)
+        {
+            ADC_Stream_Poll(Micros());
+
+            const int16_t* block;
+            uint16_t samples;
+            while ((block = ADC_Stream_GetBlock(&samples)) != NULL)
+            {
+                for (uint16_t i = 0; i < samples && collected < oversample; i++)
+                {
+                    sweep_codes[collected++] = block[i];
+                }
+                ADC_Stream_ReleaseBlock();
+                last_progress = HAL_GetTick();
+            }
+
+            if (!acquiring)
+                break;
+
+            if (!ADC_Stream_IsActive() || (HAL_GetTick() - last_progress) > STREAM_STALL_MS)
+            {
+                ADC_Stream_Stop();
+                acquiring = 0;
+            }
+        }
+
+        adc_handle->config.dataRate = previous_rate;
+    }
+    else if (range != NULL && ADC_Autoranges(channel, filter))
+    {
+        // The first conversion settles the range, the rest of the set stays on it
+        ADS1115_PGA_t previous_pga = adc_handle->config.pgaConfig;
+        sweep_codes[collected++] = ADC_Range_Measure(adc_handle, channel, range);
+        adc_handle->config.pgaConfig = *range;
+        for (; collected < oversample; collected++)
+        {
+            sweep_codes[collected] = ADS1115_oneShotMeasure(adc_handle);
+        }
+        adc_handle->config.pgaConfig = previous_pga;
+    }
+    else
+    {
+        adc_handle->config.channel = ADS1115_MUX_SINGLE_ENDED(channel);
+        for (; collected < oversample; collected++)
+        {
+            sweep_codes[collected] = Cal_AdcCode(channel, ADS1115_oneShotMeasure(adc_handle));
+        }
+    }
+
+    SMU_Filter_Apply(sweep_codes, collected, filter, result);
+    return collected == oversample;
+}
+
+/**
+  * @brief  1 if ADC_ReadFiltered autoranges a reading (decimated runs stay at the
+  *         fixed range, the stream stores calibrated codes)
+  * @param  channel: ADC channel (0-3)
+  * @param  filter: Filter of the reading
+  * @retval Autorange flag
+  */
+static uint8_t ADC_Autoranges(uint8_t channel, SMU_Filter_t filter)
+{
+    return ADC_Range_IsAuto(channel) && filter != SMU_FILTER_DECIMATE;
+}
+
+/**
+  * @brief  Read voltage from ADS1115 ADC channel
+  * @param  channel: ADC channel (0-3)
+  * @param  oversample: Conversions per reading (1 for a single conversion)
+  * @param  filter: Filter applied when oversampling
+  * @param  stddev: Optional output, standard deviation of the raw conversions in Volts
+  * @param  range: Optional output, PGA range the reading was taken at (autoranging
+  *         channels only pick a range when this is given)
+  * @retval Voltage in Volts
+  */
+float ADS1115_ReadVoltage(uint8_t channel, uint16_t oversample, SMU_Filter_t filter, float *stddev,
+                          ADS1115_PGA_t *range)
+{
+    if (adc_handle == NULL || channel > 3)
+    {
+        return 0.0f;
+    }
+    
+    SMU_FilterResult_t result;
+    ADS1115_PGA_t pga = ADS1115_PGA_6V144;
+    ADC_ReadFiltered(channel, (oversample > 0) ? oversample : 1, filter, &result,
+                     (range != NULL) ? &pga : NULL);
+    if (range != NULL)
+        *range = pga;
+    
+    // Check if we got a valid reading (0 could mean error or actual 0V)
+    // For debugging, we'll check if I2C communication is working
+    // If adc_value is 0, it might be an error, but it could also be actual 0V
+    
+    float voltage;
+    if (range != NULL && ADC_Autoranges(channel, filter))
+    {
+        if (stddev != NULL)
+            *stddev = ADC_Range_SpanMicrovolts(result.stddev, SMU_FILTER_FRAC_BITS, pga) * 1e-6f;
+        voltage = ADC_Range_ToMicrovolts(channel, result.value, SMU_FILTER_FRAC_BITS, pga) * 1e-6f;
+    }
+    else
+    {
+        if (stddev != NULL)
+            *stddev = ((float)result.stddev * 6.144f) / (32768.0f * (1 << SMU_FILTER_FRAC_BITS));
+        voltage = ((float)result.value * 6.144f) / (32768.0f * (1 << SMU_FILTER_FRAC_BITS));
+    }
+    
+    // Clamp to 0-5V range for single-ended measurements
+    if (voltage < 0.0f)
+        voltage = 0.0f;
+    if (voltage > 5.0f)
+        voltage = 5.0f;
+    
+    return voltage;
+}
+
+/**
+  * @brief  Convert a raw ADS1115 code to a single-ended voltage
+  * @param  adc_value: Signed conversion result
+  * @retval Voltage in Volts, clamped to 0-5V
+  */
+static float ADS1115_CodeToVoltage(int16_t adc_value)
+{
+    // Convert to voltage
+    // ADS1115 with ±6.144V range: 
+    // - Full scale: ±32768 counts for ±6.144V
+    // - LSB = 6.144V / 32768 = 187.5 µV per count
+    // - For 0-5V input, we expect values from 0 to ~26666 (5V / 0.0001875V)
+    // Note: adc_value is signed, but for single-ended measurements (AINx vs GND),
     // it should be positive for 0-5V inputs
     float voltage = ((float)adc_value * 6.144f) / 32768.0f;
     
@@ -404,6 +2871,144 @@ float ADS1115_ReadVoltage(uint8_t channel)
     return voltage;
 }
  
+/**
+  * @brief  UART RX event (half/full DMA buffer or idle line)
+  */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    UART_DMA_RxEventHandler(huart, Size);
+}
+
+/**
+  * @brief  UART DMA transmission complete
+  */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    UART_DMA_TxCpltHandler(huart);
+}
+
+/**
+  * @brief  UART error (overrun, framing, noise)
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    UART_DMA_ErrorHandler(huart);
+}
+
+/**
+  * @brief  EXTI line callback (ADS1115 ALERT/RDY)
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == ADS1115_RDY_Pin && adc_handle != NULL)
+    {
+        if (Limit_IsArmed())
+        {
+            // Nothing may drive the channel back up once Limit_OnAlert has zeroed it
+            if (Limit_OnAlert())
+            {
+                CC_Stop();
+                Wave_Abort();
+            }
+        }
+        else if (ADC_Stream_IsActive())
+            ADC_Stream_OnReady(Micros());
+        else
+            ADS1115_conversionReadyCallback(adc_handle);
+    }
+}
+
+/**
+  * @brief  I2C interrupt-mode memory read complete (streaming conversion reads)
+  */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    ADC_Stream_OnReadComplete(hi2c);
+}
+
+/**
+  * @brief  I2C interrupt-mode master transmit complete (waveform DAC writes)
+  */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c == &hi2c1 && MCP4728_TxCpltHandler(hi2c))
+    {
+        Wave_OnWriteComplete();
+        Limit_OnWriteComplete(0);
+    }
+}
+
+/**
+  * @brief  I2C interrupt-mode transfer error
+  */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c == &hi2c1)
+    {
+        if (MCP4728_ErrorHandler(hi2c))
+        {
+            Wave_OnWriteError();
+            Limit_OnWriteComplete(1);
+        }
+        return;
+    }
+    Stats_Count(STATS_ADC_I2C_ERRORS);
+    ADC_Stream_OnReadError(hi2c);
+}
+
+/**
+  * @brief  Timer update interrupt (waveform step clock)
+  */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    Wave_OnTimer(htim);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+    HAL_GPIO_EXTI_IRQHandler(ADS1115_RDY_Pin);
+}
+
+void I2C1_EV_IRQHandler(void)
+{
+    HAL_I2C_EV_IRQHandler(&hi2c1);
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+    HAL_I2C_ER_IRQHandler(&hi2c1);
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&htim6);
+}
+
+void I2C2_EV_IRQHandler(void)
+{
+    HAL_I2C_EV_IRQHandler(&hi2c2);
+}
+
+void I2C2_ER_IRQHandler(void)
+{
+    HAL_I2C_ER_IRQHandler(&hi2c2);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+}
+
+void DMA1_Stream6_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
+
+void USART2_IRQHandler(void)
+{
+    HAL_UART_IRQHandler(&huart2);
+}
+ 
 void Error_Handler(void)
 {
     __disable_irq();
@@ -60,6 +60,52 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN Private defines */
 
+/* ADS1115 ALERT/RDY pin (open-drain, active low) - RDY with SMU_ADC_USE_RDY_PIN, current limit trip */
+#define ADS1115_RDY_Pin             GPIO_PIN_8
+#define ADS1115_RDY_GPIO_Port       GPIOA
+#define ADS1115_RDY_EXTI_IRQn       EXTI9_5_IRQn
+
+/* MCP4728 LDAC pin (push-pull, idle high) - used when SMU_DAC_USE_LDAC_PIN is 1 */
+#define MCP4728_LDAC_Pin            GPIO_PIN_9
+#define MCP4728_LDAC_GPIO_Port      GPIOA
+
+/* Optical power meter trigger output (push-pull, idle low, rising edge = one logged point) */
+#define OPM_TRIG_Pin                GPIO_PIN_10
+#define OPM_TRIG_GPIO_Port          GPIOA
+
+/* Build options */
+#ifndef SMU_ADC_USE_RDY_PIN
+#define SMU_ADC_USE_RDY_PIN         0   // 1: wait on ALERT/RDY EXTI, 0: poll the OS bit
+#endif
+
+#ifndef SMU_ADC_COUNT
+#define SMU_ADC_COUNT               1   // ADS1115s on I2C2 (1-4, addresses 0x48-0x4B), 4 channels each
+#endif
+
+#ifndef SMU_LOW_POWER_CLOCK
+#define SMU_LOW_POWER_CLOCK         0   // 1: 16 MHz HSI, scale 3; 0: 180 MHz PLL with over-drive
+#endif
+
+#ifndef SMU_DAC_USE_LDAC_PIN
+#define SMU_DAC_USE_LDAC_PIN        0   // 1: latch set_multi with LDAC, 0: software update general call
+#endif
+
+#ifndef SMU_USE_USB_CDC
+#define SMU_USE_USB_CDC             0   // 1: host link over native USB CDC (PA11/PA12), 0: USART2 via ST-LINK
+#endif
+
+#ifndef SMU_OPM_TRIG_PULSE_US
+#define SMU_OPM_TRIG_PULSE_US       10  // OPM trigger pulse width in microseconds
+#endif
+
+/* I2C bus speeds in Hz (10000-400000), changeable at runtime with "i2c_speed,<bus>,<hz>" */
+#ifndef SMU_I2C1_SPEED_HZ
+#define SMU_I2C1_SPEED_HZ           400000  // I2C1: MCP4728 DAC
+#endif
+#ifndef SMU_I2C2_SPEED_HZ
+#define SMU_I2C2_SPEED_HZ           400000  // I2C2: ADS1115 ADC
+#endif
+
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
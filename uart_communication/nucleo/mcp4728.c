@@ -8,6 +8,29 @@
   */
 
   #include "mcp4728.h"
+  #include "smu_stats.h"
+
+  /* Last value written to each channel's DAC register. Lets single-channel writes
+     touch only that channel and lets callers read back what is on the outputs. */
+  static uint16_t shadow[4] = {0};
+  
+  /* Values written by MCP4728_StageChannels, copied to shadow once latched */
+  static uint16_t staged[4] = {0};
+  static uint8_t staged_mask = 0;
+  
+  /* Optional LDAC GPIO; without it MCP4728_Update falls back to the software update general call */
+  static GPIO_TypeDef *ldac_port = NULL;
+  static uint16_t ldac_pin = 0;
+  
+  /* Interrupt-mode write in flight (MCP4728_WriteChannelsIT) */
+  static uint8_t it_buffer[12];
+  static uint16_t it_values[4];
+  static uint8_t it_mask = 0;
+  static volatile uint8_t it_busy = 0;
+  
+  static uint16_t buildMultiWrite(uint8_t *data, const uint16_t values[4], uint8_t mask, uint8_t udac);
+  static void pulseLDAC(void);
+  static HAL_StatusTypeDef transmit(I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *data, uint16_t size);
 
   /**
     * @brief  Sends General Call commands (Reset, Wakeup, etc.)
@@ -18,11 +41,11 @@
   HAL_StatusTypeDef MCP4728_Write_GeneralCall(I2C_HandleTypeDef *hi2c, uint8_t command)
   {
       // General call address is 0x00
-      return HAL_I2C_Master_Transmit(hi2c, 0x00, &command, 1, 100);
+      return transmit(hi2c, 0x00, &command, 1);
   }
   
   /**
-    * @brief  Initialize the MCP4728 DAC (wake up device)
+    * @brief  Initialize the MCP4728 DAC (wake up device, load shadow registers)
     * @param  hi2c: Pointer to HAL I2C handle
     * @retval HAL status
     */
@@ -35,11 +58,50 @@
   
       HAL_Delay(5);  // Small delay after wakeup
   
+      // Outputs come up with the EEPROM values, start the shadow from what is really there
+      return MCP4728_ReadBack(hi2c);
+  }
+  
+  /**
+    * @brief  Read the DAC registers back into the shadow copy
+    * @note   The device returns 24 bytes: for each channel A-D, the DAC register
+    *         (status, VREF/PD/gain + D11-D8, D7-D0) followed by the same for EEPROM.
+    * @param  hi2c: Pointer to HAL I2C handle
+    * @retval HAL status
+    */
+  HAL_StatusTypeDef MCP4728_ReadBack(I2C_HandleTypeDef *hi2c)
+  {
+      uint8_t data[MCP4728_READBACK_SIZE];
+  
+      HAL_StatusTypeDef status = HAL_I2C_Master_Receive(hi2c, MCP4728_BASEADDR, data,
+                                                        MCP4728_READBACK_SIZE, 100);
+      if (status != HAL_OK)
+      {
+          Stats_Count(STATS_DAC_I2C_ERRORS);
+          return status;
+      }
+  
+      for (int i = 0; i < 4; i++)
+      {
+          shadow[i] = ((uint16_t)(data[i * 6 + 1] & 0x0F) << 8) | data[i * 6 + 2];
+      }
       return HAL_OK;
   }
   
   /**
-    * @brief  Write a 12-bit value to a specific channel using Sequential Write mode
+    * @brief  Last value written to a channel
+    * @param  ch: DAC channel (A–D)
+    * @retval 12-bit DAC value
+    */
+  uint16_t MCP4728_GetChannel(MCP4728_Channel ch)
+  {
+      return shadow[ch & 0x03];
+  }
+  
+  /**
+    * @brief  Write a 12-bit value to a specific channel using Multi-Write mode
+    * @note   3 bytes after the address, DAC input register only (no EEPROM write),
+    *         output updates on the last ACK (UDAC = 0). Other channels are untouched.
     * @param  hi2c: Pointer to HAL I2C handle
     * @param  ch: DAC channel (A–D)
     * @param  value: 12-bit DAC value (0–4095)
@@ -47,52 +109,272 @@
     */
   HAL_StatusTypeDef MCP4728_WriteChannel(I2C_HandleTypeDef *hi2c, MCP4728_Channel ch, uint16_t value)
   {
-      // Read current values for other channels (or use 0)
-      // For simplicity, we'll write all channels but only update the target one
-      // This ensures VREF/GAIN settings are maintained
+      uint8_t data[3];
   
-      uint8_t data[8];
+      // Multi-Write format:
+      // Byte 0: 0 1 0 0 0 DAC1 DAC0 UDAC
+      // Byte 1: VREF PD1 PD0 Gx D11 D10 D9 D8 (VDD reference, normal mode, gain 1)
+      // Byte 2: D7 D6 D5 D4 D3 D2 D1 D0
+      data[0] = MCP4728_CMD_DACWRITE_MULTI | ((ch & 0x03) << MCP4728_MULTI_CH_SHIFT);
+      data[1] = (value >> 8) & 0x0F;
+      data[2] = value & 0xFF;
   
-      // Prepare data - set target channel, keep others at 0 (or read current values)
+      HAL_StatusTypeDef status = transmit(hi2c, MCP4728_BASEADDR, data, 3);
+      if (status == HAL_OK)
+          shadow[ch & 0x03] = value & 0x0FFF;
+      return status;
+  }
+  /**
+    * @brief  Set all four DAC channels using Fast Write mode
+    * @note   8 bytes after the address, DAC input registers only (no EEPROM write).
+    * @param  hi2c: Pointer to HAL I2C handle
+    * @param  values: Array of four 12-bit values (A–D)
+    * @retval HAL status
+    */
+  HAL_StatusTypeDef MCP4728_SetAllChannels(I2C_HandleTypeDef *hi2c, uint16_t values[4])
+  {
+      uint8_t data[8];  // 2 bytes per channel x 4 channels
+  
+      // Prepare data for all 4 channels
       for (int i = 0; i < 4; i++)
       {
-          if (i == ch)
+          // Fast Write format (command bits C2 C1 = 0 0 lead the first byte):
+          // Byte 0: 0 0 PD1 PD0 D11 D10 D9 D8
+          // Byte 1: D7 D6 D5 D4 D3 D2 D1 D0
+          data[i * 2] = MCP4728_CMD_FASTWRITE | ((values[i] >> 8) & 0x0F);
+          data[i * 2 + 1] = values[i] & 0xFF;
+      }
+  
+      HAL_StatusTypeDef status = transmit(hi2c, MCP4728_BASEADDR, data, 8);
+      if (status == HAL_OK)
+      {
+          for (int i = 0; i < 4; i++)
           {
-              data[i * 2] = (value >> 8) & 0x0F;
-              data[i * 2 + 1] = value & 0xFF;
+              shadow[i] = values[i] & 0x0FFF;
           }
-          else
+      }
+      return status;
+  }
+  
+  /**
+    * @brief  Use a GPIO wired to the LDAC pin for MCP4728_Update
+    * @note   The pin must already be configured as push-pull output and idle high.
+    *         While LDAC is high, writes with UDAC = 1 only load the input registers.
+    * @param  port: GPIO port, or NULL to go back to the software update general call
+    * @param  pin: GPIO pin
+    * @retval None
+    */
+  void MCP4728_SetLDACPin(GPIO_TypeDef *port, uint16_t pin)
+  {
+      ldac_port = port;
+      ldac_pin = pin;
+  }
+  
+  /**
+    * @brief  Load new values into the input registers without changing the outputs
+    * @note   One Multi-Write transaction with UDAC = 1, 3 bytes per selected channel.
+    *         Outputs change only on the next MCP4728_Update.
+    * @param  hi2c: Pointer to HAL I2C handle
+    * @param  values: Array of four 12-bit values (A–D)
+    * @param  mask: Channels to load, bit n selects channel n (0x01-0x0F)
+    * @retval HAL status
+    */
+  HAL_StatusTypeDef MCP4728_StageChannels(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask)
+  {
+      uint8_t data[12];
+      uint16_t length = buildMultiWrite(data, values, mask, MCP4728_UDAC);
+  
+      if (length == 0)
+          return HAL_OK;
+  
+      HAL_StatusTypeDef status = transmit(hi2c, MCP4728_BASEADDR, data, length);
+      if (status == HAL_OK)
+      {
+          for (int i = 0; i < 4; i++)
           {
-              // Keep other channels at 0 (or you could read current values)
-              data[i * 2] = 0x00;
-              data[i * 2 + 1] = 0x00;
+              if (mask & (1 << i))
+                  staged[i] = values[i] & 0x0FFF;
           }
+          staged_mask |= mask;
+      }
+      return status;
+  }
+  
+  /**
+    * @brief  Latch all input registers to the outputs at the same instant
+    * @note   Pulses LDAC low if a pin was given with MCP4728_SetLDACPin, otherwise sends
+    *         the software update general call (MCP4728_GENERAL_SWUPDATE).
+    * @param  hi2c: Pointer to HAL I2C handle
+    * @retval HAL status
+    */
+  HAL_StatusTypeDef MCP4728_Update(I2C_HandleTypeDef *hi2c)
+  {
+      HAL_StatusTypeDef status = HAL_OK;
+  
+      if (ldac_port != NULL)
+      {
+          pulseLDAC();
+      }
+      else
+      {
+          status = MCP4728_Write_GeneralCall(hi2c, MCP4728_GENERAL_SWUPDATE);
       }
   
-      // Use Sequential Write (0x50) - this updates all channels and maintains settings
-      return HAL_I2C_Mem_Write(hi2c, MCP4728_BASEADDR, MCP4728_CMD_DACWRITE_SEQ, 1, data, 8, HAL_MAX_DELAY);
+      if (status == HAL_OK)
+      {
+          for (int i = 0; i < 4; i++)
+          {
+              if (staged_mask & (1 << i))
+                  shadow[i] = staged[i];
+          }
+          staged_mask = 0;
+      }
+      return status;
   }
+  
   /**
-    * @brief  Set all four DAC channels using Sequential Write mode
+    * @brief  Stage the selected channels and latch them together (zero inter-channel skew)
     * @param  hi2c: Pointer to HAL I2C handle
     * @param  values: Array of four 12-bit values (A–D)
+    * @param  mask: Channels to change, bit n selects channel n (0x01-0x0F)
     * @retval HAL status
     */
-  HAL_StatusTypeDef MCP4728_SetAllChannels(I2C_HandleTypeDef *hi2c, uint16_t values[4])
+  HAL_StatusTypeDef MCP4728_SetChannelsSync(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask)
   {
-      uint8_t data[8];  // 2 bytes per channel x 4 channels
+      HAL_StatusTypeDef status = MCP4728_StageChannels(hi2c, values, mask);
+      if (status != HAL_OK)
+          return status;
+  
+      return MCP4728_Update(hi2c);
+  }
+  
+  /**
+    * @brief  Start an interrupt-mode write of the selected channels (callable from an ISR)
+    * @note   One Multi-Write transaction. With an LDAC pin the values are staged and
+    *         latched together from MCP4728_TxCpltHandler; without it each output
+    *         updates as its 3 bytes are acknowledged.
+    * @param  hi2c: Pointer to HAL I2C handle (its EV/ER interrupts must be enabled)
+    * @param  values: Array of four 12-bit values (A–D)
+    * @param  mask: Channels to write, bit n selects channel n (0x01-0x0F)
+    * @retval HAL_OK, HAL_BUSY if the previous write has not completed
+    */
+  HAL_StatusTypeDef MCP4728_WriteChannelsIT(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask)
+  {
+      if (it_busy)
+          return HAL_BUSY;
+  
+      uint16_t length = buildMultiWrite(it_buffer, values, mask, (ldac_port != NULL) ? MCP4728_UDAC : 0);
+      if (length == 0)
+          return HAL_OK;
   
-      // Prepare data for all 4 channels
       for (int i = 0; i < 4; i++)
       {
-          // Sequential Write format:
-          // Byte 0: 0 0 0 0 D11 D10 D9 D8
-          // Byte 1: D7 D6 D5 D4 D3 D2 D1 D0
-          data[i * 2] = (values[i] >> 8) & 0x0F;
-          data[i * 2 + 1] = values[i] & 0xFF;
+          it_values[i] = values[i] & 0x0FFF;
       }
+      it_mask = mask;
+      it_busy = 1;
+  
+      HAL_StatusTypeDef status = HAL_I2C_Master_Transmit_IT(hi2c, MCP4728_BASEADDR, it_buffer, length);
+      if (status != HAL_OK)
+          it_busy = 0;
+      return status;
+  }
+  
+  /**
+    * @brief  1 while an interrupt-mode write is in flight
+    * @retval Busy flag
+    */
+  uint8_t MCP4728_IsBusy(void)
+  {
+      return it_busy;
+  }
+  
+  /**
+    * @brief  Finish an interrupt-mode write; call from HAL_I2C_MasterTxCpltCallback
+    * @param  hi2c: I2C handle that completed
+    * @retval 1 if this was an MCP4728_WriteChannelsIT transfer, 0 otherwise
+    */
+  uint8_t MCP4728_TxCpltHandler(I2C_HandleTypeDef *hi2c)
+  {
+      if (!it_busy)
+          return 0;
   
-      // Command 0x50 starts Sequential Write from Channel A
-      return HAL_I2C_Mem_Write(hi2c, MCP4728_BASEADDR, MCP4728_CMD_DACWRITE_SEQ, 1, data, 8, HAL_MAX_DELAY);
+      if (ldac_port != NULL)
+          pulseLDAC();
+  
+      for (int i = 0; i < 4; i++)
+      {
+          if (it_mask & (1 << i))
+              shadow[i] = it_values[i];
+      }
+      it_busy = 0;
+      return 1;
+  }
+  
+  /**
+    * @brief  Abort bookkeeping for a failed interrupt-mode write; call from HAL_I2C_ErrorCallback
+    * @param  hi2c: I2C handle that failed
+    * @retval 1 if this was an MCP4728_WriteChannelsIT transfer, 0 otherwise
+    */
+  uint8_t MCP4728_ErrorHandler(I2C_HandleTypeDef *hi2c)
+  {
+      if (!it_busy)
+          return 0;
+  
+      Stats_Count(STATS_DAC_I2C_ERRORS);
+      it_busy = 0;
+      return 1;
+  }
+  
+  /**
+    * @brief  Build a Multi-Write sequence, 3 bytes per selected channel
+    * @param  data: Output buffer (12 bytes)
+    * @param  values: Array of four 12-bit values (A–D)
+    * @param  mask: Channels to include
+    * @param  udac: MCP4728_UDAC to stage only, 0 to update each output on its ACK
+    * @retval Number of bytes written to data
+    */
+  static uint16_t buildMultiWrite(uint8_t *data, const uint16_t values[4], uint8_t mask, uint8_t udac)
+  {
+      uint16_t length = 0;
+  
+      for (int i = 0; i < 4; i++)
+      {
+          if ((mask & (1 << i)) == 0)
+              continue;
+  
+          data[length++] = MCP4728_CMD_DACWRITE_MULTI | (i << MCP4728_MULTI_CH_SHIFT) | udac;
+          data[length++] = (values[i] >> 8) & 0x0F;
+          data[length++] = values[i] & 0xFF;
+      }
+      return length;
+  }
+  
+  /**
+    * @brief  Drive LDAC low briefly to latch the input registers
+    * @retval None
+    */
+  static void pulseLDAC(void)
+  {
+      HAL_GPIO_WritePin(ldac_port, ldac_pin, GPIO_PIN_RESET);
+      for (volatile int i = 0; i < 8; i++) {}  // LDAC low pulse >= 100 ns
+      HAL_GPIO_WritePin(ldac_port, ldac_pin, GPIO_PIN_SET);
+  }
+  
+  /**
+    * @brief  Blocking write, timed and error-counted for "stats"
+    * @param  hi2c: Pointer to HAL I2C handle
+    * @param  address: 8-bit bus address (0x00 for general calls)
+    * @param  data: Bytes to send
+    * @param  size: Number of bytes
+    * @retval HAL status
+    */
+  static HAL_StatusTypeDef transmit(I2C_HandleTypeDef *hi2c, uint16_t address, uint8_t *data, uint16_t size)
+  {
+      uint32_t start = Stats_Cycles();
+      HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(hi2c, address, data, size, 100);
+      Stats_Record(STATS_DAC_I2C, start);
+      if (status != HAL_OK)
+          Stats_Count(STATS_DAC_I2C_ERRORS);
+      return status;
   }
-  
\ No newline at end of file
@@ -35,6 +35,13 @@ typedef enum {
 #define MCP4728_CMD_DACWRITE_SEQ      0x50
 #define MCP4728_CMD_DACWRITE_SINGLE   0x58
 
+/* Multi-Write channel select and UDAC bit (byte 2: 0 1 0 0 0 DAC1 DAC0 UDAC) */
+#define MCP4728_MULTI_CH_SHIFT        1
+#define MCP4728_UDAC                  0x01
+
+/* Read-back: 6 bytes per channel (DAC register 3 bytes, EEPROM 3 bytes) */
+#define MCP4728_READBACK_SIZE         24
+
 /* General Call commands */
 #define MCP4728_GENERAL_RESET      0x06
 #define MCP4728_GENERAL_WAKEUP     0x09
@@ -46,6 +53,16 @@ HAL_StatusTypeDef MCP4728_Init(I2C_HandleTypeDef *hi2c);
 HAL_StatusTypeDef MCP4728_WriteChannel(I2C_HandleTypeDef *hi2c, MCP4728_Channel ch, uint16_t value);
 HAL_StatusTypeDef MCP4728_SetAllChannels(I2C_HandleTypeDef *hi2c, uint16_t values[4]);
 HAL_StatusTypeDef MCP4728_Write_GeneralCall(I2C_HandleTypeDef *hi2c, uint8_t command);
+HAL_StatusTypeDef MCP4728_ReadBack(I2C_HandleTypeDef *hi2c);
+void MCP4728_SetLDACPin(GPIO_TypeDef *port, uint16_t pin);
+HAL_StatusTypeDef MCP4728_StageChannels(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask);
+HAL_StatusTypeDef MCP4728_Update(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef MCP4728_SetChannelsSync(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask);
+HAL_StatusTypeDef MCP4728_WriteChannelsIT(I2C_HandleTypeDef *hi2c, const uint16_t values[4], uint8_t mask);
+uint8_t MCP4728_IsBusy(void);
+uint8_t MCP4728_TxCpltHandler(I2C_HandleTypeDef *hi2c);
+uint8_t MCP4728_ErrorHandler(I2C_HandleTypeDef *hi2c);
+uint16_t MCP4728_GetChannel(MCP4728_Channel ch);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file    ring_buffer.h
+  * @brief   Lock-free single-producer/single-consumer byte ring buffer
+  * @date    October 2025
+  ******************************************************************************
+  * One context (e.g. an ISR) only calls the Write functions and the other
+  * (e.g. the main loop) only calls the Read/Consume functions. head and tail
+  * are free-running 16-bit indices, so the size must be a power of two.
+  ******************************************************************************
+  */
+
+#ifndef INC_RING_BUFFER_H_
+#define INC_RING_BUFFER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *buffer;
+    uint16_t size;              // Power of two, at most 32768
+    volatile uint16_t head;     // Written by producer only
+    volatile uint16_t tail;     // Written by consumer only
+} RingBuffer_t;
+
+/**
+  * @brief  Initialize ring buffer over caller-provided storage
+  * @param  rb: Pointer to ring buffer
+  * @param  storage: Backing array
+  * @param  size: Size of storage in bytes (power of two)
+  * @retval None
+  */
+static inline void RingBuffer_Init(RingBuffer_t *rb, uint8_t *storage, uint16_t size)
+{
+    rb->buffer = storage;
+    rb->size = size;
+    rb->head = 0;
+    rb->tail = 0;
+}
+
+/**
+  * @brief  Number of bytes available to read
+  */
+static inline uint16_t RingBuffer_Count(const RingBuffer_t *rb)
+{
+    return (uint16_t)(rb->head - rb->tail);
+}
+
+/**
+  * @brief  Number of bytes that can be written
+  */
+static inline uint16_t RingBuffer_Free(const RingBuffer_t *rb)
+{
+    return (uint16_t)(rb->size - RingBuffer_Count(rb));
+}
+
+/**
+  * @brief  Write bytes (producer side)
+  * @param  rb: Pointer to ring buffer
+  * @param  data: Bytes to write
+  * @param  len: Number of bytes
+  * @retval Number of bytes written (less than len when full)
+  */
+static inline uint16_t RingBuffer_Write(RingBuffer_t *rb, const uint8_t *data, uint16_t len)
+{
+    uint16_t free = RingBuffer_Free(rb);
+    if (len > free)
+        len = free;
+
+    uint16_t head = rb->head;
+    for (uint16_t i = 0; i < len; i++)
+        rb->buffer[(uint16_t)(head + i) & (rb->size - 1)] = data[i];
+
+    __DMB();  // Data must be visible before the consumer sees the new head
+    rb->head = (uint16_t)(head + len);
+    return len;
+}
+
+/**
+  * @brief  Read bytes (consumer side)
+  * @param  rb: Pointer to ring buffer
+  * @param  data: Output buffer
+  * @param  len: Maximum number of bytes to read
+  * @retval Number of bytes read
+  */
+static inline uint16_t RingBuffer_Read(RingBuffer_t *rb, uint8_t *data, uint16_t len)
+{
+    uint16_t count = RingBuffer_Count(rb);
+    if (len > count)
+        len = count;
+
+    uint16_t tail = rb->tail;
+    for (uint16_t i = 0; i < len; i++)
+        data[i] = rb->buffer[(uint16_t)(tail + i) & (rb->size - 1)];
+
+    __DMB();  // Finish reading before the producer may overwrite the slots
+    rb->tail = (uint16_t)(tail + len);
+    return len;
+}
+
+/**
+  * @brief  Get the longest contiguous readable block, e.g. for a DMA transfer
+  * @param  rb: Pointer to ring buffer
+  * @param  data: Set to the start of the block
+  * @retval Block length in bytes (release with RingBuffer_Consume)
+  */
+static inline uint16_t RingBuffer_Contiguous(const RingBuffer_t *rb, const uint8_t **data)
+{
+    uint16_t start = rb->tail & (rb->size - 1);
+    uint16_t count = RingBuffer_Count(rb);
+    uint16_t to_end = rb->size - start;
+
+    *data = &rb->buffer[start];
+    return (count < to_end) ? count : to_end;
+}
+
+/**
+  * @brief  Release bytes obtained with RingBuffer_Contiguous (consumer side)
+  */
+static inline void RingBuffer_Consume(RingBuffer_t *rb, uint16_t len)
+{
+    __DMB();
+    rb->tail = (uint16_t)(rb->tail + len);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_RING_BUFFER_H_ */
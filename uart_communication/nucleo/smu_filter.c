@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    smu_filter.c
+  * @brief   Fixed-point oversampling filters for ADS1115 sample sets
+  * @date    October 2025
+  ******************************************************************************
+  * Sums fit in 32 bits (256 x 32767) and the variance numerator in 64 bits,
+  * so no floating point is needed until the result is scaled to volts.
+  * Boxcar and decimate produce the same mean over the set; they differ in how
+  * the conversions are acquired (single-shot per sample vs. one continuous run
+  * at the full data rate, which a first-order CIC reduces to).
+  ******************************************************************************
+  */
+
+#include "smu_filter.h"
+
+static uint32_t isqrt64(uint64_t value);
+static void insertionSort(int16_t *samples, uint16_t count);
+
+/**
+  * @brief  Reduce a set of raw conversions to one filtered value and its noise
+  * @note   MEDIAN sorts samples in place.
+  * @param  samples: Raw ADC codes
+  * @param  count: Number of codes (1-SMU_FILTER_MAX_SAMPLES)
+  * @param  filter: Filter to apply
+  * @param  result: Output, codes with SMU_FILTER_FRAC_BITS fraction bits
+  * @retval None
+  */
+void SMU_Filter_Apply(int16_t *samples, uint16_t count, SMU_Filter_t filter, SMU_FilterResult_t *result)
+{
+    int32_t sum = 0;
+    uint64_t sum_sq = 0;
+
+    result->value = 0;
+    result->stddev = 0;
+    result->count = count;
+    if (count == 0)
+        return;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        sum += samples[i];
+        sum_sq += (uint64_t)((int32_t)samples[i] * samples[i]);
+    }
+
+    if (filter == SMU_FILTER_MEDIAN)
+    {
+        insertionSort(samples, count);
+        int32_t mid = samples[count / 2];
+        if ((count & 1) == 0)
+            mid += samples[count / 2 - 1];
+        else
+            mid *= 2;
+        // mid holds twice the median
+        result->value = mid * (1 << (SMU_FILTER_FRAC_BITS - 1));
+    }
+    else
+    {
+        // Round to nearest
+        int32_t scaled = sum * (1 << SMU_FILTER_FRAC_BITS);
+        int32_t half = (scaled >= 0) ? (count / 2) : -(count / 2);
+        result->value = (scaled + half) / count;
+    }
+
+    if (count > 1)
+    {
+        // Sample variance: (n * sum_sq - sum^2) / (n * (n - 1)), scaled by 2^(2 * FRAC_BITS)
+        int64_t numerator = (int64_t)count * (int64_t)sum_sq - (int64_t)sum * sum;
+        if (numerator < 0)
+            numerator = 0;
+        uint64_t variance = ((uint64_t)numerator << (2 * SMU_FILTER_FRAC_BITS)) /
+                            ((uint64_t)count * (count - 1));
+        result->stddev = isqrt64(variance);
+    }
+}
+
+/**
+  * @brief  Integer square root (floor)
+  * @param  value: Input
+  * @retval floor(sqrt(value))
+  */
+static uint32_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > value)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+/**
+  * @brief  Sort codes ascending (sets are small, at most SMU_FILTER_MAX_SAMPLES)
+  * @param  samples: Codes to sort in place
+  * @param  count: Number of codes
+  * @retval None
+  */
+static void insertionSort(int16_t *samples, uint16_t count)
+{
+    for (uint16_t i = 1; i < count; i++)
+    {
+        int16_t key = samples[i];
+        int32_t j = (int32_t)i - 1;
+
+        while (j >= 0 && samples[j] > key)
+        {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = key;
+    }
+}
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    smu_filter.h
+  * @brief   Fixed-point oversampling filters for ADS1115 sample sets
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_SMU_FILTER_H_
+#define INC_SMU_FILTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Largest sample set per filtered reading */
+#define SMU_FILTER_MAX_SAMPLES      256
+
+/* Fraction bits of filtered results (1/16 LSB, keeps the gain from averaging) */
+#define SMU_FILTER_FRAC_BITS        4
+
+/* Filter applied to the N raw conversions of one reading */
+typedef enum {
+    SMU_FILTER_BOXCAR   = 0,    // Mean of N single-shot conversions
+    SMU_FILTER_MEDIAN   = 1,    // Median of N single-shot conversions (spike rejection)
+    SMU_FILTER_DECIMATE = 2     // Moving-average decimator over N continuous-mode conversions
+} SMU_Filter_t;
+
+/* One filtered reading, in ADC codes with SMU_FILTER_FRAC_BITS fraction bits */
+typedef struct {
+    int32_t value;      // Filter output
+    uint32_t stddev;    // Sample standard deviation of the raw conversions
+    uint16_t count;     // Number of conversions used
+} SMU_FilterResult_t;
+
+/* Function Prototypes */
+void SMU_Filter_Apply(int16_t *samples, uint16_t count, SMU_Filter_t filter, SMU_FilterResult_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SMU_FILTER_H_ */
@@ -0,0 +1,156 @@
+/**
+  ******************************************************************************
+  * @file    smu_protocol.c
+  * @brief   Binary framed UART protocol - parser and frame builder
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#include "smu_protocol.h"
+
+/* Parser states */
+enum {
+    STATE_SYNC0 = 0,
+    STATE_SYNC1,
+    STATE_OPCODE,
+    STATE_SEQ,
+    STATE_LEN_LO,
+    STATE_LEN_HI,
+    STATE_PAYLOAD,
+    STATE_CRC_LO,
+    STATE_CRC_HI
+};
+
+/**
+  * @brief  Reset parser to wait for the next sync byte
+  * @param  parser: Pointer to parser state
+  * @retval None
+  */
+void Proto_ParserReset(Proto_Parser_t *parser)
+{
+    parser->state = STATE_SYNC0;
+    parser->index = 0;
+    parser->length = 0;
+}
+
+/**
+  * @brief  Check whether the parser is between frames
+  * @param  parser: Pointer to parser state
+  * @retval 1 if no frame is in progress, 0 otherwise
+  */
+uint8_t Proto_ParserIdle(const Proto_Parser_t *parser)
+{
+    return parser->state == STATE_SYNC0;
+}
+
+/**
+  * @brief  Feed one received byte to the parser
+  * @param  parser: Pointer to parser state
+  * @param  byte: Received byte
+  * @retval PROTO_FRAME_READY when a valid frame is available in parser->payload
+  */
+Proto_Result_t Proto_ParseByte(Proto_Parser_t *parser, uint8_t byte)
+{
+    switch (parser->state)
+    {
+    case STATE_SYNC0:
+        if (byte == PROTO_SYNC0)
+            parser->state = STATE_SYNC1;
+        break;
+
+    case STATE_SYNC1:
+        parser->state = (byte == PROTO_SYNC1) ? STATE_OPCODE : STATE_SYNC0;
+        break;
+
+    case STATE_OPCODE:
+        parser->opcode = byte;
+        parser->crc = Proto_CRC16(0xFFFF, &byte, 1);
+        parser->state = STATE_SEQ;
+        break;
+
+    case STATE_SEQ:
+        parser->seq = byte;
+        parser->crc = Proto_CRC16(parser->crc, &byte, 1);
+        parser->state = STATE_LEN_LO;
+        break;
+
+    case STATE_LEN_LO:
+        parser->length = byte;
+        parser->crc = Proto_CRC16(parser->crc, &byte, 1);
+        parser->state = STATE_LEN_HI;
+        break;
+
+    case STATE_LEN_HI:
+        parser->length |= (uint16_t)byte << 8;
+        parser->crc = Proto_CRC16(parser->crc, &byte, 1);
+        parser->index = 0;
+
+        if (parser->length > PROTO_MAX_PAYLOAD)
+        {
+            // Oversized frame cannot be buffered, resynchronize
+            Proto_ParserReset(parser);
+            return PROTO_FRAME_BAD_CRC;
+        }
+        parser->state = (parser->length > 0) ? STATE_PAYLOAD : STATE_CRC_LO;
+        break;
+
+    case STATE_PAYLOAD:
+        parser->payload[parser->index++] = byte;
+        parser->crc = Proto_CRC16(parser->crc, &byte, 1);
+        if (parser->index >= parser->length)
+            parser->state = STATE_CRC_LO;
+        break;
+
+    case STATE_CRC_LO:
+        // Compare low byte now, keep the mismatch in crc for the high byte check
+        parser->crc ^= byte;
+        parser->state = STATE_CRC_HI;
+        break;
+
+    case STATE_CRC_HI:
+        parser->crc ^= (uint16_t)byte << 8;
+        parser->state = STATE_SYNC0;
+        return (parser->crc == 0) ? PROTO_FRAME_READY : PROTO_FRAME_BAD_CRC;
+
+    default:
+        Proto_ParserReset(parser);
+        break;
+    }
+
+    return PROTO_FRAME_NONE;
+}
+
+/**
+  * @brief  Update a CRC-16/CCITT-FALSE checksum
+  * @param  crc: Running CRC (0xFFFF to start)
+  * @param  data: Data bytes
+  * @param  len: Number of bytes
+  * @retval Updated CRC
+  */
+uint16_t Proto_CRC16(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/**
+  * @brief  Fill a frame header
+  * @param  header: Output buffer (PROTO_HEADER_SIZE bytes)
+  * @param  opcode: Frame opcode
+  * @param  seq: Sequence number
+  * @param  length: Payload length in bytes
+  * @retval None
+  */
+void Proto_BuildHeader(uint8_t header[PROTO_HEADER_SIZE], uint8_t opcode, uint8_t seq, uint16_t length)
+{
+    header[0] = PROTO_SYNC0;
+    header[1] = PROTO_SYNC1;
+    header[2] = opcode;
+    header[3] = seq;
+    Proto_PutU16(&header[4], length);
+}
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    smu_protocol.h
+  * @brief   Binary framed UART protocol (optional, negotiated via COMM_OK,BIN)
+  * @date    October 2025
+  ******************************************************************************
+  * Frame layout (multi-byte fields little-endian):
+  *
+  *   | 0xA5 | 0x5A | opcode | seq | length (2) | payload (length) | CRC16 (2) |
+  *
+  * CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over opcode, seq,
+  * length and payload. Replies echo the request seq and set PROTO_REPLY_FLAG
+  * in the opcode. Errors are reported with PROTO_OP_ERROR.
+  ******************************************************************************
+  */
+
+#ifndef INC_SMU_PROTOCOL_H_
+#define INC_SMU_PROTOCOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Framing */
+#define PROTO_SYNC0             0xA5
+#define PROTO_SYNC1             0x5A
+#define PROTO_HEADER_SIZE       6    // sync0, sync1, opcode, seq, length (2)
+#define PROTO_CRC_SIZE          2
+#define PROTO_MAX_PAYLOAD       256  // Largest request payload accepted
+#define PROTO_VERSION           1
+#define PROTO_REPLY_FLAG        0x80
+
+/* Opcodes */
+typedef enum {
+    PROTO_OP_COMM_OK  = 0x01,  // -> [version u8]
+    PROTO_OP_TIME     = 0x02,  // [] or [timestamps u8] -> [TIM2 us u32]
+    PROTO_OP_STATS    = 0x03,  // [] or [clear u8] -> profiling counters (see SendStatsFrame)
+    PROTO_OP_SET_DAC  = 0x10,  // [ch u8][value u16] -> [status u8]
+    PROTO_OP_SET_ALL  = 0x11,  // [value u16] -> [status u8]
+    PROTO_OP_SET_MULTI = 0x12, // [mask u8][value u16 x 4] -> [status u8], latched together
+    PROTO_OP_READ_ADC = 0x20,  // [ch u8] -> [calibrated code i16]
+    PROTO_OP_SCAN     = 0x21,  // [mask u8 or u16][oversample u8] -> [code i16 x channels in mask]
+                               //   (-32768 for a channel whose conversions all failed)
+    PROTO_OP_READ_ADC_FILTERED = 0x22, // [ch u8][oversample u16][filter u8]
+                               //   -> [value i32][stddev u32][count u16], codes x 16
+    PROTO_OP_READ_ADC_RANGED = 0x23,   // [ch u8][oversample u16][filter u8] -> [uV i32]
+                               //   [stddev uV u32][count u16][pga u8], autoranged if enabled
+    PROTO_OP_AUTORANGE = 0x24, // [ch u8][enable u8] -> [status u8]
+    PROTO_OP_SWEEP    = 0x30,  // [dac u8][adc u8][start u16][stop u16][steps u16][settle_us u32]
+                               //   ([tol u16][max_us u32] for adaptive settling)
+                               //   -> [code i16 x steps], adaptive: then [settle_us u32 x steps]
+    PROTO_OP_STREAM   = 0x31,  // [ch u8 0-15][sps u16][count u32] -> data frames [code i16 x n] ...
+    PROTO_OP_STREAM_END = 0x32,//   ... then one STREAM_END reply [samples u32][overruns u32]
+    PROTO_OP_WAVE_LOAD = 0x40, // [ch u8][offset u16][code u16 x n] -> [status u8]
+    PROTO_OP_WAVE_PLAY = 0x41, // [rate u16][loops u16][adc_ch u8, 0xFF = none] -> data frames
+                               //   [code i16 x n] (capture only) ...
+    PROTO_OP_WAVE_END = 0x42,  //   ... then one WAVE_END reply [steps u32][missed u32]
+    PROTO_OP_TRIGGER  = 0x50,  // [] pulse now, or [per-step u8] arm sweep pulses -> [status u8]
+    PROTO_OP_EVENT    = 0x60,  // Unsolicited, seq 0: [event u8][ch u8][threshold i16]
+    PROTO_OP_ERROR    = 0x7F   // -> [request opcode u8][error u8]
+} Proto_Opcode_t;
+
+/* Error codes carried in PROTO_OP_ERROR replies */
+typedef enum {
+    PROTO_ERR_NONE        = 0,
+    PROTO_ERR_BAD_CRC     = 1,
+    PROTO_ERR_UNKNOWN_OP  = 2,
+    PROTO_ERR_BAD_ARG     = 3,
+    PROTO_ERR_HW          = 4
+} Proto_Error_t;
+
+/* Events carried in unsolicited PROTO_OP_EVENT frames */
+typedef enum {
+    PROTO_EVENT_LIMIT_TRIP = 1  // Current limit tripped, the channel's DAC was zeroed
+} Proto_Event_t;
+
+/* Result of feeding one byte to the parser */
+typedef enum {
+    PROTO_FRAME_NONE = 0,   // Frame in progress (or idle)
+    PROTO_FRAME_READY,      // Complete frame with valid CRC in parser
+    PROTO_FRAME_BAD_CRC     // Complete frame but CRC mismatch
+} Proto_Result_t;
+
+/* Incremental frame parser state */
+typedef struct {
+    uint8_t state;
+    uint8_t opcode;
+    uint8_t seq;
+    uint16_t length;
+    uint16_t index;
+    uint16_t crc;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+} Proto_Parser_t;
+
+/* Function Prototypes */
+void Proto_ParserReset(Proto_Parser_t *parser);
+uint8_t Proto_ParserIdle(const Proto_Parser_t *parser);
+Proto_Result_t Proto_ParseByte(Proto_Parser_t *parser, uint8_t byte);
+uint16_t Proto_CRC16(uint16_t crc, const uint8_t *data, uint16_t len);
+void Proto_BuildHeader(uint8_t header[PROTO_HEADER_SIZE], uint8_t opcode, uint8_t seq, uint16_t length);
+
+/* Little-endian field helpers */
+static inline uint16_t Proto_GetU16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t Proto_GetU32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+static inline void Proto_PutU16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SMU_PROTOCOL_H_ */
@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file    smu_stats.c
+  * @brief   Firmware profiling: DWT cycle-count timings and error counters
+  * @date    October 2025
+  ******************************************************************************
+  * Hot paths take Stats_Cycles() on entry and hand it to Stats_Record() on
+  * exit; the DWT cycle counter costs one bus read, so instrumented builds keep
+  * their timing. Each path keeps count/min/max/total in cycles plus a log2
+  * histogram in microseconds, which shows the spread the mean hides (e.g. a
+  * conversion that normally takes 1.2 ms but occasionally times out).
+  * Timings and counters are updated from thread mode and from interrupts
+  * (I2C error callbacks), so updates run with interrupts masked.
+  ******************************************************************************
+  */
+
+#include "smu_stats.h"
+#include <string.h>
+
+static const char *const timer_names[STATS_TIMER_COUNT] = {
+    "dac_i2c", "adc_i2c", "adc_wait", "command", "uart_tx"
+};
+
+static const char *const counter_names[STATS_COUNTER_COUNT] = {
+    "dac_i2c_errors", "adc_i2c_errors", "adc_timeouts", "rx_overflows",
+    "line_overflows", "bad_frames", "tx_stalls", "stream_skips"
+};
+
+static Stats_Timing_t timings[STATS_TIMER_COUNT];
+static uint32_t counters[STATS_COUNTER_COUNT];
+static uint32_t cycles_per_us = 1;
+
+/**
+  * @brief  Start the DWT cycle counter and clear all statistics
+  * @note   Call after SystemClock_Config, the histogram scale follows SystemCoreClock
+  * @retval None
+  */
+void Stats_Init(void)
+{
+#if SMU_STATS
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    cycles_per_us = (SystemCoreClock >= 1000000) ? SystemCoreClock / 1000000 : 1;
+    Stats_Reset();
+}
+
+/**
+  * @brief  Clear all timings and counters
+  * @retval None
+  */
+void Stats_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    memset(timings, 0, sizeof(timings));
+    memset(counters, 0, sizeof(counters));
+    for (uint8_t i = 0; i < STATS_TIMER_COUNT; i++)
+        timings[i].min = UINT32_MAX;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Record one pass through a timed path
+  * @param  timer: Path
+  * @param  start_cycles: Stats_Cycles() taken when the path was entered
+  * @retval None
+  */
+void Stats_Record(Stats_Timer_t timer, uint32_t start_cycles)
+{
+#if SMU_STATS
+    uint32_t cycles = Stats_Cycles() - start_cycles;
+    uint32_t us = cycles / cycles_per_us;
+    uint8_t bucket = 0;
+
+    while (us > 0 && bucket < STATS_HIST_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    Stats_Timing_t *timing = &timings[timer];
+    timing->count++;
+    timing->total += cycles;
+    if (cycles < timing->min)
+        timing->min = cycles;
+    if (cycles > timing->max)
+        timing->max = cycles;
+    timing->histogram[bucket]++;
+
+    __set_PRIMASK(primask);
+#endif
+}
+
+/**
+  * @brief  Count one event
+  * @param  counter: Event
+  * @retval None
+  */
+void Stats_Count(Stats_Counter_t counter)
+{
+#if SMU_STATS
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    counters[counter]++;
+    __set_PRIMASK(primask);
+#endif
+}
+
+/**
+  * @brief  Copy the timing summary of a path
+  * @note   min is 0 while the path has not run
+  * @param  timer: Path
+  * @param  timing: Output
+  * @retval None
+  */
+void Stats_GetTiming(Stats_Timer_t timer, Stats_Timing_t *timing)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *timing = timings[timer];
+    __set_PRIMASK(primask);
+
+    if (timing->count == 0)
+        timing->min = 0;
+}
+
+/**
+  * @brief  Value of an event counter
+  * @param  counter: Event
+  * @retval Events since the last reset
+  */
+uint32_t Stats_GetCounter(Stats_Counter_t counter)
+{
+    return counters[counter];
+}
+
+/**
+  * @brief  Name of a timed path as reported by "stats"
+  * @param  timer: Path
+  * @retval Name
+  */
+const char* Stats_TimerName(Stats_Timer_t timer)
+{
+    return timer_names[timer];
+}
+
+/**
+  * @brief  Name of an event counter as reported by "stats"
+  * @param  counter: Event
+  * @retval Name
+  */
+const char* Stats_CounterName(Stats_Counter_t counter)
+{
+    return counter_names[counter];
+}
@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file    smu_stats.h
+  * @brief   Firmware profiling: DWT cycle-count timings and error counters
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_SMU_STATS_H_
+#define INC_SMU_STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Build option: 0 compiles every hook to nothing ("stats" then reports zeros) */
+#ifndef SMU_STATS
+#define SMU_STATS                   1
+#endif
+
+/* Histogram bucket n counts durations of 2^(n-1) to 2^n - 1 us (bucket 0: below
+   1 us), the last bucket everything from 2^(STATS_HIST_BUCKETS-2) us up */
+#define STATS_HIST_BUCKETS          16
+
+/* Timed code paths */
+typedef enum {
+    STATS_DAC_I2C = 0,      // Blocking MCP4728 transfer (I2C1)
+    STATS_ADC_I2C,          // Blocking ADS1115 config write or conversion read (I2C2)
+    STATS_ADC_WAIT,         // Wait for a single-shot conversion to finish
+    STATS_COMMAND,          // One ASCII command or binary frame, parse to last reply byte queued
+    STATS_UART_TX,          // Queueing reply bytes (includes waits for a full TX ring)
+    STATS_TIMER_COUNT
+} Stats_Timer_t;
+
+/* Event counters */
+typedef enum {
+    STATS_DAC_I2C_ERRORS = 0,   // Failed MCP4728 transfers (blocking and interrupt mode)
+    STATS_ADC_I2C_ERRORS,       // Failed ADS1115 transfers, including reads that returned 0
+    STATS_ADC_TIMEOUTS,         // Conversions not reported ready within twice their period
+    STATS_RX_OVERFLOWS,         // Received chunks cut short by a full RX ring
+    STATS_LINE_OVERFLOWS,       // ASCII commands dropped for exceeding the line buffer
+    STATS_BAD_FRAMES,           // Binary frames dropped for a bad CRC or length
+    STATS_TX_STALLS,            // Replies that had to wait for TX ring space
+    STATS_STREAM_SKIPS,         // Times a paced stream fell a period behind and skipped ahead
+    STATS_COUNTER_COUNT
+} Stats_Counter_t;
+
+/* Timing summary of one code path, in CPU cycles */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[STATS_HIST_BUCKETS];
+} Stats_Timing_t;
+
+/* Function Prototypes */
+void Stats_Init(void);
+void Stats_Reset(void);
+void Stats_Record(Stats_Timer_t timer, uint32_t start_cycles);
+void Stats_Count(Stats_Counter_t counter);
+void Stats_GetTiming(Stats_Timer_t timer, Stats_Timing_t *timing);
+uint32_t Stats_GetCounter(Stats_Counter_t counter);
+const char* Stats_TimerName(Stats_Timer_t timer);
+const char* Stats_CounterName(Stats_Counter_t counter);
+
+/**
+  * @brief  Current DWT cycle count, the start argument of Stats_Record
+  * @retval CPU cycles (wraps every 2^32 cycles, ~24 s at 180 MHz)
+  */
+static inline uint32_t Stats_Cycles(void)
+{
+#if SMU_STATS
+    return DWT->CYCCNT;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SMU_STATS_H_ */
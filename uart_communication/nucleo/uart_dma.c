@@ -0,0 +1,218 @@
+/**
+  ******************************************************************************
+  * @file    uart_dma.c
+  * @brief   DMA-driven UART transport implementation
+  * @date    October 2025
+  ******************************************************************************
+  * RX: the DMA writes continuously into rx_dma_buf (circular mode). HAL reports
+  * the write position on half-transfer, transfer-complete and idle-line events;
+  * the new bytes are copied into rx_ring, which the main loop drains. Bytes
+  * keep arriving while the main loop is blocked in I2C transfers.
+  *
+  * TX: UART_DMA_Send copies into tx_ring and starts a DMA transfer of the
+  * longest contiguous block if none is running. The TX complete callback
+  * releases that block and chains the next one.
+  ******************************************************************************
+  */
+
+#include "uart_dma.h"
+#include "ring_buffer.h"
+#include "smu_stats.h"
+
+static UART_HandleTypeDef *uart = NULL;
+
+static uint8_t rx_dma_buf[UART_DMA_RX_DMA_SIZE];
+static uint8_t rx_storage[UART_DMA_RX_RING_SIZE];
+static uint8_t tx_storage[UART_DMA_TX_RING_SIZE];
+static RingBuffer_t rx_ring;
+static RingBuffer_t tx_ring;
+
+static uint16_t rx_last_pos = 0;          // Last DMA position copied into rx_ring
+static volatile uint16_t tx_active = 0;   // Length of the block currently sent by DMA
+static volatile uint32_t rx_overflows = 0;
+
+static void StartReception(void);
+static void RxOverflow(void);
+static void StartTransmission(void);
+
+/**
+  * @brief  Start DMA reception and reset both rings
+  * @param  huart: UART handle with hdmarx (circular) and hdmatx linked
+  * @retval HAL status
+  */
+HAL_StatusTypeDef UART_DMA_Init(UART_HandleTypeDef *huart)
+{
+    uart = huart;
+    RingBuffer_Init(&rx_ring, rx_storage, sizeof(rx_storage));
+    RingBuffer_Init(&tx_ring, tx_storage, sizeof(tx_storage));
+    rx_last_pos = 0;
+    tx_active = 0;
+
+    if (HAL_UARTEx_ReceiveToIdle_DMA(uart, rx_dma_buf, sizeof(rx_dma_buf)) != HAL_OK)
+        return HAL_ERROR;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Read received bytes (main loop side)
+  * @param  data: Output buffer
+  * @param  len: Maximum number of bytes
+  * @retval Number of bytes read
+  */
+uint16_t UART_DMA_Read(uint8_t *data, uint16_t len)
+{
+    return RingBuffer_Read(&rx_ring, data, len);
+}
+
+/**
+  * @brief  Queue bytes for transmission
+  * @note   Returns once everything is queued, so the caller may reuse its buffer.
+  *         Blocks only while the TX ring is full, so call from thread mode only.
+  * @param  data: Bytes to send
+  * @param  len: Number of bytes
+  * @retval None
+  */
+void UART_DMA_Send(const uint8_t *data, uint16_t len)
+{
+    uint32_t start = Stats_Cycles();
+    uint8_t stalled = 0;
+
+    while (len > 0)
+    {
+        uint16_t written = RingBuffer_Write(&tx_ring, data, len);
+        data += written;
+        len -= written;
+
+        StartTransmission();
+        if (len > 0 && !stalled)
+        {
+            stalled = 1;
+            Stats_Count(STATS_TX_STALLS);
+        }
+    }
+    Stats_Record(STATS_UART_TX, start);
+}
+
+/**
+  * @brief  Wait until all queued bytes have been handed to the UART
+  * @retval None
+  */
+void UART_DMA_Flush(void)
+{
+    while (RingBuffer_Count(&tx_ring) > 0)
+        StartTransmission();
+}
+
+/**
+  * @brief  Number of received bytes dropped because rx_ring was full
+  */
+uint32_t UART_DMA_GetRxOverflows(void)
+{
+    return rx_overflows;
+}
+
+/**
+  * @brief  Copy newly received bytes from the DMA buffer into rx_ring
+  * @param  huart: UART handle
+  * @param  pos: Current DMA write position (as reported by HAL)
+  * @retval None
+  */
+void UART_DMA_RxEventHandler(UART_HandleTypeDef *huart, uint16_t pos)
+{
+    if (huart != uart || pos == rx_last_pos)
+        return;
+
+    if (pos > rx_last_pos)
+    {
+        uint16_t len = pos - rx_last_pos;
+        if (RingBuffer_Write(&rx_ring, &rx_dma_buf[rx_last_pos], len) != len)
+            RxOverflow();
+    }
+    else
+    {
+        // DMA wrapped around: tail of the buffer, then the start
+        uint16_t len = sizeof(rx_dma_buf) - rx_last_pos;
+        if (RingBuffer_Write(&rx_ring, &rx_dma_buf[rx_last_pos], len) != len)
+            RxOverflow();
+        if (pos > 0 && RingBuffer_Write(&rx_ring, rx_dma_buf, pos) != pos)
+            RxOverflow();
+    }
+
+    rx_last_pos = (pos == sizeof(rx_dma_buf)) ? 0 : pos;
+}
+
+/**
+  * @brief  Release the block just sent and chain the next one
+  * @param  huart: UART handle
+  * @retval None
+  */
+void UART_DMA_TxCpltHandler(UART_HandleTypeDef *huart)
+{
+    if (huart != uart)
+        return;
+
+    RingBuffer_Consume(&tx_ring, tx_active);
+    tx_active = 0;
+    StartTransmission();
+}
+
+/**
+  * @brief  Recover from UART errors (overrun, framing, noise)
+  * @note   HAL stops the reception on errors; restart it so RX never stalls
+  * @param  huart: UART handle
+  * @retval None
+  */
+void UART_DMA_ErrorHandler(UART_HandleTypeDef *huart)
+{
+    if (huart != uart)
+        return;
+
+    StartReception();
+
+    // A TX transfer aborted by the error will not complete, drop it
+    if (tx_active > 0 && huart->gState == HAL_UART_STATE_READY)
+    {
+        RingBuffer_Consume(&tx_ring, tx_active);
+        tx_active = 0;
+        StartTransmission();
+    }
+}
+
+/**
+  * @brief  Count a received chunk cut short by a full rx_ring
+  */
+static void RxOverflow(void)
+{
+    rx_overflows++;
+    Stats_Count(STATS_RX_OVERFLOWS);
+}
+
+/**
+  * @brief  (Re)start circular DMA reception with idle-line detection
+  */
+static void StartReception(void)
+{
+    rx_last_pos = 0;
+    HAL_UARTEx_ReceiveToIdle_DMA(uart, rx_dma_buf, sizeof(rx_dma_buf));
+}
+
+/**
+  * @brief  Start a DMA transfer if none is running and data is queued
+  * @note   Called from both thread and interrupt context, so the check-and-start
+  *         runs with interrupts masked
+  */
+static void StartTransmission(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx_active == 0)
+    {
+        const uint8_t *block;
+        uint16_t len = RingBuffer_Contiguous(&tx_ring, &block);
+        if (len > 0 && HAL_UART_Transmit_DMA(uart, block, len) == HAL_OK)
+            tx_active = len;
+    }
+
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,40 @@
+/**
+  ******************************************************************************
+  * @file    uart_dma.h
+  * @brief   DMA-driven UART transport: circular RX with idle-line detection and
+  *          queued TX, both through SPSC ring buffers
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_UART_DMA_H_
+#define INC_UART_DMA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Buffer sizes (powers of two) */
+#define UART_DMA_RX_DMA_SIZE    256   // Circular DMA target
+#define UART_DMA_RX_RING_SIZE   1024  // Bytes queued for the command parser
+#define UART_DMA_TX_RING_SIZE   2048  // Bytes queued for transmission
+
+/* Function Prototypes */
+HAL_StatusTypeDef UART_DMA_Init(UART_HandleTypeDef *huart);
+uint16_t UART_DMA_Read(uint8_t *data, uint16_t len);
+void UART_DMA_Send(const uint8_t *data, uint16_t len);
+void UART_DMA_Flush(void);
+uint32_t UART_DMA_GetRxOverflows(void);
+
+/* Call from the matching HAL callbacks */
+void UART_DMA_RxEventHandler(UART_HandleTypeDef *huart, uint16_t pos);
+void UART_DMA_TxCpltHandler(UART_HandleTypeDef *huart);
+void UART_DMA_ErrorHandler(UART_HandleTypeDef *huart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_UART_DMA_H_ */
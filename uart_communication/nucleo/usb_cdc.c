@@ -0,0 +1,228 @@
+/**
+  ******************************************************************************
+  * @file    usb_cdc.c
+  * @brief   Native USB full-speed CDC transport implementation
+  * @date    October 2025
+  ******************************************************************************
+  * Built with SMU_USE_USB_CDC=1 on top of the ST USB device library (CubeMX
+  * USB_DEVICE middleware, CDC class, which provides hUsbDeviceFS). The CDC
+  * interface template must hand its callbacks over to this module:
+  *   CDC_Receive_FS:     USB_CDC_RxHandler(Buf, *Len); return USBD_OK;
+  *   CDC_TransmitCplt_FS: USB_CDC_TxCpltHandler();
+  *
+  * RX: each OUT packet is copied into rx_ring from the USB interrupt. The
+  * endpoint is only re-armed while the ring has room for another packet, so
+  * a busy main loop makes the host NAK instead of losing bytes.
+  *
+  * TX: USB_CDC_Send copies into tx_ring and starts an IN transfer of the
+  * longest contiguous block (up to USB_CDC_TX_MAX_TRANSFER). Transfers never
+  * end on a full packet, so the host completes each one without waiting for
+  * a zero-length packet. Without a configured host, or when the host stops
+  * reading for USB_CDC_TX_TIMEOUT_MS, replies are dropped rather than
+  * blocking the firmware.
+  ******************************************************************************
+  */
+
+#include "main.h"
+
+#if SMU_USE_USB_CDC
+
+#include "usb_cdc.h"
+#include "ring_buffer.h"
+#include "smu_stats.h"
+#include "usbd_cdc.h"
+
+#define USB_CDC_TX_TIMEOUT_MS   100
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+static uint8_t rx_storage[USB_CDC_RX_RING_SIZE];
+static uint8_t tx_storage[USB_CDC_TX_RING_SIZE];
+static RingBuffer_t rx_ring;
+static RingBuffer_t tx_ring;
+
+static uint8_t *rx_paused_packet = NULL;    // OUT buffer to re-arm once rx_ring has room
+static volatile uint16_t tx_active = 0;     // Length of the IN transfer in flight
+static volatile uint32_t rx_overflows = 0;
+
+static void StartTransmission(void);
+static void ResumeReception(void);
+
+/**
+  * @brief  Reset both rings (call after MX_USB_DEVICE_Init)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef USB_CDC_Init(void)
+{
+    RingBuffer_Init(&rx_ring, rx_storage, sizeof(rx_storage));
+    RingBuffer_Init(&tx_ring, tx_storage, sizeof(tx_storage));
+    rx_paused_packet = NULL;
+    tx_active = 0;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Read received bytes (main loop side)
+  * @param  data: Output buffer
+  * @param  len: Maximum number of bytes
+  * @retval Number of bytes read
+  */
+uint16_t USB_CDC_Read(uint8_t *data, uint16_t len)
+{
+    uint16_t count = RingBuffer_Read(&rx_ring, data, len);
+
+    if (rx_paused_packet != NULL && RingBuffer_Free(&rx_ring) >= USB_CDC_PACKET_SIZE)
+        ResumeReception();
+    return count;
+}
+
+/**
+  * @brief  Queue bytes for transmission
+  * @note   Returns once everything is queued (or dropped, see file header), so the
+  *         caller may reuse its buffer. Call from thread mode only.
+  * @param  data: Bytes to send
+  * @param  len: Number of bytes
+  * @retval None
+  */
+void USB_CDC_Send(const uint8_t *data, uint16_t len)
+{
+    uint32_t start = Stats_Cycles();
+    uint32_t last_progress = HAL_GetTick();
+    uint8_t stalled = 0;
+
+    while (len > 0 && USB_CDC_IsConnected())
+    {
+        uint16_t written = RingBuffer_Write(&tx_ring, data, len);
+        data += written;
+        len -= written;
+
+        StartTransmission();
+        if (len == 0)
+            break;
+
+        if (!stalled)
+        {
+            stalled = 1;
+            Stats_Count(STATS_TX_STALLS);
+        }
+        if (written > 0)
+            last_progress = HAL_GetTick();
+        else if (HAL_GetTick() - last_progress >= USB_CDC_TX_TIMEOUT_MS)
+            break;
+    }
+    Stats_Record(STATS_UART_TX, start);
+}
+
+/**
+  * @brief  Wait until all queued bytes have been handed to the USB core
+  * @retval None
+  */
+void USB_CDC_Flush(void)
+{
+    uint32_t start = HAL_GetTick();
+
+    while (RingBuffer_Count(&tx_ring) > 0 && USB_CDC_IsConnected() &&
+           HAL_GetTick() - start < USB_CDC_TX_TIMEOUT_MS)
+        StartTransmission();
+}
+
+/**
+  * @brief  1 once the host has configured the device
+  * @retval Connected flag
+  */
+uint8_t USB_CDC_IsConnected(void)
+{
+    return hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED;
+}
+
+/**
+  * @brief  Number of OUT packets cut short by a full rx_ring
+  */
+uint32_t USB_CDC_GetRxOverflows(void)
+{
+    return rx_overflows;
+}
+
+/**
+  * @brief  Queue a received OUT packet and re-arm the endpoint if there is room
+  * @param  packet: Packet data (the endpoint's receive buffer)
+  * @param  len: Number of bytes
+  * @retval None
+  */
+void USB_CDC_RxHandler(uint8_t *packet, uint32_t len)
+{
+    if (RingBuffer_Write(&rx_ring, packet, (uint16_t)len) != len)
+    {
+        rx_overflows++;
+        Stats_Count(STATS_RX_OVERFLOWS);
+    }
+
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, packet);
+    if (RingBuffer_Free(&rx_ring) >= USB_CDC_PACKET_SIZE)
+        USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+    else
+        rx_paused_packet = packet;
+}
+
+/**
+  * @brief  Release the block just sent and chain the next one
+  * @retval None
+  */
+void USB_CDC_TxCpltHandler(void)
+{
+    RingBuffer_Consume(&tx_ring, tx_active);
+    tx_active = 0;
+    StartTransmission();
+}
+
+/**
+  * @brief  Re-arm the OUT endpoint paused by USB_CDC_RxHandler
+  * @note   Runs with interrupts masked, the USB interrupt also touches rx_paused_packet
+  */
+static void ResumeReception(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (rx_paused_packet != NULL)
+    {
+        rx_paused_packet = NULL;
+        USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Start an IN transfer if none is running and data is queued
+  * @note   Called from both thread and interrupt context, so the check-and-start
+  *         runs with interrupts masked
+  */
+static void StartTransmission(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx_active == 0)
+    {
+        const uint8_t *block;
+        uint16_t len = RingBuffer_Contiguous(&tx_ring, &block);
+
+        if (len > USB_CDC_TX_MAX_TRANSFER)
+            len = USB_CDC_TX_MAX_TRANSFER;
+        // End on a short packet; the byte held back goes out with the next transfer
+        if (len > 1 && len % USB_CDC_PACKET_SIZE == 0)
+            len--;
+
+        if (len > 0)
+        {
+            USBD_CDC_SetTxBuffer(&hUsbDeviceFS, (uint8_t*)block, len);
+            if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK)
+                tx_active = len;
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#endif /* SMU_USE_USB_CDC */
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    usb_cdc.h
+  * @brief   Native USB full-speed CDC transport (OTG_FS, PA11/PA12), same
+  *          queued RX/TX interface as uart_dma
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_USB_CDC_H_
+#define INC_USB_CDC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Full-speed bulk packet size */
+#define USB_CDC_PACKET_SIZE     64
+
+/* Buffer sizes (powers of two) */
+#define USB_CDC_RX_RING_SIZE    1024  // Bytes queued for the command parser
+#define USB_CDC_TX_RING_SIZE    4096  // Bytes queued for transmission
+
+/* Longest single IN transfer; the host sees bulk packets back to back */
+#define USB_CDC_TX_MAX_TRANSFER 1023
+
+/* Function Prototypes */
+HAL_StatusTypeDef USB_CDC_Init(void);
+uint16_t USB_CDC_Read(uint8_t *data, uint16_t len);
+void USB_CDC_Send(const uint8_t *data, uint16_t len);
+void USB_CDC_Flush(void);
+uint8_t USB_CDC_IsConnected(void);
+uint32_t USB_CDC_GetRxOverflows(void);
+
+/* Call from CDC_Receive_FS / CDC_TransmitCplt_FS in usbd_cdc_if.c */
+void USB_CDC_RxHandler(uint8_t *packet, uint32_t len);
+void USB_CDC_TxCpltHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_USB_CDC_H_ */
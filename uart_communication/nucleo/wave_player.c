@@ -0,0 +1,277 @@
+/**
+  ******************************************************************************
+  * @file    wave_player.c
+  * @brief   Timer-driven playback of per-channel DAC code tables from RAM
+  * @date    October 2025
+  ******************************************************************************
+  * Each timer update interrupt starts one interrupt-mode MCP4728 write with the
+  * next table entry of every loaded channel, so step timing depends only on the
+  * timer and interrupt latency, not on the main loop or the host. Channels with
+  * a shorter table hold their last code until the longest table wraps.
+  * If a step's write is still in flight when the next tick arrives, that tick
+  * is skipped and counted as missed; the waveform slips by one period.
+  * Codes are calibrated when loaded, so the interrupt only copies them.
+  ******************************************************************************
+  */
+
+#include "wave_player.h"
+#include "mcp4728.h"
+#include "calibration.h"
+
+static uint16_t table[4][WAVE_MAX_POINTS];
+static uint16_t table_length[4];
+
+static I2C_HandleTypeDef *wave_i2c = NULL;
+static TIM_HandleTypeDef *wave_tim = NULL;
+
+static uint8_t play_mask = 0;
+static uint16_t play_length = 0;
+static uint16_t next_step = 0;
+static uint32_t steps_issued = 0;
+static uint32_t steps_total = 0;
+static volatile uint32_t steps_done = 0;
+static volatile uint32_t missed = 0;
+static volatile uint8_t active = 0;
+
+static HAL_StatusTypeDef IssueStep(void);
+
+/**
+  * @brief  Copy codes into a channel's table
+  * @note   Loading at offset 0 restarts the table, so a table is sent as offset 0
+  *         followed by increasing offsets. count 0 at offset 0 clears the channel.
+  * @param  channel: DAC channel (0-3)
+  * @param  offset: First table index to write
+  * @param  codes: 12-bit DAC codes
+  * @param  count: Number of codes
+  * @retval HAL_OK, HAL_ERROR for a bad argument, HAL_BUSY while playing
+  */
+HAL_StatusTypeDef Wave_Load(uint8_t channel, uint16_t offset, const uint16_t *codes, uint16_t count)
+{
+    if (active)
+        return HAL_BUSY;
+    if (channel > 3 || (uint32_t)offset + count > WAVE_MAX_POINTS)
+        return HAL_ERROR;
+    if (offset != 0 && offset != table_length[channel])
+        return HAL_ERROR;  // Chunks must arrive in order
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (codes[i] > 4095)
+            return HAL_ERROR;
+        table[channel][offset + i] = Cal_DacCode(channel, codes[i]);
+    }
+    table_length[channel] = offset + count;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Number of steps in one playback loop (longest loaded table)
+  * @retval Steps per loop
+  */
+uint16_t Wave_GetLength(void)
+{
+    uint16_t length = 0;
+
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if (table_length[ch] > length)
+            length = table_length[ch];
+    }
+    return length;
+}
+
+/**
+  * @brief  Channels with a loaded table
+  * @retval Channel bit mask
+  */
+uint8_t Wave_GetMask(void)
+{
+    uint8_t mask = 0;
+
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if (table_length[ch] > 0)
+            mask |= (1 << ch);
+    }
+    return mask;
+}
+
+/**
+  * @brief  Output the first step and start clocking out the rest from the timer
+  * @note   The timer is reprogrammed here: the prescaler is chosen so the
+  *         auto-reload value fits 16 bits, which covers 1 Hz on a 90 MHz clock.
+  * @param  hi2c: MCP4728 bus (EV/ER interrupts enabled)
+  * @param  htim: Timer with its update interrupt routed to Wave_OnTimer
+  * @param  timer_clock_hz: Timer kernel clock
+  * @param  rate_hz: Steps per second (> 0)
+  * @param  loops: Number of times to play the table (> 0)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef Wave_Start(I2C_HandleTypeDef *hi2c, TIM_HandleTypeDef *htim, uint32_t timer_clock_hz,
+                             uint32_t rate_hz, uint32_t loops)
+{
+    if (active || hi2c == NULL || htim == NULL || rate_hz == 0 || loops == 0)
+        return HAL_ERROR;
+
+    play_length = Wave_GetLength();
+    play_mask = Wave_GetMask();
+    if (play_length == 0)
+        return HAL_ERROR;
+
+    uint32_t ticks = timer_clock_hz / rate_hz;
+    uint32_t prescaler = ticks / 65536 + 1;
+
+    htim->Init.Prescaler = prescaler - 1;
+    htim->Init.Period = (ticks / prescaler) - 1;
+    if (HAL_TIM_Base_Init(htim) != HAL_OK)
+        return HAL_ERROR;
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+
+    wave_i2c = hi2c;
+    wave_tim = htim;
+    next_step = 0;
+    steps_issued = 0;
+    steps_total = (uint32_t)play_length * loops;
+    steps_done = 0;
+    missed = 0;
+    active = 1;
+
+    // Step 0 goes out now, the timer takes over from step 1
+    if (IssueStep() != HAL_OK)
+    {
+        active = 0;
+        return HAL_ERROR;
+    }
+    if (steps_issued < steps_total && HAL_TIM_Base_Start_IT(htim) != HAL_OK)
+    {
+        active = 0;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop playback; outputs keep the last written codes
+  * @retval None
+  */
+void Wave_Stop(void)
+{
+    if (wave_tim != NULL)
+        HAL_TIM_Base_Stop_IT(wave_tim);
+
+    // Let the last write finish so the shadow registers match the outputs
+    while (MCP4728_IsBusy()) {}
+    active = 0;
+}
+
+/**
+  * @brief  Stop issuing steps without waiting for the write in flight (callable from an ISR)
+  * @note   Follow with Wave_Stop from the main loop before touching the DAC.
+  * @retval None
+  */
+void Wave_Abort(void)
+{
+    if (wave_tim != NULL)
+        HAL_TIM_Base_Stop_IT(wave_tim);
+    active = 0;
+}
+
+/**
+  * @brief  1 until every step has been written (or playback was stopped)
+  * @retval Active flag
+  */
+uint8_t Wave_IsActive(void)
+{
+    return active;
+}
+
+/**
+  * @brief  Steps whose DAC write has completed
+  * @retval Step count since Wave_Start
+  */
+uint32_t Wave_GetStepsDone(void)
+{
+    return steps_done;
+}
+
+/**
+  * @brief  Timer ticks skipped because the previous write was still running
+  * @retval Missed tick count since Wave_Start
+  */
+uint32_t Wave_GetMissed(void)
+{
+    return missed;
+}
+
+/**
+  * @brief  Timer update interrupt: start the write for the next step
+  * @param  htim: Timer that elapsed
+  * @retval None
+  */
+void Wave_OnTimer(TIM_HandleTypeDef *htim)
+{
+    if (!active || htim != wave_tim)
+        return;
+
+    if (IssueStep() != HAL_OK)
+        missed++;
+
+    if (steps_issued >= steps_total)
+        HAL_TIM_Base_Stop_IT(wave_tim);
+}
+
+/**
+  * @brief  MCP4728 interrupt-mode write finished
+  * @retval None
+  */
+void Wave_OnWriteComplete(void)
+{
+    if (!active)
+        return;
+
+    steps_done++;
+    if (steps_done >= steps_total)
+        active = 0;
+}
+
+/**
+  * @brief  MCP4728 interrupt-mode write failed; the step counts as done but missed
+  * @retval None
+  */
+void Wave_OnWriteError(void)
+{
+    if (!active)
+        return;
+
+    missed++;
+    Wave_OnWriteComplete();
+}
+
+/**
+  * @brief  Start the DAC write for next_step and advance
+  * @retval HAL_OK, HAL_BUSY if the previous write is still in flight
+  */
+static HAL_StatusTypeDef IssueStep(void)
+{
+    uint16_t values[4] = {0};
+
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if ((play_mask & (1 << ch)) == 0)
+            continue;
+
+        uint16_t index = next_step;
+        if (index >= table_length[ch])
+            index = table_length[ch] - 1;  // Shorter table holds its last code
+        values[ch] = table[ch][index];
+    }
+
+    HAL_StatusTypeDef status = MCP4728_WriteChannelsIT(wave_i2c, values, play_mask);
+    if (status != HAL_OK)
+        return status;
+
+    steps_issued++;
+    if (++next_step >= play_length)
+        next_step = 0;
+    return HAL_OK;
+}
@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    wave_player.h
+  * @brief   Timer-driven playback of per-channel DAC code tables from RAM
+  * @date    October 2025
+  ******************************************************************************
+  */
+
+#ifndef INC_WAVE_PLAYER_H_
+#define INC_WAVE_PLAYER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+/* Table length per channel (4 x 2 KB) */
+#define WAVE_MAX_POINTS         1024
+
+/* Function Prototypes */
+HAL_StatusTypeDef Wave_Load(uint8_t channel, uint16_t offset, const uint16_t *codes, uint16_t count);
+uint16_t Wave_GetLength(void);
+uint8_t Wave_GetMask(void);
+HAL_StatusTypeDef Wave_Start(I2C_HandleTypeDef *hi2c, TIM_HandleTypeDef *htim, uint32_t timer_clock_hz,
+                             uint32_t rate_hz, uint32_t loops);
+void Wave_Stop(void);
+void Wave_Abort(void);
+uint8_t Wave_IsActive(void);
+uint32_t Wave_GetStepsDone(void);
+uint32_t Wave_GetMissed(void);
+
+/* Call from the matching interrupt callbacks */
+void Wave_OnTimer(TIM_HandleTypeDef *htim);
+void Wave_OnWriteComplete(void);
+void Wave_OnWriteError(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_WAVE_PLAYER_H_ */
@@ -1,18 +1,150 @@
 import serial
 import serial.tools.list_ports
+import struct
+import threading
 import time
+from concurrent.futures import Future, ThreadPoolExecutor
 
+import numpy as np
 
-def list_available_ports():
-    """List all available COM ports."""
+
+# Binary framed protocol (see nucleo/smu_protocol.h), enabled with enable_binary_mode()
+PROTO_SYNC = b'\xA5\x5A'
+PROTO_REPLY_FLAG = 0x80
+PROTO_OP_COMM_OK = 0x01
+PROTO_OP_TIME = 0x02
+PROTO_OP_STATS = 0x03
+PROTO_OP_SET_DAC = 0x10
+PROTO_OP_SET_ALL = 0x11
+PROTO_OP_SET_MULTI = 0x12
+PROTO_OP_READ_ADC = 0x20
+PROTO_OP_SCAN = 0x21
+PROTO_OP_READ_ADC_FILTERED = 0x22
+PROTO_OP_READ_ADC_RANGED = 0x23
+PROTO_OP_AUTORANGE = 0x24
+PROTO_OP_SWEEP = 0x30
+PROTO_OP_STREAM = 0x31
+PROTO_OP_STREAM_END = 0x32
+PROTO_OP_WAVE_LOAD = 0x40
+PROTO_OP_WAVE_PLAY = 0x41
+PROTO_OP_WAVE_END = 0x42
+PROTO_OP_TRIGGER = 0x50
+PROTO_OP_EVENT = 0x60
+PROTO_EVENT_LIMIT_TRIP = 1
+PROTO_OP_ERROR = 0x7F
+PROTO_ERRORS = {1: "BAD_CRC", 2: "UNKNOWN_OP", 3: "BAD_ARG", 4: "HW"}
+
+# ADS1115 at ±6.144V PGA: LSB = 6.144V / 32768
+ADC_LSB_VOLTS = 6.144 / 32768.0
+# On-MCU oversampling filters (read_adc,ch,n,filter)
+ADC_FILTERS = {'boxcar': 0, 'median': 1, 'decimate': 2}
+ADC_FILTER_FRAC_BITS = 4
+# Full scale in volts per ADS1115 PGA setting, indexed by the range tag of autoranged readings
+ADC_PGA_RANGES = (6.144, 4.096, 2.048, 1.024, 0.512, 0.256)
+# Scan/stream channels with SMU_ADC_COUNT=4 ADS1115s (4 per chip, chip n = channels 4n-4n+3)
+ADC_SCAN_CHANNELS = 16
+# Firmware profiling ("stats"), in the order of Stats_Timer_t / Stats_Counter_t in smu_stats.h
+STATS_TIMERS = ('dac_i2c', 'adc_i2c', 'adc_wait', 'command', 'uart_tx')
+STATS_COUNTERS = ('dac_i2c_errors', 'adc_i2c_errors', 'adc_timeouts', 'rx_overflows',
+                  'line_overflows', 'bad_frames', 'tx_stalls', 'stream_skips')
+STATS_HIST_BUCKETS = 16
+# Background reader: poll for a frame's sync bytes this often (bounds stop_async()), then
+# allow this long plus the payload's transfer time for the rest of the frame
+ASYNC_SYNC_TIMEOUT = 0.1
+ASYNC_FRAME_TIMEOUT = 0.5
+# USB IDs: native CDC port of SMU_USE_USB_CDC firmware (ST's default VCP IDs) and
+# the ST-LINK/V2-1 and V3 virtual COM ports that carry USART2
+USB_CDC_VID_PID = (0x0483, 0x5740)
+STLINK_VID = 0x0483
+STLINK_VCP_PIDS = (0x374B, 0x374E, 0x3752)
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), as used by the firmware framing."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def adc_codes_to_volts(codes):
+    """Convert raw ADS1115 codes (int or array) to volts, clamped to 0-5V like the firmware."""
+    return np.clip(np.asarray(codes, dtype=np.float64) * ADC_LSB_VOLTS, 0.0, 5.0)
+
+
+def ascii_error(line):
+    """
+    Decode an ASCII error reply.
+
+    Args:
+        line (str): Reply line
+
+    Returns:
+        str: Error name from PROTO_ERRORS for an "ERR,<code>" line, None for any other line
+    """
+    if not line or not line.startswith("ERR,"):
+        return None
+    try:
+        code = int(line[4:])
+    except ValueError:
+        return None
+    return PROTO_ERRORS.get(code, str(code))
+
+
+def list_available_ports(verbose=True):
+    """
+    List all available COM ports.
+
+    Args:
+        verbose (bool): Print the list
+
+    Returns:
+        list: serial.tools.list_ports ListPortInfo entries
+    """
     ports = serial.tools.list_ports.comports()
-    print("Available COM ports:")
-    if ports:
-        for port in ports:
-            print(f"  - {port.device}: {port.description}")
-    else:
-        print("  No COM ports found!")
-    print()
+    if verbose:
+        print("Available COM ports:")
+        if ports:
+            for port in ports:
+                print(f"  - {port.device}: {port.description}")
+        else:
+            print("  No COM ports found!")
+        print()
+    return ports
+
+
+def find_smu_port():
+    """
+    Find the SMU's serial port by USB ID, preferring the native USB CDC port.
+
+    Returns:
+        tuple: (port name, True if native USB CDC), or (None, False) if none is found
+    """
+    ports = serial.tools.list_ports.comports()
+    for port in ports:
+        if (port.vid, port.pid) == USB_CDC_VID_PID:
+            return port.device, True
+    for port in ports:
+        if port.vid == STLINK_VID and port.pid in STLINK_VCP_PIDS:
+            return port.device, False
+    return None, False
+
+
+def is_usb_cdc_port(port_name):
+    """True if port_name is the native USB CDC port of SMU_USE_USB_CDC firmware."""
+    for port in serial.tools.list_ports.comports():
+        if port.device == port_name:
+            return (port.vid, port.pid) == USB_CDC_VID_PID
+    return False
+
+
+class FrameError(Exception):
+    """A binary frame was cut short or failed its CRC; seq is None if its header was not read."""
+
+    def __init__(self, message, seq=None):
+        super().__init__(message)
+        self.seq = seq
 
 
 class SerialController:
@@ -21,20 +153,41 @@ class SerialController:
     Provides common serial connection and communication methods.
     """
     
-    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True):
+    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True, dtr_reset=True):
         """
         Initialize the serial controller.
         
         Args:
-            port (str): Serial port name (e.g., "COM3", "/dev/ttyUSB0")
-            baud (int): Baud rate (default: 115200)
+            port (str): Serial port name (e.g., "COM3", "/dev/ttyUSB0"), or "auto" to
+                        pick the native USB CDC port, else the ST-LINK VCP (find_smu_port())
+            baud (int): Baud rate (default: 115200, ignored by the native USB CDC port)
             auto_connect (bool): Automatically connect on initialization
             verbose (bool): Print connection messages
+            dtr_reset (bool): Opening the port may reset the MCU through DTR, so wait
+                              2 s after opening. With False, DTR/RTS are held low
+                              while opening and the port is usable immediately
+                              (the Nucleo's ST-LINK VCP does not reset on DTR).
+                              Always False on the native USB CDC port.
         """
         self.port = port
         self.baud = baud
         self.ser = None
         self.verbose = verbose
+        self.dtr_reset = dtr_reset
+        self.usb_cdc = False  # Connected through the native USB CDC port (SMU_USE_USB_CDC)
+        self.binary = False   # Binary framed protocol negotiated with enable_binary_mode()
+        self._seq = 0
+        self._reader = None             # Background reader thread, started with start_async()
+        self._reader_stop = threading.Event()
+        self._pending = {}              # seq -> (Future, parse) of commands in flight
+        self._pending_lock = threading.Lock()
+        self.trips = []                 # Current limit trips reported by the MCU, oldest first
+        self.on_trip = None             # Optional callback(trip dict), runs on the reading thread
+        self.timestamps = False         # MCU appends TIM2 microsecond timestamps (enable_timestamps())
+        self.last_timestamp = None      # MCU time (us) of the last timestamped reading
+        self._clock_sync = None         # (host time.time(), MCU us) of the last sync_clock()
+        self.clock_rate = 1e6           # MCU microseconds per host second, refined by sync_clock()
+        self.last_error = None          # Error name of the last "ERR,<code>" reply, None after a good one
         
         if auto_connect:
             self.connect()
@@ -42,13 +195,28 @@ class SerialController:
     def connect(self):
         """Establish serial connection to the MCU."""
         # List available ports
-        list_available_ports()
+        list_available_ports(self.verbose)
+
+        if self.port == "auto":
+            port, _ = find_smu_port()
+            if port is None:
+                raise serial.SerialException("No SMU found (no native USB CDC or ST-LINK VCP port)")
+            self.port = port
+        
+        # The native USB CDC port has no DTR-driven reset and no baud rate: data
+        # moves at USB speed whatever the host sets
+        self.usb_cdc = is_usb_cdc_port(self.port)
+        if self.usb_cdc:
+            self.dtr_reset = False
+            if self.verbose:
+                print(f"{self.port} is the native USB CDC port (baud setting ignored)")
         
-        # Check if the requested port is available
-        if self.verbose:
+        # Check if the requested port is available (the probe opens the port,
+        # which would toggle DTR, so it is skipped when the MCU must not be reset)
+        if self.dtr_reset and self.verbose:
             print(f"Checking if {self.port} is available...")
         
-        if not self._check_port_available(self.port):
+        if self.dtr_reset and not self._check_port_available(self.port):
             if self.verbose:
                 print(f"⚠️  {self.port} appears to be in use!")
                 print("\nCommon causes:")
@@ -77,8 +245,16 @@ class SerialController:
         try:
             if self.verbose:
                 print(f"Attempting to open {self.port}...")
-            self.ser = serial.Serial(self.port, self.baud, timeout=1)
-            time.sleep(2)   # Wait for STM32 reset
+            if self.dtr_reset:
+                self.ser = serial.Serial(self.port, self.baud, timeout=1)
+                time.sleep(2)   # Wait for STM32 reset
+            else:
+                self.ser = serial.Serial(None, self.baud, timeout=1)
+                self.ser.port = self.port
+                self.ser.dtr = False
+                self.ser.rts = False
+                self.ser.open()
+                self.ser.reset_input_buffer()
             if self.verbose:
                 print(f"✓ Successfully connected to {self.port}\n")
         except serial.SerialException as e:
@@ -123,21 +299,48 @@ class SerialController:
             timeout (float): Maximum time to wait in seconds
         
         Returns:
-            str: Response line if received, None if timeout
+            str: Response line if received, None if timeout. A rejected command
+                 returns its "ERR,<code>" line, decoded into last_error
         """
-        start_time = time.time()
+        deadline = time.time() + timeout
+        previous_timeout = self.ser.timeout
         
-        while (time.time() - start_time) < timeout:
-            if self.ser.in_waiting > 0:
+        # Block in readline() until the line or the deadline arrives instead of polling
+        try:
+            while True:
+                remaining = deadline - time.time()
+                if remaining <= 0:
+                    return None
+                self.ser.timeout = remaining
                 try:
                     line = self.ser.readline().decode().strip()
-                    if line:
+                    if line and not self._take_trip_line(line):
+                        self.last_error = ascii_error(line)
                         return line
                 except (UnicodeDecodeError, serial.SerialException):
                     pass
-            time.sleep(0.01)  # Small delay to avoid busy waiting
-        
-        return None
+        finally:
+            self.ser.timeout = previous_timeout
+
+    def _take_trip_line(self, line):
+        """Record an unsolicited "TRIP,<ch>,<threshold>" line; returns True if it was one."""
+        if not line.startswith("TRIP,"):
+            return False
+        try:
+            channel, threshold = (int(v) for v in line.split(',')[1:3])
+        except ValueError:
+            return False
+        self._record_trip(channel, threshold)
+        return True
+
+    def _record_trip(self, channel, threshold_code):
+        """Store a current limit trip and pass it to on_trip."""
+        trip = {'channel': channel, 'threshold_code': threshold_code, 'time': time.time()}
+        self.trips.append(trip)
+        if self.verbose:
+            print(f"  ✗ Current limit tripped on channel {channel}, DAC output zeroed")
+        if self.on_trip is not None:
+            self.on_trip(trip)
 
     def read_response(self):
         """
@@ -197,187 +400,1260 @@ class SerialController:
                 print(f"  ✗ No response from MCU within {timeout}s")
             return False
 
-    def close(self):
-        """Close the serial connection."""
-        if self.ser and self.ser.is_open:
-            self.ser.close()
-            if self.verbose:
-                print("Serial connection closed.")
-    
-    def __enter__(self):
-        """Context manager entry."""
-        return self
-    
-    def __exit__(self, exc_type, exc_val, exc_tb):
-        """Context manager exit - automatically close connection."""
-        self.close()
+    def enable_binary_mode(self, enable=True, timeout=2.0, verbose=None):
+        """
+        Negotiate the binary framed protocol with the MCU.
 
+        Sends "COMM_OK,BIN" (or "COMM_OK,ASCII" to switch back). Once enabled,
+        set_dac, set_all_channels, read_voltage and sweep_onboard exchange
+        CRC-checked frames carrying raw little-endian values instead of text.
 
-class DACController(SerialController):
-    """
-    Controller class for communicating with STM32 MCU to control MCP4728 DAC via UART.
-    """
-    
-    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True):
-        """
-        Initialize the DAC controller.
-        
         Args:
-            port (str): Serial port name (e.g., "COM3", "/dev/ttyUSB0")
-            baud (int): Baud rate (default: 115200)
-            auto_connect (bool): Automatically connect on initialization
-            verbose (bool): Print connection messages
+            enable (bool): True for binary mode, False for ASCII mode
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
+        Returns:
+            bool: True if the MCU confirmed the requested mode
         """
-        super().__init__(port, baud, auto_connect, verbose)
-    
-    def set_dac(self, channel, dac_value, verbose=None, wait_for_response=True, timeout=2.0):
+        if verbose is None:
+            verbose = self.verbose
+
+        mode = "BIN" if enable else "ASCII"
+        self.ser.reset_input_buffer()
+        self.ser.write(f"COMM_OK,{mode}\n".encode())
+        self.ser.flush()
+
+        response = self.wait_for_mcu_response(timeout)
+        if response == f"COMM_OK,{mode}":
+            self.binary = enable
+            if verbose:
+                print(f"  ✓ Protocol mode: {mode}")
+            return True
+
+        if verbose:
+            print(f"  ✗ MCU did not confirm {mode} mode (response: {response})")
+        return False
+
+    def set_i2c_speed(self, bus, speed_hz, timeout=2.0, verbose=None):
         """
-        Set DAC value for a specific channel and wait for MCU acknowledgment.
-        
+        Change the speed of one of the MCU's I2C buses.
+
         Args:
-            channel (int): Channel number (0-3)
-            dac_value (int): DAC code value (0-4095)
-            verbose (bool): Print confirmation message (defaults to self.verbose)
-            wait_for_response (bool): Wait for MCU response/acknowledgment
-            timeout (float): Timeout in seconds when waiting for response
-        
+            bus (int): 1 for the DAC bus (I2C1), 2 for the ADC bus (I2C2)
+            speed_hz (int): Bus speed in Hz (10000-400000)
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
         Returns:
-            tuple: (success: bool, response: str) - success indicates if command was sent,
-                   response contains MCU acknowledgment or None if timeout/error
+            int: SCL frequency the MCU actually configured in Hz, or None if error
         """
         if verbose is None:
             verbose = self.verbose
-        
-        # Validate inputs
-        if channel < 0 or channel > 3:
-            print(f"Error: Channel must be 0-3, got {channel}")
-            return False, None
-        
-        if dac_value < 0 or dac_value > 4095:
-            print(f"Error: DAC value must be 0-4095, got {dac_value}")
-            return False, None
-        
-        # Clear any leftover data in input buffer
+
+        if bus not in (1, 2):
+            print(f"Error: Bus must be 1 (DAC) or 2 (ADC), got {bus}")
+            return None
+        if speed_hz < 10000 or speed_hz > 400000:
+            print(f"Error: Speed must be 10000-400000 Hz, got {speed_hz}")
+            return None
+
         self.ser.reset_input_buffer()
-        
-        # Format: "channel,dac_value"
-        message = f"{channel},{dac_value}\n"
-        self.ser.write(message.encode())
-        self.ser.flush()  # Ensure data is sent immediately
-        
+        self.ser.write(f"i2c_speed,{bus},{speed_hz}\n".encode())
+        self.ser.flush()
+
+        response = self.wait_for_mcu_response(timeout)
+        if response and response.startswith("I2C_SPEED,"):
+            actual = int(response.split(',')[2])
+            if verbose:
+                print(f"  ✓ I2C{bus} running at {actual} Hz")
+            return actual
+
         if verbose:
-            print(f"Sent: Channel {channel} = {dac_value}")
-        
-        # Wait for MCU response
-        if wait_for_response:
-            response = self.wait_for_mcu_response(timeout)
-            if response:
-                if verbose:
-                    print(f"  MCU: {response}")
-                return True, response
-            else:
-                if verbose:
-                    print(f"  Warning: No response from MCU within {timeout}s")
-                return True, None  # Command sent but no response received
-        
-        return True, None
-    
-    def set_voltage(self, channel, voltage, vref=5.0, verbose=None, wait_for_response=True, timeout=2.0):
+            print(f"  ✗ Failed to set I2C{bus} speed: {response}")
+        return None
+
+    def opm_trigger(self, timeout=2.0, verbose=None):
         """
-        Set DAC output voltage for a specific channel by converting voltage to DAC code.
-        
+        Pulse the MCU's optical power meter trigger output (PA10) once.
+
         Args:
-            channel (int): Channel number (0-3)
-            voltage (float): Desired output voltage in Volts (0 to vref)
-            vref (float): Reference voltage in Volts (default: 5.0V for VDD)
-            verbose (bool): Print confirmation message (defaults to self.verbose)
-            wait_for_response (bool): Wait for MCU response/acknowledgment
-            timeout (float): Timeout in seconds when waiting for response
-        
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
         Returns:
-            tuple: (success: bool, response: str) - success indicates if command was sent,
-                   response contains MCU acknowledgment or None if timeout/error
+            bool: True if the pulse was emitted
         """
         if verbose is None:
             verbose = self.verbose
-        
-        # Validate inputs
-        if channel < 0 or channel > 3:
-            print(f"Error: Channel must be 0-3, got {channel}")
-            return False, None
-        
-        if voltage < 0 or voltage > vref:
-            print(f"Error: Voltage must be 0-{vref}V, got {voltage}V")
-            return False, None
-        
-        if vref <= 0:
-            print(f"Error: Reference voltage must be > 0, got {vref}V")
-            return False, None
-        
-        # Convert voltage to DAC code: dac_value = (voltage / vref) * 4095
-        dac_value = int((voltage / vref) * 4095)
-        
-        # Clamp to valid range (0-4095)
-        if dac_value < 0:
-            dac_value = 0
-        elif dac_value > 4095:
-            dac_value = 4095
-        
-        if verbose:
-            print(f"Setting channel {channel} to {voltage:.4f}V (DAC code: {dac_value})")
-        
-        # Call set_dac with the converted value
-        return self.set_dac(channel, dac_value, verbose=False, wait_for_response=wait_for_response, timeout=timeout)
-    
-    def set_all_channels(self, dac_value, verbose=None, wait_for_response=True, timeout=2.0):
+
+        if self.binary:
+            reply = self.transact(PROTO_OP_TRIGGER, b'', timeout, verbose)
+            return reply is not None and reply[0] == 1
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"trig\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response != "1" and verbose:
+            print(f"  ✗ OPM trigger failed: {response}")
+        return response == "1"
+
+    def opm_trigger_async(self):
         """
-        Set all DAC channels to the same value and wait for MCU acknowledgment.
-        
+        Pulse the OPM trigger output without waiting (needs start_async()).
+
+        Returns:
+            Future: Resolves to True once the pulse was emitted
+        """
+        if self.binary:
+            return self.transact_async(PROTO_OP_TRIGGER, b'', parse=lambda reply: reply[0] == 1)
+        return self.command_async("trig", parse=lambda reply: reply == "1")
+
+    def set_opm_trigger(self, per_step, timeout=2.0, verbose=None):
+        """
+        Pulse the OPM trigger on every step of an on-MCU sweep (sweep_onboard).
+
+        The pulse comes after the settle time, right before the ADC conversion.
+
         Args:
-            dac_value (int): DAC code value (0-4095) to set on all channels
-            verbose (bool): Print confirmation message (defaults to self.verbose)
-            wait_for_response (bool): Wait for MCU response/acknowledgment
-            timeout (float): Timeout in seconds when waiting for response
-        
+            per_step (bool): True to pulse on each sweep step, False to disable
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
         Returns:
-            tuple: (success: bool, response: str) - success indicates if command was sent,
-                   response contains MCU acknowledgment or None if timeout/error
+            bool: True if the MCU accepted the setting
         """
         if verbose is None:
             verbose = self.verbose
-        
-        # Validate input
-        if dac_value < 0 or dac_value > 4095:
-            print(f"Error: DAC value must be 0-4095, got {dac_value}")
-            return False, None
-        
-        # Clear any leftover data in input buffer
+
+        if self.binary:
+            reply = self.transact(PROTO_OP_TRIGGER, struct.pack('<B', 1 if per_step else 0), timeout, verbose)
+            return reply is not None and reply[0] == 1
+
         self.ser.reset_input_buffer()
-        
-        # Format: "set_all,dac_value"
-        message = f"set_all,{dac_value}\n"
-        self.ser.write(message.encode())
-        self.ser.flush()  # Ensure data is sent immediately
-        
+        self.ser.write(f"trig_out,{1 if per_step else 0}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
         if verbose:
-            print(f"Sent: All channels = {dac_value}")
-        
-        # Wait for MCU response
-        if wait_for_response:
-            response = self.wait_for_mcu_response(timeout)
-            if response:
-                if verbose:
-                    print(f"  MCU: {response}")
-                return True, response
+            if response == "1":
+                print(f"  ✓ OPM trigger per sweep step {'enabled' if per_step else 'disabled'}")
             else:
-                if verbose:
-                    print(f"  Warning: No response from MCU within {timeout}s")
-                return True, None  # Command sent but no response received
-        
-        return True, None
-    
-    
-    def sweep_channel(self, channel, start_value, end_value, steps, delay=0.1):
+                print(f"  ✗ Failed to configure OPM trigger: {response}")
+        return response == "1"
+
+    def read_mcu_time(self, timeout=2.0, verbose=None):
+        """
+        Read the MCU's free-running TIM2 microsecond counter (wraps every ~71.6 min).
+
+        Args:
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
+        Returns:
+            int: MCU time in microseconds, or None if error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if self.binary:
+            reply = self.transact(PROTO_OP_TIME, b'', timeout, verbose)
+            if reply is None or len(reply) != 4:
+                return None
+            return struct.unpack('<I', reply)[0]
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"time\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response and response.startswith("TIME,"):
+            return int(response[5:])
+        if verbose:
+            print(f"  ✗ Unexpected response from MCU: {response}")
+        return None
+
+    def sync_clock(self, samples=8, timeout=2.0, verbose=None):
+        """
+        Align the MCU time base with the host clock (time.time()).
+
+        Reads the MCU time `samples` times and keeps the exchange with the shortest
+        round trip, taking the MCU reading to belong to its midpoint. From the second
+        sync on, the MCU clock rate is estimated from the two syncs, so
+        mcu_to_host_time() also corrects crystal drift.
+
+        Args:
+            samples (int): Number of exchanges (the fastest one is used)
+            timeout (float): Maximum time to wait for each response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
+        Returns:
+            float: Round trip of the exchange used in seconds (bounds the alignment
+                   error), or None if error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        best = None
+        for _ in range(max(1, samples)):
+            sent = time.time()
+            mcu_us = self.read_mcu_time(timeout, verbose=False)
+            received = time.time()
+            if mcu_us is not None and (best is None or received - sent < best[0]):
+                best = (received - sent, (sent + received) / 2, mcu_us)
+
+        if best is None:
+            if verbose:
+                print("  ✗ Clock sync failed: no response from MCU")
+            return None
+
+        round_trip, host_time, mcu_us = best
+        if self._clock_sync is not None:
+            host_elapsed = host_time - self._clock_sync[0]
+            mcu_elapsed = (mcu_us - self._clock_sync[1]) % (1 << 32)
+            # Only when the interval is long enough to resolve ppm and shorter than a wrap
+            if 10.0 < host_elapsed < 4000.0:
+                self.clock_rate = mcu_elapsed / host_elapsed
+        self._clock_sync = (host_time, mcu_us)
+
+        if verbose:
+            print(f"  ✓ MCU clock synced (round trip {round_trip*1e3:.2f} ms, "
+                  f"rate {(self.clock_rate / 1e6 - 1) * 1e6:+.1f} ppm)")
+        return round_trip
+
+    def mcu_to_host_time(self, t_us):
+        """
+        Convert MCU timestamps (TIM2 microseconds) to host time.time() seconds.
+
+        Uses the last sync_clock(); the 32-bit counter wraps every ~71.6 min, so
+        timestamps must lie within ~35 min of that sync.
+
+        Args:
+            t_us (int or array-like): MCU time(s) in microseconds
+
+        Returns:
+            float or numpy.ndarray: Host time(s) in seconds, or None if never synced
+        """
+        if self._clock_sync is None:
+            print("Error: Call sync_clock() before converting MCU timestamps")
+            return None
+
+        host_time, mcu_us = self._clock_sync
+        delta = (np.asarray(t_us, dtype=np.int64) - mcu_us) % (1 << 32)
+        delta = np.where(delta >= (1 << 31), delta - (1 << 32), delta)
+        host = host_time + delta / self.clock_rate
+        return float(host) if np.ndim(host) == 0 else host
+
+    def enable_timestamps(self, enable=True, timeout=2.0, verbose=None):
+        """
+        Have the MCU timestamp every reading, sweep point, stream block and waveform.
+
+        Timestamps are TIM2 microseconds taken when the conversion started. Enabling
+        also runs sync_clock(), so they can be converted with mcu_to_host_time().
+        The latest one is kept in self.last_timestamp; sweep_onboard() returns them
+        under 'times', stream() in self.last_block_times and wave_play() as 'start_us'.
+
+        Args:
+            enable (bool): True to append timestamps, False to disable
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print status messages (defaults to self.verbose)
+
+        Returns:
+            bool: True if the MCU accepted the setting
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if self.binary:
+            reply = self.transact(PROTO_OP_TIME, struct.pack('<B', 1 if enable else 0), timeout, verbose)
+            ok = reply is not None and len(reply) == 4
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"timestamps,{1 if enable else 0}\n".encode())
+            self.ser.flush()
+            ok = self.wait_for_mcu_response(timeout) == "1"
+
+        if not ok:
+            if verbose:
+                print("  ✗ MCU did not accept the timestamp setting")
+            return False
+
+        self.timestamps = enable
+        if verbose:
+            print(f"  ✓ Timestamps {'enabled' if enable else 'disabled'}")
+        if enable:
+            self.sync_clock(verbose=verbose)
+        return True
+
+    def get_stats(self, reset=False, timeout=2.0, verbose=None):
+        """
+        Read the firmware's profiling statistics.
+
+        The MCU times its hot paths with the DWT cycle counter: blocking DAC and ADC
+        I2C transfers, conversion waits, command handling and reply queueing. It
+        also counts I2C errors, conversion timeouts and dropped input.
+
+        Args:
+            reset (bool): Clear the statistics after reading them
+            timeout (float): Maximum time to wait for response in seconds
+            verbose (bool): Print a summary table (defaults to self.verbose)
+
+        Returns:
+            dict: {'core_hz', 'uptime_s',
+                   'timers': {name: {'count', 'min_us', 'mean_us', 'max_us',
+                                     'histogram'}},
+                   'counters': {name: count}}, or None if error.
+                  histogram[n] counts durations of 2^(n-1) to 2^n - 1 us (n = 0: < 1 us).
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        raw_timers = {}
+        counters = {}
+
+        if self.binary:
+            reply = self.transact(PROTO_OP_STATS, struct.pack('<B', 1 if reset else 0), timeout, verbose)
+            if reply is None or len(reply) < 10:
+                return None
+            core_hz, uptime_ms, n_timers, n_counters = struct.unpack('<IIBB', reply[:10])
+            offset = 10
+            entry = struct.Struct(f'<IIIQ{STATS_HIST_BUCKETS}I')
+            if len(reply) != offset + n_timers * entry.size + n_counters * 4:
+                return None
+            for i in range(n_timers):
+                fields = entry.unpack_from(reply, offset)
+                offset += entry.size
+                count, lo, hi, total = fields[:4]
+                name = STATS_TIMERS[i] if i < len(STATS_TIMERS) else f'timer{i}'
+                raw_timers[name] = (count, lo, total // count if count else 0, hi, list(fields[4:]))
+            for i, value in enumerate(struct.unpack_from(f'<{n_counters}I', reply, offset)):
+                counters[STATS_COUNTERS[i] if i < len(STATS_COUNTERS) else f'counter{i}'] = value
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"stats{',1' if reset else ''}\n".encode())
+            self.ser.flush()
+
+            header = self.wait_for_mcu_response(timeout)
+            if not header or not header.startswith("STATS,"):
+                if verbose:
+                    print(f"  ✗ Unexpected response from MCU: {header}")
+                return None
+            core_hz, uptime_ms = (int(v) for v in header.split(',')[1:3])
+
+            while True:
+                line = self.wait_for_mcu_response(timeout)
+                if line is None:
+                    if verbose:
+                        print("  ✗ Statistics truncated")
+                    return None
+                if line == "END":
+                    break
+                fields = line.split(',')
+                if fields[0] == 'T' and len(fields) == 6 + STATS_HIST_BUCKETS:
+                    values = [int(v) for v in fields[2:]]
+                    raw_timers[fields[1]] = (*values[:4], values[4:])
+                elif fields[0] == 'C' and len(fields) == 3:
+                    counters[fields[1]] = int(fields[2])
+
+        cycles_per_us = core_hz / 1e6
+        timers = {}
+        for name, (count, lo, mean, hi, histogram) in raw_timers.items():
+            timers[name] = {'count': count, 'min_us': lo / cycles_per_us,
+                            'mean_us': mean / cycles_per_us, 'max_us': hi / cycles_per_us,
+                            'histogram': histogram}
+
+        if verbose:
+            print(f"  MCU stats ({core_hz / 1e6:.0f} MHz core, up {uptime_ms / 1000:.1f} s)")
+            for name, t in timers.items():
+                print(f"    {name:<9} n={t['count']:<8} min {t['min_us']:9.1f} µs  "
+                      f"mean {t['mean_us']:9.1f} µs  max {t['max_us']:9.1f} µs")
+            for name, value in counters.items():
+                print(f"    {name:<15} {value}")
+
+        return {'core_hz': core_hz, 'uptime_s': uptime_ms / 1000.0,
+                'timers': timers, 'counters': counters}
+
+    def _cal_command(self, command, timeout, verbose, action):
+        """Send a cal_* command that replies "1"; report failures."""
+        self.ser.reset_input_buffer()
+        self.ser.write(f"{command}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response != "1" and verbose:
+            print(f"  ✗ Failed to {action}: {response}")
+        return response == "1"
+
+    def set_calibration(self, target, channel, gain=1.0, offset=0, verbose=None, timeout=2.0):
+        """
+        Set a linear on-MCU calibration for one channel (replaces its table).
+
+        The MCU applies it in integer math to every conversion or DAC write, so
+        voltages, currents, sweeps and streams arrive corrected. ADC entries map
+        the raw code (read_adc_raw) to the code an ideal ADS1115 would return;
+        DAC entries map the requested code to the code that produces it.
+        Changes live in RAM until save_calibration().
+
+        Args:
+            target (str): 'adc' or 'dac'
+            channel (int): Channel number (0-3)
+            gain (float): Output codes per input code (0 < gain <= 4)
+            offset (int): Codes added after the gain
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+
+        Returns:
+            bool: True if the MCU accepted the calibration
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if target not in ('adc', 'dac'):
+            print(f"Error: Target must be 'adc' or 'dac', got {target}")
+            return False
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        if not (0 < gain <= 4):
+            print(f"Error: Gain must be in (0, 4], got {gain}")
+            return False
+
+        return self._cal_command(f"cal_set,{target},{channel},{int(round(gain * 65536))},{int(round(offset))}",
+                                 timeout, verbose, f"set {target} ch{channel} calibration")
+
+    def set_calibration_table(self, target, channel, points, verbose=None, timeout=2.0):
+        """
+        Set a piecewise-linear on-MCU calibration table for one channel.
+
+        Args:
+            target (str): 'adc' or 'dac'
+            channel (int): Channel number (0-3)
+            points (list): 2-8 (input_code, output_code) pairs, both strictly ascending;
+                           codes outside the table extrapolate from its end segments
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for each response
+
+        Returns:
+            bool: True if every point was accepted
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if target not in ('adc', 'dac'):
+            print(f"Error: Target must be 'adc' or 'dac', got {target}")
+            return False
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        if not (2 <= len(points) <= 8):
+            print(f"Error: Table needs 2-8 points, got {len(points)}")
+            return False
+
+        for index, (code_in, code_out) in enumerate(points):
+            if not self._cal_command(f"cal_pt,{target},{channel},{index},{int(code_in)},{int(code_out)}",
+                                     timeout, verbose, f"set {target} ch{channel} point {index}"):
+                return False
+        if verbose:
+            print(f"  ✓ {target.upper()} ch{channel} calibration table: {len(points)} points")
+        return True
+
+    def get_calibration(self, target, channel, verbose=None, timeout=2.0):
+        """
+        Read one channel's on-MCU calibration.
+
+        Returns:
+            dict: {'gain', 'offset', 'points': [(in, out), ...]}, or None on error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        self.ser.write(f"cal_get,{target},{channel}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        try:
+            fields = response.split(',')
+            values = [int(v) for v in fields[3:]]
+            if fields[0] != "CAL" or len(values) != 3 + 2 * values[2]:
+                raise ValueError
+        except (AttributeError, ValueError, IndexError):
+            if verbose:
+                print(f"  ✗ Invalid calibration reply: {response}")
+            return None
+
+        table = values[3:]
+        return {'gain': values[0] / 65536.0, 'offset': values[1],
+                'points': list(zip(table[0::2], table[1::2]))}
+
+    def save_calibration(self, verbose=None, timeout=5.0):
+        """
+        Store the MCU's calibration in flash (loaded again at every boot).
+
+        The flash erase takes up to ~2 s; the MCU refuses while a constant-current
+        loop or current limit is active.
+        """
+        if verbose is None:
+            verbose = self.verbose
+        ok = self._cal_command("cal_save", timeout, verbose, "save calibration")
+        if ok and verbose:
+            print("  ✓ Calibration saved to flash")
+        return ok
+
+    def load_calibration(self, verbose=None, timeout=2.0):
+        """Discard unsaved calibration changes and reload the flash copy."""
+        if verbose is None:
+            verbose = self.verbose
+        return self._cal_command("cal_load", timeout, verbose, "load calibration (none stored?)")
+
+    def clear_calibration(self, verbose=None, timeout=2.0):
+        """Reset every channel to identity (flash keeps its copy until save_calibration())."""
+        if verbose is None:
+            verbose = self.verbose
+        return self._cal_command("cal_clear", timeout, verbose, "clear calibration")
+
+    def _next_seq(self):
+        """Allocate the next 8-bit sequence number (shared by binary frames and ASCII tags)."""
+        seq = self._seq
+        self._seq = (self._seq + 1) & 0xFF
+        return seq
+
+    def send_frame(self, opcode, payload=b'', seq=None):
+        """
+        Send a binary protocol frame.
+
+        Args:
+            opcode (int): Request opcode
+            payload (bytes): Request payload
+            seq (int): Sequence number to use (default: next free one)
+
+        Returns:
+            int: Sequence number used for the frame
+        """
+        if seq is None:
+            seq = self._next_seq()
+
+        body = struct.pack('<BBH', opcode, seq, len(payload)) + payload
+        frame = PROTO_SYNC + body + struct.pack('<H', crc16_ccitt(body))
+        self.ser.write(frame)
+        self.ser.flush()
+        return seq
+
+    def _read_exact(self, size, deadline):
+        """Read exactly size bytes before deadline, or return None."""
+        data = bytearray()
+        while len(data) < size:
+            if time.time() > deadline:
+                return None
+            chunk = self.ser.read(size - len(data))
+            if chunk:
+                data.extend(chunk)
+        return bytes(data)
+
+    def read_frame(self, timeout=2.0, sync_timeout=None):
+        """
+        Read one binary protocol frame.
+
+        Unsolicited PROTO_OP_EVENT frames (current limit trips) are recorded in
+        self.trips and skipped.
+
+        Args:
+            timeout (float): Maximum time to wait for the complete frame in seconds
+            sync_timeout (float): If given, only wait this long for the sync bytes; once
+                they arrive the rest of the frame gets timeout plus its transfer time and
+                a frame cut short or failing its CRC raises FrameError instead of
+                returning None
+
+        Returns:
+            tuple: (opcode, seq, payload) or None on timeout/CRC error
+        """
+        deadline = time.time() + (timeout if sync_timeout is None else sync_timeout)
+
+        while True:
+            # Hunt for the sync bytes
+            previous = b''
+            while True:
+                byte = self._read_exact(1, deadline)
+                if byte is None:
+                    return None
+                if previous + byte == PROTO_SYNC:
+                    break
+                previous = byte
+                # A frame may have started, do not cut it off between its sync bytes
+                if sync_timeout is not None and byte == PROTO_SYNC[:1]:
+                    deadline = time.time() + timeout
+
+            if sync_timeout is not None:
+                deadline = time.time() + timeout
+            header = self._read_exact(4, deadline)
+            if header is None:
+                if sync_timeout is not None:
+                    raise FrameError("Frame header timed out")
+                return None
+            opcode, seq, length = struct.unpack('<BBH', header)
+
+            if sync_timeout is not None:
+                deadline += (length + 2) * 10 / self.baud
+            rest = self._read_exact(length + 2, deadline)
+            if rest is None:
+                if sync_timeout is not None:
+                    raise FrameError(f"Frame with seq {seq} timed out after the header", seq)
+                return None
+            payload, crc = rest[:length], struct.unpack('<H', rest[length:])[0]
+
+            if crc16_ccitt(header + payload) != crc:
+                if sync_timeout is not None:
+                    raise FrameError(f"Frame with seq {seq} failed its CRC", seq)
+                return None
+            if opcode == (PROTO_OP_EVENT | PROTO_REPLY_FLAG) and len(payload) >= 4:
+                if payload[0] == PROTO_EVENT_LIMIT_TRIP:
+                    self._record_trip(payload[1], struct.unpack('<h', payload[2:4])[0])
+                continue
+            return opcode, seq, payload
+
+    def transact(self, opcode, payload=b'', timeout=2.0, verbose=None):
+        """
+        Send a binary request and wait for its reply.
+
+        Returns:
+            bytes: Reply payload, or None on timeout, CRC or MCU-reported error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        seq = self.send_frame(opcode, payload)
+
+        frame = self.read_frame(timeout)
+        if frame is None:
+            if verbose:
+                print(f"  Warning: No valid reply to opcode 0x{opcode:02X} within {timeout}s")
+            return None
+
+        reply_opcode, reply_seq, reply_payload = frame
+        if reply_opcode == (PROTO_OP_ERROR | PROTO_REPLY_FLAG):
+            if verbose:
+                error = PROTO_ERRORS.get(reply_payload[1], reply_payload[1]) if len(reply_payload) > 1 else "?"
+                print(f"  ✗ MCU error for opcode 0x{opcode:02X}: {error}")
+            return None
+        if reply_opcode != (opcode | PROTO_REPLY_FLAG) or reply_seq != seq:
+            if verbose:
+                print(f"  ✗ Mismatched reply (opcode 0x{reply_opcode:02X}, seq {reply_seq})")
+            return None
+        return reply_payload
+
+    @property
+    def async_active(self):
+        """True while the background reader started by start_async() is running."""
+        return self._reader is not None
+
+    def start_async(self):
+        """
+        Start the background reader so commands can be pipelined.
+
+        While it runs, replies are matched to requests by sequence number: ASCII
+        commands are sent as "#<seq>:<command>" and the MCU tags every reply line
+        the same way, binary frames already carry seq. Use the *_async methods
+        (or command_async / transact_async) in this mode; the blocking methods
+        read the port themselves and must not be mixed in until stop_async().
+
+        Returns:
+            bool: True if the reader is running
+        """
+        if self._reader is not None:
+            return True
+        if self.ser is None or not self.ser.is_open:
+            print("Error: Serial port is not open")
+            return False
+
+        self._reader_timeout = self.ser.timeout
+        self.ser.timeout = 0.05         # Bounds how long stop_async() waits for the reader
+        self.ser.reset_input_buffer()
+        self._reader_stop.clear()
+        self._reader = threading.Thread(target=self._reader_loop, name=f"{self.port}-reader", daemon=True)
+        self._reader.start()
+        return True
+
+    def stop_async(self):
+        """
+        Stop the background reader; commands still in flight resolve to None.
+        """
+        if self._reader is None:
+            return
+        self._reader_stop.set()
+        self._reader.join()
+        self._reader = None
+        self.ser.timeout = self._reader_timeout
+
+        with self._pending_lock:
+            pending, self._pending = self._pending, {}
+        for future, _ in pending.values():
+            if not future.done():
+                future.set_result(None)
+
+    def _reader_loop(self):
+        """Reader thread: route tagged ASCII lines and binary frames to their futures."""
+        line = bytearray()
+        while not self._reader_stop.is_set():
+            try:
+                if self.binary:
+                    try:
+                        frame = self.read_frame(ASYNC_FRAME_TIMEOUT, sync_timeout=ASYNC_SYNC_TIMEOUT)
+                    except FrameError as e:
+                        self._fail(e)
+                        continue
+                    if frame is not None:
+                        opcode, seq, payload = frame
+                        if opcode == (PROTO_OP_ERROR | PROTO_REPLY_FLAG):
+                            payload = None
+                        self._resolve(seq, payload)
+                    continue
+
+                chunk = self.ser.read(max(1, self.ser.in_waiting))
+            except serial.SerialException:
+                break
+            for byte in chunk:
+                if byte != 0x0A:
+                    line.append(byte)
+                    continue
+                self._dispatch_line(line.decode(errors='replace').strip())
+                line.clear()
+
+    def _dispatch_line(self, line):
+        """Resolve the future of a "#<seq>:<reply>" line; untagged lines are dropped."""
+        if self._take_trip_line(line):
+            return
+        if not line.startswith('#') or ':' not in line:
+            if line and self.verbose:
+                print(f"  Warning: Untagged reply while pipelining: '{line}'")
+            return
+        tag, reply = line[1:].split(':', 1)
+        if tag.isdigit():
+            self._resolve(int(tag), reply)
+
+    def _resolve(self, seq, reply):
+        """Complete the pending request with this seq, applying its parse function."""
+        with self._pending_lock:
+            entry = self._pending.pop(seq, None)
+        if entry is None:
+            return
+        future, parse = entry
+        try:
+            result = parse(reply) if (parse is not None and reply is not None) else reply
+        except (ValueError, IndexError, struct.error):
+            result = None
+        future.set_result(result)
+
+    def _fail(self, error):
+        """
+        Fail the request a lost or corrupt frame belonged to with error.
+
+        The MCU answers in order, so a frame whose seq is unknown (or not in
+        flight, as a corrupt header may report) is taken to be the oldest reply owed.
+        """
+        with self._pending_lock:
+            seq = error.seq if error.seq in self._pending else next(iter(self._pending), None)
+            entry = self._pending.pop(seq, None)
+        if entry is None:
+            if self.verbose:
+                print(f"  Warning: {error} while pipelining")
+            return
+        entry[0].set_exception(error)
+
+    def _submit(self, command, opcode=None, payload=b'', parse=None):
+        """Register a Future for the next seq, then send the request with that seq."""
+        if self._reader is None:
+            raise RuntimeError("start_async() must be called before sending async commands")
+
+        future = Future()
+        with self._pending_lock:
+            seq = self._next_seq()
+            self._pending[seq] = (future, parse)
+
+        if opcode is not None:
+            self.send_frame(opcode, payload, seq)
+        else:
+            self.ser.write(f"#{seq}:{command}\n".encode())
+            self.ser.flush()
+        return future
+
+    def command_async(self, command, parse=None):
+        """
+        Send an ASCII command without waiting for its reply.
+
+        Only single-line replies are supported; block replies (sweep, stream,
+        wave_play, ...) need the blocking methods.
+
+        Args:
+            command (str): Command line without the newline, e.g. "read_adc,0"
+            parse (callable): Optional conversion applied to the reply line
+
+        Returns:
+            Future: Resolves to the reply line (or parse(line)), None if parsing failed
+        """
+        return self._submit(command, parse=parse)
+
+    def transact_async(self, opcode, payload=b'', parse=None):
+        """
+        Send a binary request without waiting for its reply.
+
+        Args:
+            opcode (int): Request opcode
+            payload (bytes): Request payload
+            parse (callable): Optional conversion applied to the reply payload
+
+        Returns:
+            Future: Resolves to the reply payload (or parse(payload)), None on MCU error;
+                raises FrameError if the reply frame was cut short or failed its CRC
+        """
+        return self._submit(None, opcode, payload, parse)
+
+    def sweep_onboard(self, dac_channel, adc_channel, start_value, end_value, steps,
+                      settle_us=1000, verbose=None, timeout=None, settle_tolerance=None,
+                      max_settle_us=200000):
+        """
+        Run a DAC sweep with ADC capture entirely on the MCU.
+
+        The firmware steps the DAC, waits settle_us, takes one ADC conversion per
+        point and sends all results back in a single block, so the sweep costs one
+        serial exchange instead of two round trips per point.
+
+        With settle_tolerance the settle time adapts per point: after settle_us the
+        MCU takes fast readings until consecutive ones agree within the tolerance
+        (or max_settle_us has passed), then converts the point as usual. Fast
+        points no longer wait for the worst case.
+
+        Args:
+            dac_channel (int): DAC channel to sweep (0-3)
+            adc_channel (int): ADC channel to measure (0-3)
+            start_value (int): Starting DAC value (0-4095)
+            end_value (int): Ending DAC value (0-4095)
+            steps (int): Number of points (1-4096)
+            settle_us (int): Settle time after each DAC step in microseconds (0-5000000)
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Time to wait for the sweep to finish in seconds
+                             (default: estimated from steps and settle_us)
+            settle_tolerance (float): Largest change between settled readings in Volts,
+                                      None for a fixed settle_us per point
+            max_settle_us (int): Adaptive settle cap per point in microseconds (settle_us-5000000)
+
+        Returns:
+            dict: {'dac_values': [...], 'voltages': [...]}, plus 'times' (MCU us at each
+                  conversion, 0 where not measured) with timestamps on, plus
+                  'settle_us' (time from DAC write to conversion, >= max_settle_us if the
+                  point never settled) with settle_tolerance, or None on error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        # Validate inputs
+        if not (0 <= dac_channel <= 3 and 0 <= adc_channel <= 3):
+            print(f"Error: Channels must be 0-3, got DAC {dac_channel}, ADC {adc_channel}")
+            return None
+
+        if not (0 <= start_value <= 4095 and 0 <= end_value <= 4095):
+            print(f"Error: DAC values must be 0-4095")
+            return None
+
+        if steps < 1 or steps > 4096:
+            print(f"Error: Steps must be 1-4096, got {steps}")
+            return None
+
+        if settle_us < 0 or settle_us > 5000000:
+            print(f"Error: Settle time must be 0-5000000 us, got {settle_us}")
+            return None
+
+        adaptive = settle_tolerance is not None
+        if adaptive:
+            tolerance_codes = max(1, int(round(settle_tolerance / ADC_LSB_VOLTS)))
+            if settle_tolerance <= 0 or tolerance_codes > 32767:
+                print(f"Error: Settle tolerance must be > 0 and <= 6.144 V, got {settle_tolerance}")
+                return None
+            if max_settle_us < 1 or max_settle_us > 5000000:
+                print(f"Error: Max settle time must be 1-5000000 us, got {max_settle_us}")
+                return None
+            if max_settle_us < settle_us:
+                print(f"Error: Max settle time ({max_settle_us} us) is below settle_us ({settle_us} us)")
+                return None
+
+        if timeout is None:
+            # Settle time (worst case when adaptive) plus ~20ms per conversion, plus some margin
+            settle_s = max(settle_us, max_settle_us) / 1e6 if adaptive else settle_us / 1e6
+            timeout = steps * (settle_s + 0.02) + 2.0
+
+        if self.binary:
+            payload = struct.pack('<BBHHHI', dac_channel, adc_channel, start_value,
+                                  end_value, steps, int(settle_us))
+            if adaptive:
+                payload += struct.pack('<HI', tolerance_codes, int(max_settle_us))
+            reply = self.transact(PROTO_OP_SWEEP, payload, timeout, verbose)
+            point_size = 2 + (4 if self.timestamps else 0) + (4 if adaptive else 0)
+            if reply is None or len(reply) != steps * point_size:
+                return None
+            codes = np.frombuffer(reply, dtype='<i2', count=steps)
+            # Same integer interpolation as the firmware (C division truncates toward zero)
+            index = np.arange(steps)
+            span = end_value - start_value
+            dac_values = start_value + (np.fix(span * index / (steps - 1)).astype(int) if steps > 1 else 0 * index)
+            voltages = adc_codes_to_volts(codes)
+            voltages[codes == -32768] = np.nan  # Not measured (current limit trip, DAC/ADC I2C error)
+            result = {'dac_values': dac_values.tolist(), 'voltages': voltages.tolist()}
+            if self.timestamps:
+                result['times'] = np.frombuffer(reply, dtype='<u4', offset=2 * steps, count=steps).tolist()
+            if adaptive:
+                result['settle_us'] = np.frombuffer(reply, dtype='<u4', offset=len(reply) - 4 * steps).tolist()
+            return result
+
+        # Clear any leftover data in input buffer
+        self.ser.reset_input_buffer()
+
+        # Format: "sweep,dac_ch,adc_ch,start,stop,steps,settle_us[,tol,max_us]"
+        message = f"sweep,{dac_channel},{adc_channel},{start_value},{end_value},{steps},{int(settle_us)}"
+        if adaptive:
+            message += f",{tolerance_codes},{int(max_settle_us)}"
+        message += "\n"
+        self.ser.write(message.encode())
+        self.ser.flush()
+
+        if verbose:
+            print(f"Sweeping DAC ch{dac_channel} {start_value} → {end_value} ({steps} steps) "
+                  f"on the MCU, reading ADC ch{adc_channel}...")
+
+        # Header arrives once the whole sweep has run
+        header = self.wait_for_mcu_response(timeout)
+        if not header or not header.startswith("SWEEP,"):
+            if verbose:
+                print(f"  ✗ Unexpected response from MCU: {header}")
+            return None
+
+        count = int(header.split(',')[1])
+        dac_values = []
+        voltages = []
+        times = []
+        settle_times = []
+
+        while True:
+            line = self.wait_for_mcu_response(2.0)
+            if line is None:
+                if verbose:
+                    print(f"  ✗ Sweep data truncated after {len(voltages)}/{count} points")
+                return None
+            if line == "END":
+                break
+            try:
+                fields = line.split(',')
+                if len(fields) != 2 + self.timestamps + adaptive:
+                    raise ValueError(line)
+                if adaptive:
+                    settle_times.append(int(fields.pop()))
+                if self.timestamps:
+                    times.append(int(fields.pop()))
+                dac_str, voltage_str = fields
+                dac_values.append(int(dac_str))
+                voltages.append(float(voltage_str))
+            except ValueError:
+                if verbose:
+                    print(f"  Warning: Skipping invalid sweep line '{line}'")
+
+        if verbose:
+            print(f"  ✓ Received {len(voltages)}/{count} points")
+
+        result = {'dac_values': dac_values, 'voltages': voltages}
+        if self.timestamps:
+            result['times'] = times
+        if adaptive:
+            result['settle_us'] = settle_times
+        return result
+
+    def close(self):
+        """Close the serial connection."""
+        self.stop_async()
+        if self.ser and self.ser.is_open:
+            self.ser.close()
+            if self.verbose:
+                print("Serial connection closed.")
+    
+    def __enter__(self):
+        """Context manager entry."""
+        return self
+    
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        """Context manager exit - automatically close connection."""
+        self.close()
+
+
+class DACController(SerialController):
+    """
+    Controller class for communicating with STM32 MCU to control MCP4728 DAC via UART.
+    """
+    
+    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True, **kwargs):
+        """
+        Initialize the DAC controller.
+        
+        Args:
+            port (str): Serial port name (e.g., "COM3", "/dev/ttyUSB0")
+            baud (int): Baud rate (default: 115200)
+            auto_connect (bool): Automatically connect on initialization
+            verbose (bool): Print connection messages
+            **kwargs: Passed on to SerialController (e.g. dtr_reset)
+        """
+        super().__init__(port, baud, auto_connect, verbose, **kwargs)
+        self.wave_lengths = [0, 0, 0, 0]  # Waveform table length per channel on the MCU
+    
+    def set_dac(self, channel, dac_value, verbose=None, wait_for_response=True, timeout=2.0):
+        """
+        Set DAC value for a specific channel and wait for MCU acknowledgment.
+        
+        Args:
+            channel (int): Channel number (0-3)
+            dac_value (int): DAC code value (0-4095)
+            verbose (bool): Print confirmation message (defaults to self.verbose)
+            wait_for_response (bool): Wait for MCU response/acknowledgment
+            timeout (float): Timeout in seconds when waiting for response
+        
+        Returns:
+            tuple: (success: bool, response: str) - success indicates if command was sent,
+                   response contains MCU acknowledgment or None if timeout/error
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        # Validate inputs
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False, None
+        
+        if dac_value < 0 or dac_value > 4095:
+            print(f"Error: DAC value must be 0-4095, got {dac_value}")
+            return False, None
+        
+        if self.binary:
+            if not wait_for_response:
+                self.send_frame(PROTO_OP_SET_DAC, struct.pack('<BH', channel, dac_value))
+                return True, None
+            reply = self.transact(PROTO_OP_SET_DAC, struct.pack('<BH', channel, dac_value), timeout, verbose)
+            return True, (str(reply[0]) if reply else None)
+        
+        # Clear any leftover data in input buffer
+        self.ser.reset_input_buffer()
+        
+        # Format: "channel,dac_value"
+        message = f"{channel},{dac_value}\n"
+        self.ser.write(message.encode())
+        self.ser.flush()  # Ensure data is sent immediately
+        
+        if verbose:
+            print(f"Sent: Channel {channel} = {dac_value}")
+        
+        # Wait for MCU response
+        if wait_for_response:
+            response = self.wait_for_mcu_response(timeout)
+            if response:
+                if verbose:
+                    print(f"  MCU: {response}")
+                return True, response
+            else:
+                if verbose:
+                    print(f"  Warning: No response from MCU within {timeout}s")
+                return True, None  # Command sent but no response received
+        
+        return True, None
+    
+    def set_dac_async(self, channel, dac_value):
+        """
+        Set a DAC channel without waiting for the acknowledgment (needs start_async()).
+
+        Args:
+            channel (int): Channel number (0-3)
+            dac_value (int): DAC code value (0-4095)
+
+        Returns:
+            Future: Resolves to True if the MCU acknowledged the write, False if it
+                    reported a failure, None on error; None instead of a Future if
+                    the arguments are invalid
+        """
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return None
+        if dac_value < 0 or dac_value > 4095:
+            print(f"Error: DAC value must be 0-4095, got {dac_value}")
+            return None
+
+        if self.binary:
+            return self.transact_async(PROTO_OP_SET_DAC, struct.pack('<BH', channel, dac_value),
+                                       parse=lambda reply: reply[0] == 1)
+        return self.command_async(f"{channel},{dac_value}", parse=lambda reply: reply == "1")
+    
+    def set_voltage(self, channel, voltage, vref=5.0, verbose=None, wait_for_response=True, timeout=2.0):
+        """
+        Set DAC output voltage for a specific channel by converting voltage to DAC code.
+        
+        Args:
+            channel (int): Channel number (0-3)
+            voltage (float): Desired output voltage in Volts (0 to vref)
+            vref (float): Reference voltage in Volts (default: 5.0V for VDD)
+            verbose (bool): Print confirmation message (defaults to self.verbose)
+            wait_for_response (bool): Wait for MCU response/acknowledgment
+            timeout (float): Timeout in seconds when waiting for response
+        
+        Returns:
+            tuple: (success: bool, response: str) - success indicates if command was sent,
+                   response contains MCU acknowledgment or None if timeout/error
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        # Validate inputs
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False, None
+        
+        if voltage < 0 or voltage > vref:
+            print(f"Error: Voltage must be 0-{vref}V, got {voltage}V")
+            return False, None
+        
+        if vref <= 0:
+            print(f"Error: Reference voltage must be > 0, got {vref}V")
+            return False, None
+        
+        # Convert voltage to DAC code: dac_value = (voltage / vref) * 4095; the MCU's
+        # DAC calibration (set_calibration('dac', ...)) corrects the code it writes
+        dac_value = int((voltage / vref) * 4095)
+        
+        # Clamp to valid range (0-4095)
+        if dac_value < 0:
+            dac_value = 0
+        elif dac_value > 4095:
+            dac_value = 4095
+        
+        if verbose:
+            print(f"Setting channel {channel} to {voltage:.4f}V (DAC code: {dac_value})")
+        
+        # Call set_dac with the converted value
+        return self.set_dac(channel, dac_value, verbose=False, wait_for_response=wait_for_response, timeout=timeout)
+    
+    def set_all_channels(self, dac_value, verbose=None, wait_for_response=True, timeout=2.0):
+        """
+        Set all DAC channels to the same value and wait for MCU acknowledgment.
+        
+        Args:
+            dac_value (int): DAC code value (0-4095) to set on all channels
+            verbose (bool): Print confirmation message (defaults to self.verbose)
+            wait_for_response (bool): Wait for MCU response/acknowledgment
+            timeout (float): Timeout in seconds when waiting for response
+        
+        Returns:
+            tuple: (success: bool, response: str) - success indicates if command was sent,
+                   response contains MCU acknowledgment or None if timeout/error
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        # Validate input
+        if dac_value < 0 or dac_value > 4095:
+            print(f"Error: DAC value must be 0-4095, got {dac_value}")
+            return False, None
+        
+        if self.binary:
+            if not wait_for_response:
+                self.send_frame(PROTO_OP_SET_ALL, struct.pack('<H', dac_value))
+                return True, None
+            reply = self.transact(PROTO_OP_SET_ALL, struct.pack('<H', dac_value), timeout, verbose)
+            return True, (str(reply[0]) if reply else None)
+        
+        # Clear any leftover data in input buffer
+        self.ser.reset_input_buffer()
+        
+        # Format: "set_all,dac_value"
+        message = f"set_all,{dac_value}\n"
+        self.ser.write(message.encode())
+        self.ser.flush()  # Ensure data is sent immediately
+        
+        if verbose:
+            print(f"Sent: All channels = {dac_value}")
+        
+        # Wait for MCU response
+        if wait_for_response:
+            response = self.wait_for_mcu_response(timeout)
+            if response:
+                if verbose:
+                    print(f"  MCU: {response}")
+                return True, response
+            else:
+                if verbose:
+                    print(f"  Warning: No response from MCU within {timeout}s")
+                return True, None  # Command sent but no response received
+        
+        return True, None
+    
+    def set_multi(self, dac_values, verbose=None, wait_for_response=True, timeout=2.0):
+        """
+        Set several DAC channels so that all outputs change at the same instant.
+        
+        The MCU stages every given value in the DAC input registers and then latches
+        them together (LDAC pulse or software update general call), so there is no
+        skew between channels.
+        
+        Args:
+            dac_values (list): Four DAC code values (0-4095) [ch0, ch1, ch2, ch3];
+                               None leaves that channel unchanged
+            verbose (bool): Print confirmation message (defaults to self.verbose)
+            wait_for_response (bool): Wait for MCU response/acknowledgment
+            timeout (float): Timeout in seconds when waiting for response
+        
+        Returns:
+            tuple: (success: bool, response: str) - success indicates if command was sent,
+                   response contains MCU acknowledgment or None if timeout/error
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        # Validate input
+        if len(dac_values) != 4:
+            print(f"Error: dac_values must have 4 elements, got {len(dac_values)}")
+            return False, None
+        for value in dac_values:
+            if value is not None and (value < 0 or value > 4095):
+                print(f"Error: DAC value must be 0-4095, got {value}")
+                return False, None
+        if all(value is None for value in dac_values):
+            print("Error: At least one DAC value must be given")
+            return False, None
+        
+        if self.binary:
+            mask = sum(1 << ch for ch, value in enumerate(dac_values) if value is not None)
+            payload = struct.pack('<B4H', mask, *[value or 0 for value in dac_values])
+            if not wait_for_response:
+                self.send_frame(PROTO_OP_SET_MULTI, payload)
+                return True, None
+            reply = self.transact(PROTO_OP_SET_MULTI, payload, timeout, verbose)
+            return True, (str(reply[0]) if reply else None)
+        
+        # Clear any leftover data in input buffer
+        self.ser.reset_input_buffer()
+        
+        # Format: "set_multi,v0,v1,v2,v3" with "-" for unchanged channels
+        fields = ",".join("-" if value is None else str(int(value)) for value in dac_values)
+        message = f"set_multi,{fields}\n"
+        self.ser.write(message.encode())
+        self.ser.flush()  # Ensure data is sent immediately
+        
+        if verbose:
+            print(f"Sent: Channels = {fields}")
+        
+        # Wait for MCU response
+        if wait_for_response:
+            response = self.wait_for_mcu_response(timeout)
+            if response:
+                if verbose:
+                    print(f"  MCU: {response}")
+                return True, response
+            else:
+                if verbose:
+                    print(f"  Warning: No response from MCU within {timeout}s")
+                return True, None  # Command sent but no response received
+        
+        return True, None
+    
+    def sweep_channel(self, channel, start_value, end_value, steps, delay=0.1):
         """
         Sweep a DAC channel from start_value to end_value.
         
@@ -412,6 +1688,169 @@ class DACController(SerialController):
         self.sweep_channel(channel, start_value, end_value, steps, delay)
         self.sweep_channel(channel, end_value, start_value, steps, delay)
         
+    def wave_load(self, channel, codes, verbose=None, timeout=2.0):
+        """
+        Upload a waveform table of DAC codes for one channel into MCU RAM.
+        
+        Tables are played back by wave_play(). Uploading replaces the channel's
+        previous table; an empty list clears it.
+        
+        Args:
+            channel (int): Channel number (0-3)
+            codes (list): DAC code values (0-4095), at most 1024 entries
+            verbose (bool): Print confirmation message (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for each chunk's response
+        
+        Returns:
+            bool: True if the whole table was accepted, False otherwise
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        codes = [int(c) for c in codes]
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        if len(codes) > 1024:
+            print(f"Error: Table must have at most 1024 entries, got {len(codes)}")
+            return False
+        if any(c < 0 or c > 4095 for c in codes):
+            print("Error: DAC values must be 0-4095")
+            return False
+        
+        # Binary frames carry up to 126 codes, ASCII lines must fit the 64-byte MCU buffer
+        chunk = 120 if self.binary else 9
+        offset = 0
+        while True:
+            part = codes[offset:offset + chunk]
+            if self.binary:
+                payload = struct.pack('<BH', channel, offset) + struct.pack(f'<{len(part)}H', *part)
+                reply = self.transact(PROTO_OP_WAVE_LOAD, payload, timeout, verbose)
+                ok = reply is not None and reply[:1] == b'\x01'
+            else:
+                self.ser.reset_input_buffer()
+                fields = "".join(f",{c}" for c in part)
+                self.ser.write(f"wave_load,{channel},{offset}{fields}\n".encode())
+                self.ser.flush()
+                ok = self.wait_for_mcu_response(timeout) == "1"
+            
+            if not ok:
+                if verbose:
+                    print(f"  ✗ MCU rejected waveform chunk at offset {offset}")
+                return False
+            
+            offset += len(part)
+            if offset >= len(codes):
+                break
+        
+        self.wave_lengths[channel] = len(codes)
+        if verbose:
+            print(f"  ✓ Loaded {len(codes)} points on channel {channel}")
+        return True
+    
+    def wave_play(self, rate, loops=1, adc_channel=None, verbose=None, timeout=None):
+        """
+        Play the uploaded waveform tables from a hardware timer on the MCU.
+        
+        Every step is written to the DAC from a timer interrupt, so the timing is
+        deterministic and independent of the host. Optionally one ADC sample is taken
+        right after each step has been written.
+        
+        Args:
+            rate (int): Steps per second (1-5000, at most 500 with capture)
+            loops (int): Number of passes over the table (1-65535)
+            adc_channel (int): ADC channel (0-3) to capture after every step, or None
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Maximum time to wait for the result in seconds
+                             (default: playback time + 5s)
+        
+        Returns:
+            dict: {'steps': int steps written, 'missed': int steps that slipped,
+                   'voltages': numpy array per step (NaN where capture fell behind)
+                   or None without capture}, plus 'start_us' (MCU time step 0 was
+                   written, step i follows i / rate later) with timestamps on,
+                   or None if error
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        if rate < 1 or rate > 5000 or loops < 1 or loops > 65535:
+            print(f"Error: Rate must be 1-5000 and loops 1-65535, got {rate}, {loops}")
+            return None
+        if adc_channel is not None and (adc_channel < 0 or adc_channel > 3 or rate > 500):
+            print(f"Error: Capture needs ADC channel 0-3 and rate <= 500, got {adc_channel}, {rate}")
+            return None
+        
+        if timeout is None:
+            timeout = max(self.wave_lengths) * loops / rate + 5.0
+        
+        self.ser.reset_input_buffer()
+        codes = []
+        
+        if self.binary:
+            capture = 0xFF if adc_channel is None else adc_channel
+            seq = self.send_frame(PROTO_OP_WAVE_PLAY, struct.pack('<HHB', rate, loops, capture))
+            while True:
+                frame = self.read_frame(timeout)
+                if frame is None:
+                    if verbose:
+                        print("  ✗ No response from MCU")
+                    return None
+                opcode, reply_seq, payload = frame
+                if reply_seq != seq:
+                    continue
+                if opcode == (PROTO_OP_WAVE_PLAY | PROTO_REPLY_FLAG):
+                    codes.append(np.frombuffer(payload, dtype='<i2'))
+                elif opcode == (PROTO_OP_WAVE_END | PROTO_REPLY_FLAG):
+                    steps, missed = struct.unpack('<II', payload[:8])
+                    start_us = struct.unpack('<I', payload[8:12])[0] if len(payload) >= 12 else None
+                    break
+                else:
+                    if verbose:
+                        print(f"  ✗ Waveform rejected by MCU (opcode 0x{opcode:02X})")
+                    return None
+        else:
+            message = f"wave_play,{rate},{loops}"
+            if adc_channel is not None:
+                message += f",{adc_channel}"
+            self.ser.write((message + "\n").encode())
+            self.ser.flush()
+            
+            # The header only arrives once playback is over
+            header = self.wait_for_mcu_response(timeout)
+            if not header or not header.startswith("WAVE,"):
+                if verbose:
+                    print(f"  ✗ Unexpected response from MCU: {header}")
+                return None
+            fields = header.split(',')
+            steps = int(fields[1])
+            start_us = int(fields[3]) if len(fields) > 3 else None
+            
+            while True:
+                line = self.wait_for_mcu_response(5.0)
+                if line is None:
+                    if verbose:
+                        print("  ✗ Waveform result incomplete")
+                    return None
+                if line.startswith("D,"):
+                    codes.append(np.array(line[2:].split(','), dtype=np.int16))
+                elif line.startswith("END,"):
+                    missed = int(line[4:])
+                    break
+        
+        voltages = None
+        if adc_channel is not None:
+            raw = np.concatenate(codes) if codes else np.array([], dtype=np.int16)
+            voltages = adc_codes_to_volts(raw)
+            voltages[raw == -32768] = np.nan  # Step the capture fell behind on
+        
+        if verbose:
+            print(f"  ✓ Played {steps} steps at {rate} Hz ({missed} missed)")
+        result = {'steps': steps, 'missed': missed, 'voltages': voltages}
+        if start_us is not None:
+            result['start_us'] = start_us
+        return result
+    
     def sweep_all_channels(self, start_values, end_values, steps, delay=0.1):
         """
         Sweep all 4 channels simultaneously.
@@ -429,12 +1868,14 @@ class DACController(SerialController):
         print(f"Sweeping all channels in {steps} steps...")
         
         for i in range(steps):
+            dac_values = []
             for ch in range(4):
                 start_val = start_values[ch]
                 end_val = end_values[ch]
                 step_size = (end_val - start_val) / (steps - 1) if steps > 1 else 0
-                dac_value = int(start_val + i * step_size)
-                self.set_dac(ch, dac_value, verbose=False, wait_for_response=False)
+                dac_values.append(int(start_val + i * step_size))
+            # One transaction per step, all outputs latched together
+            self.set_multi(dac_values, verbose=False, wait_for_response=False)
             print(f"  Step {i+1}/{steps}: Ch0={int(start_values[0] + i*(end_values[0]-start_values[0])/(steps-1))}, "
                   f"Ch1={int(start_values[1] + i*(end_values[1]-start_values[1])/(steps-1))}, "
                   f"Ch2={int(start_values[2] + i*(end_values[2]-start_values[2])/(steps-1))}, "
@@ -514,9 +1955,9 @@ class DACController(SerialController):
                     # Single step - use end value
                     channel_values[config['channel']] = config['end']
             
-            # Update all channels simultaneously
-            for channel, value in channel_values.items():
-                self.set_dac(channel, value, verbose=False, wait_for_response=False)
+            # Update all channels simultaneously (one transaction, latched together)
+            self.set_multi([channel_values.get(ch) for ch in range(4)],
+                           verbose=False, wait_for_response=False)
             
             # Print status
             values_str = ", ".join([f"Ch{ch}={val}" for ch, val in sorted(channel_values.items())])
@@ -532,7 +1973,8 @@ class ADCController(SerialController):
     Controller class for reading voltages and currents from ADS1115 ADC via STM32 MCU.
     """
     
-    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True, shunt_resistors=[1.0, 1.0, 1.0, 1.0]):
+    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True, shunt_resistors=[1.0, 1.0, 1.0, 1.0],
+                 **kwargs):
         """
         Initialize the ADC controller.
         
@@ -542,9 +1984,13 @@ class ADCController(SerialController):
             auto_connect (bool): Automatically connect on initialization
             verbose (bool): Print connection messages
             shunt_resistors (list): Shunt resistor values in Ohms for each channel [ch0, ch1, ch2, ch3]
+            **kwargs: Passed on to SerialController (e.g. dtr_reset)
         """
-        super().__init__(port, baud, auto_connect, verbose)
+        super().__init__(port, baud, auto_connect, verbose, **kwargs)
         self.shunt_resistors = list(shunt_resistors)  # Make a copy
+        # Channels the MCU autoranges, and the full scale (V) of each channel's last reading
+        self.autorange = [False] * 4
+        self.last_range = [None] * 4
     
     def set_shunt_resistor(self, channel, value, verbose=None):
         """
@@ -611,24 +2057,79 @@ class ADCController(SerialController):
                 print(f"  ✗ No response from MCU within {timeout}s")
             return False
     
-    def read_voltage(self, channel, verbose=None, timeout=2.0):
+    def read_adc_raw(self, channel, verbose=None, timeout=2.0):
+        """
+        Read one uncalibrated ADC code, the input side of set_calibration('adc', ...).
+
+        Args:
+            channel (int): ADC channel number (0-3)
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+
+        Returns:
+            int: Raw ADS1115 code, or None if error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return None
+
+        self.ser.reset_input_buffer()
+        self.ser.write(f"read_adc_raw,{channel}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        try:
+            return int(response)
+        except (TypeError, ValueError):
+            if verbose:
+                print(f"  ✗ Invalid raw ADC reply: {response}")
+            return None
+
+    def read_voltage(self, channel, verbose=None, timeout=2.0, oversample=1, filter='boxcar',
+                     return_std=False):
         """
         Read voltage from an ADC channel.
         
+        With oversample > 1 the MCU takes that many conversions and filters them in
+        fixed point, so a low-noise reading still costs a single exchange.
+        
         Args:
             channel (int): Channel number (0-3)
             verbose (bool): Print confirmation message (defaults to self.verbose)
             timeout (float): Timeout in seconds when waiting for response
+            oversample (int): Conversions per reading (1-256)
+            filter (str): 'boxcar' (mean), 'median' (spike rejection) or
+                          'decimate' (moving average over a continuous-mode run at 860 SPS)
+            return_std (bool): Also return the standard deviation of the raw conversions
         
         Returns:
             float: Voltage in Volts, or None if error
+                   (tuple (voltage, stddev) if return_std is True)
         """
         if verbose is None:
             verbose = self.verbose
         
         if channel < 0 or channel > 3:
             print(f"Error: Channel must be 0-3, got {channel}")
-            return None
+            return (None, None) if return_std else None
+        
+        if oversample != 1 or return_std or self.autorange[channel]:
+            result = self._read_voltage_filtered(channel, oversample, filter, verbose, timeout)
+            return result if return_std else result[0]
+        
+        if self.binary:
+            reply = self.transact(PROTO_OP_READ_ADC, struct.pack('<B', channel), timeout, verbose)
+            if reply is None or len(reply) != (6 if self.timestamps else 2):
+                return None
+            raw_adc = struct.unpack('<h', reply[:2])[0]
+            if self.timestamps:
+                self.last_timestamp = struct.unpack('<I', reply[2:])[0]
+            voltage = float(adc_codes_to_volts(raw_adc))
+            if verbose:
+                print(f"  Channel {channel} voltage: {voltage:.4f}V (raw ADC: {raw_adc})")
+            return voltage
         
         # Clear any leftover data in input buffer
         self.ser.reset_input_buffer()
@@ -645,8 +2146,10 @@ class ADCController(SerialController):
         
         if response:
             try:
-                # Response might be "voltage,raw_adc" or just "voltage"
+                # Response might be "voltage,raw_adc" or just "voltage", then the timestamp
                 parts = response.split(',')
+                if self.timestamps:
+                    self.last_timestamp = int(parts.pop())
                 voltage = float(parts[0])
                 if len(parts) > 1:
                     raw_adc = int(parts[1])
@@ -665,7 +2168,163 @@ class ADCController(SerialController):
                 print(f"Warning: No response from MCU within {timeout}s for channel {channel}")
             return None
     
-    def read_current(self, channel, verbose=None, timeout=2.0):
+    def read_voltage_async(self, channel):
+        """
+        Request a single-conversion reading without waiting for it (needs start_async()).
+
+        Args:
+            channel (int): Channel number (0-3)
+
+        Returns:
+            Future: Resolves to the voltage in Volts, or None on error; None instead
+                    of a Future if the channel is invalid
+        """
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return None
+
+        if self.binary:
+            return self.transact_async(PROTO_OP_READ_ADC, struct.pack('<B', channel),
+                                       parse=lambda reply: float(adc_codes_to_volts(struct.unpack('<h', reply[:2])[0])))
+        return self.command_async(f"read_adc,{channel}", parse=lambda reply: float(reply.split(',')[0]))
+    
+    def _read_voltage_filtered(self, channel, oversample, filter, verbose, timeout):
+        """
+        Filtered reading on the MCU; returns (voltage, stddev) in Volts or (None, None).
+        """
+        if oversample < 1 or oversample > 256:
+            print(f"Error: Oversample must be 1-256, got {oversample}")
+            return None, None
+        if filter not in ADC_FILTERS:
+            print(f"Error: Filter must be one of {list(ADC_FILTERS)}, got '{filter}'")
+            return None, None
+        
+        # Conversion time plus margin: 128 SPS single-shot, 860 SPS continuous
+        rate = 860 if filter == 'decimate' else 128
+        timeout = max(timeout, oversample / rate + 1.0)
+        
+        if self.autorange[channel]:
+            return self._read_voltage_ranged(channel, oversample, filter, verbose, timeout)
+        
+        if self.binary:
+            payload = struct.pack('<BHB', channel, oversample, ADC_FILTERS[filter])
+            reply = self.transact(PROTO_OP_READ_ADC_FILTERED, payload, timeout, verbose)
+            if reply is None or len(reply) != (14 if self.timestamps else 10):
+                return None, None
+            value, stddev, count = struct.unpack('<iIH', reply[:10])
+            if self.timestamps:
+                self.last_timestamp = struct.unpack('<I', reply[10:])[0]
+            scale = ADC_LSB_VOLTS / (1 << ADC_FILTER_FRAC_BITS)
+            voltage = min(max(value * scale, 0.0), 5.0)
+            stddev = stddev * scale
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"read_adc,{channel},{oversample},{ADC_FILTERS[filter]}\n".encode())
+            self.ser.flush()
+            
+            response = self.wait_for_mcu_response(timeout)
+            try:
+                parts = response.split(',')
+                if self.timestamps:
+                    self.last_timestamp = int(parts.pop())
+                voltage, stddev = (float(v) for v in parts)
+            except (AttributeError, ValueError):
+                if verbose:
+                    print(f"Error: Invalid response from MCU: '{response}'")
+                return None, None
+        
+        if verbose:
+            print(f"  Channel {channel} voltage: {voltage:.6f}V "
+                  f"(σ={stddev*1e6:.1f}µV, {filter} of {oversample})")
+        return voltage, stddev
+    
+    def _read_voltage_ranged(self, channel, oversample, filter, verbose, timeout):
+        """
+        Autoranged reading on the MCU; returns (voltage, stddev) in Volts or (None, None)
+        and records the range in self.last_range.
+        """
+        if self.binary:
+            payload = struct.pack('<BHB', channel, oversample, ADC_FILTERS[filter])
+            reply = self.transact(PROTO_OP_READ_ADC_RANGED, payload, timeout, verbose)
+            if reply is None or len(reply) != (15 if self.timestamps else 11):
+                return None, None
+            microvolts, stddev_uv, count, pga = struct.unpack('<iIHB', reply[:11])
+            if self.timestamps:
+                self.last_timestamp = struct.unpack('<I', reply[11:])[0]
+            voltage = min(max(microvolts * 1e-6, 0.0), 5.0)
+            stddev = stddev_uv * 1e-6
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"read_adc,{channel},{oversample},{ADC_FILTERS[filter]}\n".encode())
+            self.ser.flush()
+            
+            response = self.wait_for_mcu_response(timeout)
+            try:
+                parts = response.split(',')
+                if self.timestamps:
+                    self.last_timestamp = int(parts.pop())
+                voltage, stddev, pga = parts
+                voltage, stddev, pga = float(voltage), float(stddev), int(pga)
+            except (AttributeError, ValueError):
+                if verbose:
+                    print(f"Error: Invalid response from MCU: '{response}'")
+                return None, None
+        
+        self.last_range[channel] = ADC_PGA_RANGES[min(pga, len(ADC_PGA_RANGES) - 1)]
+        if verbose:
+            print(f"  Channel {channel} voltage: {voltage:.6f}V "
+                  f"(σ={stddev*1e6:.1f}µV, ±{self.last_range[channel]}V range)")
+        return voltage, stddev
+    
+    def set_autorange(self, channel, enable=True, verbose=None, timeout=2.0):
+        """
+        Switch automatic PGA ranging for an ADC channel on the MCU.
+        
+        An autoranged channel converts at the tightest ADS1115 range that
+        kept its previous reading below 75% of full scale, and repeats a
+        clipped conversion one range wider, so a small shunt voltage gets
+        up to 24x the resolution of the fixed ±6.144V range from a single
+        conversion. read_voltage() and read_current() use it automatically
+        ('decimate' readings stay at ±6.144V); the range of each reading is
+        stored in self.last_range. Sweeps, scans, streams and the
+        constant-current and current-limit loops keep the fixed range.
+        
+        Args:
+            channel (int): Channel number (0-3)
+            enable (bool): True to autorange, False for the fixed ±6.144V range
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+        
+        Returns:
+            bool: True if the MCU accepted the setting
+        """
+        if verbose is None:
+            verbose = self.verbose
+        
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        
+        if self.binary:
+            reply = self.transact(PROTO_OP_AUTORANGE, struct.pack('<BB', channel, 1 if enable else 0),
+                                  timeout, verbose)
+            ok = reply is not None and reply[:1] == b'\x01'
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"autorange,{channel},{1 if enable else 0}\n".encode())
+            self.ser.flush()
+            ok = self.wait_for_mcu_response(timeout) == "1"
+        
+        if ok:
+            self.autorange[channel] = bool(enable)
+            self.last_range[channel] = None
+        if verbose:
+            state = "on" if enable else "off"
+            print(f"  {'✓' if ok else '✗'} Channel {channel} autorange {state}")
+        return ok
+    
+    def read_current(self, channel, verbose=None, timeout=2.0, oversample=1, filter='boxcar',
+                     return_std=False):
         """
         Read current through shunt resistor on an ADC channel.
         
@@ -673,22 +2332,30 @@ class ADCController(SerialController):
             channel (int): Channel number (0-3)
             verbose (bool): Print confirmation message (defaults to self.verbose)
             timeout (float): Timeout in seconds when waiting for response
+            oversample (int): Conversions per reading, filtered on the MCU (1-256)
+            filter (str): 'boxcar', 'median' or 'decimate' (see read_voltage)
+            return_std (bool): Also return the standard deviation in Amperes
         
         Returns:
             float: Current in Amperes, or None if error
+                   (tuple (current, stddev) if return_std is True)
         """
         if verbose is None:
             verbose = self.verbose
         
         if channel < 0 or channel > 3:
             print(f"Error: Channel must be 0-3, got {channel}")
-            return None
+            return (None, None) if return_std else None
         
         # Read voltage across shunt resistor
-        voltage = self.read_voltage(channel, verbose=False, timeout=timeout)
+        if oversample != 1 or return_std:
+            voltage, stddev = self.read_voltage(channel, verbose=False, timeout=timeout,
+                                                oversample=oversample, filter=filter, return_std=True)
+        else:
+            voltage, stddev = self.read_voltage(channel, verbose=False, timeout=timeout), None
         
         if voltage is None:
-            return None
+            return (None, None) if return_std else None
         
         # Calculate current: I = V / R
         shunt_r = self.shunt_resistors[channel]
@@ -697,23 +2364,223 @@ class ADCController(SerialController):
         if verbose:
             print(f"Channel {channel} current: {current*1000:.3f}mA (V={voltage:.4f}V, R={shunt_r}Ω)")
         
+        if return_std:
+            return current, stddev / shunt_r
         return current
-    
-    def read_all_voltages(self, verbose=None, timeout=2.0):
+
+    def sweep_onboard(self, dac_channel, adc_channel, start_value, end_value, steps,
+                      settle_us=1000, verbose=None, timeout=None, settle_tolerance=None,
+                      max_settle_us=200000):
+        """
+        Run a DAC sweep with ADC capture on the MCU and convert the result to currents.
+
+        Same arguments as SerialController.sweep_onboard().
+
+        Returns:
+            dict: {'dac_values': [...], 'voltages': [...], 'currents': [...]}, or None on error
+        """
+        data = super().sweep_onboard(dac_channel, adc_channel, start_value, end_value,
+                                     steps, settle_us, verbose, timeout, settle_tolerance,
+                                     max_settle_us)
+        if data is None:
+            return None
+
+        shunt_r = self.shunt_resistors[adc_channel]
+        data['currents'] = [v / shunt_r for v in data['voltages']]
+        return data
+
+    def stream(self, channel, rate, n, verbose=None, timeout=None):
+        """
+        Stream continuous-mode ADC samples from one channel.
+
+        The firmware puts the ADS1115 in continuous mode (rounded up to the next of
+        8/16/32/64/128/250/475/860 SPS), fills a double-buffered RAM block and ships
+        each block as it completes. This generator yields one block at a time, so
+        the caller can process data while acquisition continues.
+
+        Args:
+            channel (int): Channel number (0-15, channels 4-15 need further ADS1115s)
+            rate (int): Requested samples per second (1-860)
+            n (int): Total number of samples
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Maximum wait for any single block in seconds
+
+        Yields:
+            numpy.ndarray: Voltages of one block
+
+        After the generator finishes, self.last_stream_overruns holds the number of
+        samples the firmware had to drop. With timestamps on, self.last_block_times
+        holds the MCU time (us) of the first sample of each block.
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if channel < 0 or channel >= ADC_SCAN_CHANNELS:
+            print(f"Error: Channel must be 0-{ADC_SCAN_CHANNELS - 1}, got {channel}")
+            return
+        if rate < 1 or rate > 860 or n < 1:
+            print(f"Error: Rate must be 1-860 SPS and n >= 1, got {rate}, {n}")
+            return
+
+        if timeout is None:
+            # Slowest block is a single sample at 8 SPS; firmware gives up after 1s stall
+            timeout = 3.0
+
+        self.last_stream_overruns = None
+        self.last_block_times = []
+        self.ser.reset_input_buffer()
+        received = 0
+
+        if self.binary:
+            seq = self.send_frame(PROTO_OP_STREAM, struct.pack('<BHI', channel, rate, n))
+            while True:
+                frame = self.read_frame(timeout)
+                if frame is None:
+                    if verbose:
+                        print(f"  ✗ Stream timed out after {received}/{n} samples")
+                    return
+                opcode, reply_seq, payload = frame
+                if reply_seq != seq:
+                    continue
+                if opcode == (PROTO_OP_STREAM | PROTO_REPLY_FLAG):
+                    if self.timestamps:
+                        self.last_block_times.append(struct.unpack('<I', payload[:4])[0])
+                        payload = payload[4:]
+                    codes = np.frombuffer(payload, dtype='<i2')
+                    received += len(codes)
+                    yield adc_codes_to_volts(codes)
+                elif opcode == (PROTO_OP_STREAM_END | PROTO_REPLY_FLAG):
+                    samples, self.last_stream_overruns = struct.unpack('<II', payload)
+                    break
+                else:
+                    if verbose:
+                        print(f"  ✗ Stream rejected by MCU (opcode 0x{opcode:02X})")
+                    return
+        else:
+            self.ser.write(f"stream,{channel},{rate},{n}\n".encode())
+            self.ser.flush()
+
+            header = self.wait_for_mcu_response(timeout)
+            if not header or not header.startswith("STREAM,"):
+                if verbose:
+                    print(f"  ✗ Unexpected response from MCU: {header}")
+                return
+            if verbose:
+                print(f"Streaming ADC ch{channel} at {header.split(',')[2]} SPS ({n} samples)...")
+
+            while True:
+                line = self.wait_for_mcu_response(timeout)
+                if line is None:
+                    if verbose:
+                        print(f"  ✗ Stream timed out after {received}/{n} samples")
+                    return
+                if line.startswith("D,"):
+                    fields = line[2:].split(',')
+                    if self.timestamps:
+                        self.last_block_times.append(int(fields.pop(0)))
+                    codes = np.array(fields, dtype=np.int16)
+                    received += len(codes)
+                    yield adc_codes_to_volts(codes)
+                elif line.startswith("END,"):
+                    self.last_stream_overruns = int(line[4:])
+                    break
+
+        if verbose:
+            print(f"  ✓ Received {received}/{n} samples ({self.last_stream_overruns} overruns)")
+
+    def scan(self, mask=0x0F, oversample=1, verbose=None, timeout=2.0):
+        """
+        Read several ADC channels with a single command.
+
+        The firmware converts every channel in the mask back-to-back on I2C2 and
+        returns all results in one reply, so a 4-channel snapshot costs one serial
+        exchange instead of four. With several ADS1115s on the bus (SMU_ADC_COUNT)
+        the chips convert in parallel, so 16 channels take as long as 4.
+
+        Args:
+            mask (int): Channel bit mask, bit n selects channel n (0x0001-0xFFFF;
+                        bits 4-15 need further ADS1115s, the MCU rejects absent ones)
+            oversample (int): Conversions averaged per channel on the MCU (1-64)
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+
+        Returns:
+            list: Voltages [ch0, ch1, ...] in Volts for every channel of the chips the
+                  mask reaches (4 for masks up to 0x0F), None for channels not in
+                  the mask, nan where every conversion failed, or None if error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if mask < 0x0001 or mask >= (1 << ADC_SCAN_CHANNELS):
+            print(f"Error: Channel mask must be 0x0001-0xFFFF, got 0x{mask:X}")
+            return None
+        if oversample < 1 or oversample > 64:
+            print(f"Error: Oversample must be 1-64, got {oversample}")
+            return None
+
+        channels = [ch for ch in range(ADC_SCAN_CHANNELS) if mask & (1 << ch)]
+
+        if self.binary:
+            payload = struct.pack('<BB' if mask <= 0xFF else '<HB', mask, oversample)
+            reply = self.transact(PROTO_OP_SCAN, payload, timeout, verbose)
+            if reply is None or len(reply) != 2 * len(channels) + (4 if self.timestamps else 0):
+                return None
+            codes = np.frombuffer(reply, dtype='<i2', count=len(channels))
+            volts = adc_codes_to_volts(codes)
+            volts[codes == -32768] = np.nan  # Every conversion of the channel failed
+            readings = volts.tolist()
+            if self.timestamps:
+                self.last_timestamp = struct.unpack('<I', reply[-4:])[0]
+        else:
+            self.ser.reset_input_buffer()
+            self.ser.write(f"scan,{mask},{oversample}\n".encode())
+            self.ser.flush()
+
+            response = self.wait_for_mcu_response(timeout)
+            if not response or not response.startswith("SCAN,"):
+                if verbose:
+                    print(f"Error: Invalid response from MCU: '{response}'")
+                return None
+            try:
+                fields = response.split(',')[2:]
+                if self.timestamps:
+                    self.last_timestamp = int(fields.pop())
+                readings = [float(v) for v in fields]
+            except ValueError:
+                if verbose:
+                    print(f"Error: Invalid response from MCU: '{response}'")
+                return None
+            if len(readings) != len(channels):
+                if verbose:
+                    print(f"Error: Expected {len(channels)} values, got '{response}'")
+                return None
+
+        voltages = [None] * (4 * (channels[-1] // 4 + 1))
+        for ch, v in zip(channels, readings):
+            voltages[ch] = v
+        return voltages
+
+    def read_all_voltages(self, verbose=None, timeout=2.0, oversample=1):
         """
         Read voltages from all ADC channels.
         
+        Uses a single scan command for all four channels.
+        
         Args:
             verbose (bool): Print confirmation message (defaults to self.verbose)
             timeout (float): Timeout in seconds when waiting for response
+            oversample (int): Conversions averaged per channel on the MCU (1-64)
         
         Returns:
             list: List of voltages [ch0, ch1, ch2, ch3] in Volts, None values on error
         """
-        voltages = []
-        for ch in range(4):
-            v = self.read_voltage(ch, verbose=False, timeout=timeout)
-            voltages.append(v)
+        if verbose is None:
+            verbose = self.verbose
+        
+        voltages = self.scan(0x0F, oversample, verbose=False, timeout=timeout)
+        if voltages is None:
+            voltages = [None] * 4
         
         if verbose:
             print("All channel voltages:")
@@ -725,21 +2592,26 @@ class ADCController(SerialController):
         
         return voltages
     
-    def read_all_currents(self, verbose=None, timeout=2.0):
+    def read_all_currents(self, verbose=None, timeout=2.0, oversample=1):
         """
         Read currents from all ADC channels.
         
+        Uses a single scan command for all four channels.
+        
         Args:
             verbose (bool): Print confirmation message (defaults to self.verbose)
             timeout (float): Timeout in seconds when waiting for response
+            oversample (int): Conversions averaged per channel on the MCU (1-64)
         
         Returns:
             list: List of currents [ch0, ch1, ch2, ch3] in Amperes, None values on error
         """
-        currents = []
-        for ch in range(4):
-            i = self.read_current(ch, verbose=False, timeout=timeout)
-            currents.append(i)
+        if verbose is None:
+            verbose = self.verbose
+        
+        voltages = self.read_all_voltages(verbose=False, timeout=timeout, oversample=oversample)
+        currents = [v / self.shunt_resistors[ch] if v is not None else None
+                    for ch, v in enumerate(voltages)]
         
         if verbose:
             print("All channel currents:")
@@ -752,117 +2624,543 @@ class ADCController(SerialController):
         return currents
 
 
+class SMU(DACController, ADCController):
+    """
+    DAC and ADC operations over a single serial connection.
+
+    DACController and ADCController each open the port, so scripts that mix
+    them had to close one and reopen the port for the other. SMU owns one
+    connection and exposes both sets of methods (set_dac, read_current, ...).
+    """
+
+    def __init__(self, port="COM3", baud=115200, auto_connect=True, verbose=True,
+                 shunt_resistors=[1.0, 1.0, 1.0, 1.0], dtr_reset=False):
+        """
+        Initialize the SMU.
+
+        Args:
+            port (str): Serial port name (e.g., "COM3", "/dev/ttyUSB0")
+            baud (int): Baud rate (default: 115200)
+            auto_connect (bool): Automatically connect on initialization
+            verbose (bool): Print connection messages
+            shunt_resistors (list): Shunt resistor values in Ohms for each channel [ch0, ch1, ch2, ch3]
+            dtr_reset (bool): Wait for an MCU reset after opening (see SerialController);
+                              off by default, so the port is ready in milliseconds
+        """
+        super().__init__(port, baud, auto_connect, verbose,
+                         shunt_resistors=shunt_resistors, dtr_reset=dtr_reset)
+
+    def set_constant_current(self, channel, current_ma, max_code=4095, verbose=None, timeout=2.0):
+        """
+        Regulate a channel's current with the PI loop on the MCU.
+
+        DAC channel n drives the load and ADC channel n reads its shunt. The
+        shunt value from shunt_resistors is sent first, so the MCU converts
+        the setpoint the same way read_current() does. The loop runs at the
+        ADC data rate (860 SPS) until stop_constant_current().
+
+        Args:
+            channel (int): Channel number (0-3)
+            current_ma (float): Setpoint in mA
+            max_code (int): Compliance limit, highest DAC code the loop may write (1-4095)
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+
+        Returns:
+            bool: True if the loop was started
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        if current_ma < 0:
+            print(f"Error: Current must be >= 0 mA, got {current_ma}")
+            return False
+        if max_code < 1 or max_code > 4095:
+            print(f"Error: Compliance limit must be 1-4095, got {max_code}")
+            return False
+
+        shunt_mohm = int(round(self.shunt_resistors[channel] * 1000))
+        self.ser.reset_input_buffer()
+        self.ser.write(f"shunt,{channel},{shunt_mohm}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response != "1":
+            if verbose:
+                print(f"  ✗ MCU rejected shunt value: {response}")
+            return False
+
+        self.ser.write(f"cc,{channel},{current_ma:.3f},{max_code}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response and response.startswith("CC,"):
+            if verbose:
+                print(f"  ✓ Channel {channel} regulating {current_ma:.3f}mA (compliance code {max_code})")
+            return True
+
+        if verbose:
+            print(f"  ✗ Failed to start constant-current loop: {response}")
+        return False
+
+    def stop_constant_current(self, verbose=None, timeout=2.0):
+        """Stop the MCU's constant-current loop; the DAC keeps its last code."""
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"cc_off\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if verbose:
+            print("  ✓ Constant-current loop stopped" if response == "1" else f"  ✗ No acknowledgment: {response}")
+        return response == "1"
+
+    def set_constant_current_gains(self, kp, ki, verbose=None, timeout=2.0):
+        """
+        Set the MCU's PI gains.
+
+        Args:
+            kp (float): Proportional gain, DAC codes per ADC code of error (default 0.05)
+            ki (float): Integral gain, DAC codes per ADC code per conversion (default 0.1)
+
+        Returns:
+            bool: True if the MCU accepted the gains
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if kp < 0 or ki < 0:
+            print(f"Error: Gains must be >= 0, got kp={kp}, ki={ki}")
+            return False
+
+        self.ser.reset_input_buffer()
+        self.ser.write(f"cc_gain,{int(round(kp * 65536))},{int(round(ki * 65536))}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response != "1" and verbose:
+            print(f"  ✗ Failed to set gains: {response}")
+        return response == "1"
+
+    def constant_current_status(self, verbose=None, timeout=2.0):
+        """
+        Read the state of the MCU's constant-current loop.
+
+        Returns:
+            dict: {'active', 'channel', 'target_ma', 'current_ma', 'dac_code',
+                   'compliance', 'iterations'}, or None on error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"cc_status\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if not response or not response.startswith("CC_STATUS,"):
+            if verbose:
+                print(f"  ✗ Invalid status reply: {response}")
+            return None
+
+        try:
+            fields = [int(v) for v in response.split(',')[1:]]
+        except ValueError:
+            fields = []
+        if len(fields) != 7:
+            if verbose:
+                print(f"  ✗ Invalid status reply: {response}")
+            return None
+
+        channel = fields[1]
+        to_ma = ADC_LSB_VOLTS / self.shunt_resistors[channel] * 1000
+        status = {
+            'active': bool(fields[0]),
+            'channel': channel,
+            'target_ma': fields[2] * to_ma,
+            'current_ma': fields[3] * to_ma,
+            'dac_code': fields[4],
+            'compliance': bool(fields[5]),
+            'iterations': fields[6],
+        }
+        if verbose:
+            print(f"  Channel {channel}: {status['current_ma']:.3f}mA of {status['target_ma']:.3f}mA, "
+                  f"DAC {status['dac_code']}{' (compliance)' if status['compliance'] else ''}")
+        return status
+
+    def set_current_limit(self, channel, limit_ma, verbose=None, timeout=2.0):
+        """
+        Arm the MCU's over-current trip on a channel.
+
+        The ADS1115 comparator watches ADC channel n (the shunt) and its ALERT
+        interrupt zeroes DAC channel n within one conversion of the current
+        exceeding limit_ma, without a host round trip. The MCU stops a
+        constant-current loop or waveform driving the channel and reports
+        the trip; reports land in self.trips (and on_trip, if set). The trip
+        only sees conversions: the MCU converts the channel whenever it is
+        idle, but long operations on other channels (e.g. a stream) leave it
+        unwatched. Calling this again clears a trip.
+
+        Args:
+            channel (int): Channel number (0-3)
+            limit_ma (float): Trip current in mA
+            verbose (bool): Print status messages (defaults to self.verbose)
+            timeout (float): Timeout in seconds when waiting for response
+
+        Returns:
+            bool: True if the limit was armed
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        if channel < 0 or channel > 3:
+            print(f"Error: Channel must be 0-3, got {channel}")
+            return False
+        if limit_ma <= 0:
+            print(f"Error: Current limit must be > 0 mA, got {limit_ma}")
+            return False
+
+        shunt_mohm = int(round(self.shunt_resistors[channel] * 1000))
+        self.ser.reset_input_buffer()
+        self.ser.write(f"shunt,{channel},{shunt_mohm}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response != "1":
+            if verbose:
+                print(f"  ✗ MCU rejected shunt value: {response}")
+            return False
+
+        self.ser.write(f"limit,{channel},{limit_ma:.3f}\n".encode())
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if response and response.startswith("LIMIT,"):
+            if verbose:
+                print(f"  ✓ Channel {channel} trips above {limit_ma:.3f}mA")
+            return True
+
+        if verbose:
+            print(f"  ✗ Failed to arm current limit: {response}")
+        return False
+
+    def clear_current_limit(self, verbose=None, timeout=2.0):
+        """Disarm the MCU's over-current trip."""
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"limit_off\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if verbose:
+            print("  ✓ Current limit disarmed" if response == "1" else f"  ✗ No acknowledgment: {response}")
+        return response == "1"
+
+    def current_limit_status(self, verbose=None, timeout=2.0):
+        """
+        Read the state of the MCU's over-current trip.
+
+        Returns:
+            dict: {'armed', 'channel', 'limit_ma', 'tripped', 'trips'}, or None on error
+        """
+        if verbose is None:
+            verbose = self.verbose
+
+        self.ser.reset_input_buffer()
+        self.ser.write(b"limit_status\n")
+        self.ser.flush()
+        response = self.wait_for_mcu_response(timeout)
+        if not response or not response.startswith("LIMIT_STATUS,"):
+            if verbose:
+                print(f"  ✗ Invalid status reply: {response}")
+            return None
+
+        try:
+            fields = [int(v) for v in response.split(',')[1:]]
+        except ValueError:
+            fields = []
+        if len(fields) != 5:
+            if verbose:
+                print(f"  ✗ Invalid status reply: {response}")
+            return None
+
+        channel = fields[1]
+        status = {
+            'armed': bool(fields[0]),
+            'channel': channel,
+            'limit_ma': fields[2] * ADC_LSB_VOLTS / self.shunt_resistors[channel] * 1000,
+            'tripped': bool(fields[3]),
+            'trips': fields[4],
+        }
+        if verbose:
+            state = "tripped" if status['tripped'] else ("armed" if status['armed'] else "off")
+            print(f"  Channel {channel} limit {status['limit_ma']:.3f}mA: {state}")
+        return status
+
+
+class SMUArray:
+    """
+    Several SMU boards driven side by side, each from its own worker thread.
+
+    Every board gets a single-thread executor, so its commands stay in order
+    while all boards run at once; a sweep over N boards takes about as long as
+    on one. Serial I/O releases the GIL, so threads are enough.
+
+    Usage:
+        with SMUArray() as boards:              # every ST-LINK/USB CDC port that answers COMM_OK
+            data = boards.sweep_onboard(0, 0, 0, 4095, 1000)
+            DataHandler.save_to_csv(data, 'all_boards.csv')
+    """
+
+    def __init__(self, ports=None, baud=115200, verbose=True, shunt_resistors=[1.0, 1.0, 1.0, 1.0],
+                 probe_timeout=1.0, st_ports_only=True):
+        """
+        Connect to the boards.
+
+        Args:
+            ports (list): Port names to use; None discovers them (see discover())
+            baud (int): Baud rate for every board
+            verbose (bool): Print discovery and per-board status
+            shunt_resistors (list): Shunt values in Ohms, the same for every board
+                                    (change per board through boards[port].shunt_resistors)
+            probe_timeout (float): Seconds to wait for each board's COMM_OK reply
+            st_ports_only (bool): Discovery only probes ports with ST's USB vendor
+                                  ID (ST-LINK VCP, native USB CDC), not every serial port
+        """
+        self.verbose = verbose
+        if ports is None:
+            candidates = [p.device for p in list_available_ports(verbose)
+                          if not st_ports_only or p.vid == STLINK_VID]
+        else:
+            candidates = list(ports)
+
+        # Open and probe all candidates at once, a silent port costs probe_timeout once
+        with ThreadPoolExecutor(max_workers=max(len(candidates), 1)) as pool:
+            opened = list(pool.map(lambda port: self._open(port, baud, shunt_resistors, probe_timeout),
+                                   candidates))
+        self.boards = {port: smu for port, smu in zip(candidates, opened) if smu is not None}
+        self._workers = {port: ThreadPoolExecutor(max_workers=1, thread_name_prefix=f"smu-{port}")
+                         for port in self.boards}
+
+        if verbose:
+            print(f"✓ {len(self.boards)} board(s): {', '.join(self.boards) or 'none'}")
+
+    @staticmethod
+    def _open(port, baud, shunt_resistors, probe_timeout):
+        """Connect to one port; returns the SMU if it answers COMM_OK, else None."""
+        try:
+            smu = SMU(port=port, baud=baud, verbose=False, shunt_resistors=list(shunt_resistors))
+        except (serial.SerialException, OSError):
+            return None
+        if smu.check_communication(timeout=probe_timeout, verbose=False):
+            return smu
+        smu.close()
+        return None
+
+    @staticmethod
+    def discover(baud=115200, probe_timeout=1.0, st_ports_only=True):
+        """
+        Find the ports with a responding SMU, without keeping them open.
+
+        Returns:
+            list: Port names
+        """
+        with SMUArray(baud=baud, verbose=False, probe_timeout=probe_timeout,
+                      st_ports_only=st_ports_only) as boards:
+            return list(boards.boards)
+
+    def run(self, function, *args, **kwargs):
+        """
+        Call function(smu, *args, **kwargs) on every board concurrently.
+
+        Args:
+            function: Callable taking the board's SMU as first argument
+
+        Returns:
+            dict: port -> return value (None where the call raised)
+        """
+        futures = {port: self._workers[port].submit(function, smu, *args, **kwargs)
+                   for port, smu in self.boards.items()}
+        results = {}
+        for port, future in futures.items():
+            try:
+                results[port] = future.result()
+            except Exception as e:
+                if self.verbose:
+                    print(f"  ✗ {port}: {e}")
+                results[port] = None
+        return results
+
+    def call(self, method, *args, **kwargs):
+        """
+        Call an SMU method by name on every board concurrently, e.g. call('set_dac', 0, 2048).
+
+        Returns:
+            dict: port -> return value
+        """
+        return self.run(lambda smu: getattr(smu, method)(*args, **kwargs))
+
+    def sweep_onboard(self, dac_channel, adc_channel, start_value, end_value, steps,
+                      settle_us=1000, timeout=None, settle_tolerance=None, max_settle_us=200000):
+        """
+        Run the same on-MCU sweep on every board at once (see SMU.sweep_onboard).
+
+        Returns:
+            dict: Merged dataset (see merge()), boards that failed are left out
+        """
+        return self.merge(self.call('sweep_onboard', dac_channel, adc_channel, start_value,
+                                    end_value, steps, settle_us, verbose=False, timeout=timeout,
+                                    settle_tolerance=settle_tolerance, max_settle_us=max_settle_us))
+
+    @staticmethod
+    def merge(results):
+        """
+        Concatenate per-board column dictionaries into one dataset.
+
+        Args:
+            results (dict): port -> {'column': [...], ...} (None entries are skipped)
+
+        Returns:
+            dict: The columns every board returned, concatenated in board order,
+                  plus 'board' (the port name of each row)
+        """
+        valid = {port: data for port, data in results.items() if data}
+        if not valid:
+            return {'board': []}
+
+        columns = [col for col in next(iter(valid.values())) if all(col in d for d in valid.values())]
+        merged = {'board': []}
+        merged.update({col: [] for col in columns})
+        for port, data in valid.items():
+            rows = len(data[columns[0]]) if columns else 0
+            merged['board'].extend([port] * rows)
+            for col in columns:
+                merged[col].extend(data[col])
+        return merged
+
+    def close(self):
+        """Stop the workers and close every connection."""
+        for worker in self._workers.values():
+            worker.shutdown(wait=True)
+        for smu in self.boards.values():
+            smu.close()
+
+    def __len__(self):
+        return len(self.boards)
+
+    def __getitem__(self, port):
+        return self.boards[port]
+
+    def __iter__(self):
+        return iter(self.boards.values())
+
+    def __enter__(self):
+        """Context manager entry."""
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        """Context manager exit - automatically close all connections."""
+        self.close()
+
+
 # ============================================================================
 # Main execution - example usage
 # ============================================================================
 
 if __name__ == "__main__":
-    # Create controller instance
-    dac = DACController(port="COM3", baud=115200, verbose=True)
+    # One connection for both DAC and ADC
+    # Note: Set shunt resistor value (in Ohms) for current calculation
+    # IMPORTANT: Update shunt_resistors to match your hardware!
+    smu = SMU(port="COM3", baud=115200,
+              shunt_resistors=[200.0, 200.0, 200.0, 200.0],  # 200Ω shunt resistors (update to match your hardware)
+              verbose=True)
     
     # Print initialization message
-    print("Connected to STM32 on", dac.port)
+    print("Connected to STM32 on", smu.port)
     print("Ready to control DAC channels.")
     
     # Check communication on startup
-    if dac.check_communication(verbose=True):
+    if smu.check_communication(verbose=True):
         print("Communication verified!\n")
     else:
         print("Warning: Communication check failed. MCU may not be ready.\n")
     
     # print("Available methods:")
-    # print("  - dac.check_communication()  # Verify MCU communication")
-    # print("  - dac.set_dac(channel, dac_value)")
-    # print("  - dac.set_all_channels(dac_value)  # Set all channels to same value")
-    # print("  - dac.sweep_channel(channel, start, end, steps, delay)")
-    # print("  - dac.sweep_all_channels([start0,start1,start2,start3], [end0,end1,end2,end3], steps, delay)")
-    # print("  - dac.sweep_channels_independent([{'channel':0,'start':0,'end':100,'steps':50}, ...])  # Independent sweeps")
-    # print("  - dac.read_response()")
-    # print("  - dac.close()")
+    # print("  - smu.check_communication()  # Verify MCU communication")
+    # print("  - smu.set_dac(channel, dac_value)")
+    # print("  - smu.set_all_channels(dac_value)  # Set all channels to same value")
+    # print("  - smu.sweep_channel(channel, start, end, steps, delay)")
+    # print("  - smu.sweep_all_channels([start0,start1,start2,start3], [end0,end1,end2,end3], steps, delay)")
+    # print("  - smu.sweep_channels_independent([{'channel':0,'start':0,'end':100,'steps':50}, ...])  # Independent sweeps")
+    # print("  - smu.read_response()")
+    # print("  - smu.close()")
     # print("\nExample usage:")
-    # print("  dac.check_communication()  # Check if MCU is responding")
-    # print("  dac.sweep_channel(0, 0, 4095, 100, delay=0.05)  # Sweep channel 0 from 0 to 4095 in 100 steps")
-    # print("  dac.set_dac(1, 2048)  # Set channel 1 to mid-scale\n")
+    # print("  smu.check_communication()  # Check if MCU is responding")
+    # print("  smu.sweep_channel(0, 0, 4095, 100, delay=0.05)  # Sweep channel 0 from 0 to 4095 in 100 steps")
+    # print("  smu.set_dac(1, 2048)  # Set channel 1 to mid-scale\n")
     
     # ============================================================================
     # YOUR CODE GOES HERE
     # ============================================================================
     
     # Example: Set DAC channel 0 to 1000 and read current from ADC channel 0
-    if dac.check_communication():
+    if smu.check_communication():
         print("Communication verified!")
-        time.sleep(1)
         
         # Set DAC channel 0 to 1000
         print("Setting DAC channel 0 to 1000...")
-        dac.set_dac(0, 1000)
+        smu.set_dac(0, 1000)
         time.sleep(0.2)  # Wait for DAC to settle (increased delay)
         
-        # Close DAC controller to free the serial port
-        dac.close()
-        time.sleep(0.5)  # Brief pause before reopening port
-        
-        # Create ADC controller to read current
-        # Note: Set shunt resistor value (in Ohms) for current calculation
-        # IMPORTANT: Update shunt_resistors to match your hardware!
-        adc = ADCController(port="COM3", baud=115200, 
-                           shunt_resistors=[200.0, 200.0, 200.0, 200.0],  # 200Ω shunt resistors (update to match your hardware)
-                           verbose=True)
-        
-        if adc.check_communication():
-            print("\n" + "="*50)
-            print("ADC Diagnostics:")
-            print("="*50)
-            
-            # First, test I2C communication with ADC
-            print("\nStep 1: Testing ADC I2C communication...")
-            i2c_ok = adc.test_adc_i2c(verbose=True, timeout=3.0)
-            
-            if not i2c_ok:
-                print("\n⚠️  WARNING: ADC I2C communication failed!")
-                print("   Check:")
-                print("   - I2C2 connections (SDA=PB10, SCL=PB11)")
-                print("   - ADS1115 power (VDD, GND)")
-                print("   - ADS1115 I2C address (ADDR pin to GND = 0x48)")
-                print("   - Pull-up resistors on I2C lines (typically 4.7kΩ)")
-                adc.close()
-                exit()
-            
-            # Test reading voltage from all channels
-            print("\nStep 2: Testing ADC voltage readings on all channels...")
-            for ch in range(4):
-                voltage = adc.read_voltage(ch, verbose=True, timeout=3.0)
-                if voltage is not None:
-                    print(f"  Channel {ch}: {voltage:.4f}V")
-                else:
-                    print(f"  Channel {ch}: ERROR - No response")
-            
-            # Now read current from ADC channel 0
-            print("\n" + "="*50)
-            print("Reading current from ADC channel 0...")
-            print("="*50)
-            current = adc.read_current(0, verbose=True, timeout=3.0)
-            
-            if current is not None:
-                print(f"\n✓ Success! Current: {current*1000:.3f}mA")
-                print(f"  (Voltage: {adc.read_voltage(0, verbose=False, timeout=2.0):.4f}V, "
-                      f"Shunt R: {adc.shunt_resistors[0]}Ω)")
+        print("\n" + "="*50)
+        print("ADC Diagnostics:")
+        print("="*50)
+        
+        # First, test I2C communication with ADC
+        print("\nStep 1: Testing ADC I2C communication...")
+        i2c_ok = smu.test_adc_i2c(verbose=True, timeout=3.0)
+        
+        if not i2c_ok:
+            print("\n⚠️  WARNING: ADC I2C communication failed!")
+            print("   Check:")
+            print("   - I2C2 connections (SDA=PB10, SCL=PB11)")
+            print("   - ADS1115 power (VDD, GND)")
+            print("   - ADS1115 I2C address (ADDR pin to GND = 0x48)")
+            print("   - Pull-up resistors on I2C lines (typically 4.7kΩ)")
+            smu.close()
+            exit()
+        
+        # Test reading voltage from all channels
+        print("\nStep 2: Testing ADC voltage readings on all channels...")
+        for ch in range(4):
+            voltage = smu.read_voltage(ch, verbose=True, timeout=3.0)
+            if voltage is not None:
+                print(f"  Channel {ch}: {voltage:.4f}V")
             else:
-                print("\n✗ Failed to read current")
-                print("\nTroubleshooting tips:")
-                print("  1. Check I2C connections for ADS1115 (SDA, SCL, VDD, GND)")
-                print("  2. Verify ADS1115 I2C address (default: 0x48)")
-                print("  3. Check if shunt resistor is connected between ADC channel and GND")
-                print("  4. Verify DAC output is connected to the circuit")
-                print("  5. Check if ADC is initialized in STM32 code")
-            
-            adc.close()
+                print(f"  Channel {ch}: ERROR - No response")
+        
+        # Now read current from ADC channel 0
+        print("\n" + "="*50)
+        print("Reading current from ADC channel 0...")
+        print("="*50)
+        current = smu.read_current(0, verbose=True, timeout=3.0)
+        
+        if current is not None:
+            print(f"\n✓ Success! Current: {current*1000:.3f}mA")
+            print(f"  (Voltage: {smu.read_voltage(0, verbose=False, timeout=2.0):.4f}V, "
+                  f"Shunt R: {smu.shunt_resistors[0]}Ω)")
         else:
-            print("ADC communication check failed.")
-            adc.close()
+            print("\n✗ Failed to read current")
+            print("\nTroubleshooting tips:")
+            print("  1. Check I2C connections for ADS1115 (SDA, SCL, VDD, GND)")
+            print("  2. Verify ADS1115 I2C address (default: 0x48)")
+            print("  3. Check if shunt resistor is connected between ADC channel and GND")
+            print("  4. Verify DAC output is connected to the circuit")
+            print("  5. Check if ADC is initialized in STM32 code")
+        
+        smu.close()
     else:
         print("Communication check failed. MCU may not be ready.")
-        dac.close()
+        smu.close()
         exit()
 
 
@@ -5,10 +5,21 @@ Utility classes for IV curve measurements, optical power measurements, data hand
 import numpy as np
 import matplotlib.pyplot as plt
 import csv
+import json
 import os
 from datetime import datetime
 from typing import List, Optional, Dict
 import time
+from concurrent.futures import TimeoutError as FutureTimeoutError
+
+from uart_com import FrameError
+
+
+# Columns of Optical.sweep_iv_curve results, in file order
+SWEEP_COLUMNS = ('dac_values', 'voltages', 'currents', 'powers_electrical',
+                 'powers_optical_mw', 'powers_optical_dbm')
+# CSV files larger than this are plotted through the memory-mapped loader
+MMAP_THRESHOLD_BYTES = 64 * 1024 * 1024
 
 
 class Electrical:
@@ -35,59 +46,189 @@ class Electrical:
         """Get shunt resistor values."""
         return self.shunt_resistors
 
-    def calculate_resistance(self, voltage: float, current: float) -> float:
-        """Calculate resistance from voltage and current."""
-        if current == 0:
-            return float('inf')
-        return voltage / current
+    def calculate_resistance(self, voltage, current):
+        """Calculate resistance from voltage and current (scalars or arrays; inf where I = 0)."""
+        v = np.asarray(voltage, dtype=np.float64)
+        i = np.asarray(current, dtype=np.float64)
+        with np.errstate(divide='ignore', invalid='ignore'):
+            r = np.where(i == 0, np.inf, v / np.where(i == 0, 1.0, i))
+        return float(r) if r.ndim == 0 else r
 
-    def calculate_power(self, voltage: float, current: float) -> float:
-        """Calculate electrical power (P = V × I)."""
-        return voltage * current
+    def calculate_power(self, voltage, current):
+        """Calculate electrical power (P = V × I), scalars or arrays."""
+        p = np.multiply(np.asarray(voltage, dtype=np.float64), np.asarray(current, dtype=np.float64))
+        return float(p) if p.ndim == 0 else p
     
-    def calculate_current_from_shunt(self, voltage: float, channel: int) -> float:
-        """Calculate current from shunt resistor voltage drop."""
-        if channel < 0 or channel >= len(self.shunt_resistors):
-            return 0.0
-        shunt_r = self.shunt_resistors[channel]
-        if shunt_r == 0:
-            return 0.0
-        return voltage / shunt_r
+    def calculate_current_from_shunt(self, voltage, channel: int):
+        """Calculate current from shunt resistor voltage drop (voltage: scalar or array)."""
+        v = np.asarray(voltage, dtype=np.float64)
+        if channel < 0 or channel >= len(self.shunt_resistors) or self.shunt_resistors[channel] == 0:
+            i = np.zeros_like(v)
+        else:
+            i = v / self.shunt_resistors[channel]
+        return float(i) if i.ndim == 0 else i
     
-    def analyze_iv_curve(self, voltages: List[float], currents: List[float]) -> Dict:
+    def analyze_iv_curve(self, voltages, currents) -> Dict:
         """
         Analyze IV curve and return key parameters.
         
+        Args:
+            voltages: Voltages (list or numpy array)
+            currents: Currents, same length
+        
         Returns:
-            Dictionary with: resistances, powers, max_power, max_power_voltage,
-            max_power_current, open_circuit_voltage, short_circuit_current
+            Dictionary with: resistances, powers, dynamic_resistances (dV/dI, in
+            sweep order), max_power, max_power_voltage, max_power_current,
+            open_circuit_voltage, short_circuit_current
         """
-        if len(voltages) != len(currents):
+        v = np.asarray(voltages, dtype=np.float64)
+        i = np.asarray(currents, dtype=np.float64)
+        if v.shape != i.shape:
             raise ValueError("Voltages and currents must have the same length")
+        if v.size == 0:
+            raise ValueError("Empty IV curve")
         
-        resistances = [self.calculate_resistance(v, i) for v, i in zip(voltages, currents)]
-        powers = [self.calculate_power(v, i) for v, i in zip(voltages, currents)]
-        
-        max_power_idx = np.argmax(powers)
-        max_power = powers[max_power_idx]
+        resistances = self.calculate_resistance(v, i)
+        powers = self.calculate_power(v, i)
+        max_power_idx = int(np.argmax(powers))
         
-        # Estimate open circuit voltage (point closest to zero current)
-        zero_current_idx = np.argmin(np.abs(currents)) if currents else 0
-        open_circuit_voltage = voltages[zero_current_idx]
-        
-        # Estimate short circuit current (point closest to zero voltage)
-        zero_voltage_idx = np.argmin(np.abs(voltages)) if voltages else 0
-        short_circuit_current = currents[zero_voltage_idx]
+        # Estimate open circuit voltage (point closest to zero current) and
+        # short circuit current (point closest to zero voltage)
+        zero_current_idx = int(np.argmin(np.abs(i)))
+        zero_voltage_idx = int(np.argmin(np.abs(v)))
         
         return {
             'resistances': resistances,
             'powers': powers,
-            'max_power': max_power,
-            'max_power_voltage': voltages[max_power_idx],
-            'max_power_current': currents[max_power_idx],
-            'open_circuit_voltage': open_circuit_voltage,
-            'short_circuit_current': short_circuit_current
+            'dynamic_resistances': self._derivative(v, i),
+            'max_power': float(powers[max_power_idx]),
+            'max_power_voltage': float(v[max_power_idx]),
+            'max_power_current': float(i[max_power_idx]),
+            'open_circuit_voltage': float(v[zero_current_idx]),
+            'short_circuit_current': float(i[zero_voltage_idx])
         }
+    
+    def analyze_liv_curve(self, currents, optical_powers, voltages=None,
+                          fit_range=(0.2, 0.8), kink_tolerance: float = 0.2) -> Dict:
+        """
+        Extract laser parameters from L-I(-V) curves, one device or a whole batch.
+        
+        The lasing region is fitted with a straight line through the points whose
+        optical power lies within fit_range of the maximum; its slope is the slope
+        efficiency and its zero crossing the threshold current. Above threshold and
+        up to the power maximum, a kink is a local dip in dL/dI: a point where the
+        slope falls more than kink_tolerance below the steepest slope seen both
+        before and after it, i.e. it drops and then recovers. A slope that only
+        decreases (thermal rollover, including the approach to the power peak) is
+        therefore not a kink.
+        
+        Args:
+            currents: Drive currents (A), shape (points,) or (devices, points);
+                      a 1-D grid is shared by all devices
+            optical_powers: Optical powers, same shape (any unit, e.g. mW)
+            voltages: Optional voltages (V) for dynamic resistance, same shape
+            fit_range: (low, high) fraction of the maximum power used for the fit
+            kink_tolerance: Relative slope drop, against the slopes on both sides,
+                            that counts as a kink
+        
+        Returns:
+            Dictionary with: threshold_current (A), slope_efficiency (power unit
+            per A), kink_currents (A, list per device), kink_count and, with
+            voltages, dynamic_resistance (dV/dI, sorted by current) and
+            series_resistance (median dV/dI above threshold). Values are scalars
+            for one device and arrays over devices for a batch
+        
+        Example:
+            i = np.arange(61) * 0.02                        # 0-1.2 A
+            rollover = np.clip(i - 0.2, 0, None) - 0.35 * np.clip(i - 0.2, 0, None) ** 2
+            electrical.analyze_liv_curve(i, rollover)['kink_count']     # 0
+            
+            # Slope drops to 0.3 between 0.6 and 0.7 A, then recovers
+            slope = np.where(i < 0.2, 0.0, np.where((i >= 0.6) & (i < 0.7), 0.3, 1.0))
+            kinked = np.concatenate([[0.0], np.cumsum(slope[:-1] * np.diff(i))])
+            electrical.analyze_liv_curve(i, kinked)['kink_currents']    # [0.6]
+        """
+        single = np.ndim(optical_powers) == 1
+        i = np.atleast_2d(np.asarray(currents, dtype=np.float64))
+        l = np.atleast_2d(np.asarray(optical_powers, dtype=np.float64))
+        i, l = np.broadcast_arrays(i, l)
+        
+        # Sort every device by current, the derivatives below need ascending I
+        order = np.argsort(i, axis=1)
+        i = np.take_along_axis(i, order, axis=1)
+        l = np.take_along_axis(l, order, axis=1)
+        
+        # Least-squares line through the fit window of each device
+        with np.errstate(invalid='ignore', divide='ignore'):
+            l_max = np.nanmax(np.where(np.isfinite(l), l, -np.inf), axis=1, keepdims=True)
+            fit = np.isfinite(i) & np.isfinite(l) & (l >= fit_range[0] * l_max) & (l <= fit_range[1] * l_max)
+            n = fit.sum(axis=1)
+            x = np.where(fit, i, 0.0)
+            y = np.where(fit, l, 0.0)
+            sx, sy = x.sum(axis=1), y.sum(axis=1)
+            den = n * (x * x).sum(axis=1) - sx * sx
+            slope = np.where(den > 0, (n * (x * y).sum(axis=1) - sx * sy) / den, np.nan)
+            intercept = (sy - slope * sx) / n
+            threshold = np.where(slope > 0, -intercept / slope, np.nan)
+        
+        # Kinks: local dips of dL/dI between the start of the fit window and the power
+        # maximum, against the steepest slope before and after each point
+        dl_di = self._derivative(l, i)
+        points = np.arange(l.shape[1])
+        peak = np.argmax(np.where(np.isfinite(l), l, -np.inf), axis=1)[:, None]
+        lasing = (l >= fit_range[0] * l_max) & (points <= peak)
+        with np.errstate(invalid='ignore'):
+            ranked = np.where(lasing & np.isfinite(dl_di), dl_di, -np.inf)
+            none = np.full_like(ranked[:, :1], -np.inf)
+            before = np.concatenate([none, np.maximum.accumulate(ranked, axis=1)[:, :-1]], axis=1)
+            after = np.concatenate([np.maximum.accumulate(ranked[:, ::-1], axis=1)[:, ::-1][:, 1:], none], axis=1)
+            kinked = lasing & (dl_di < (1.0 - kink_tolerance) * np.minimum(before, after))
+        onset = kinked & ~np.concatenate([np.zeros_like(kinked[:, :1]), kinked[:, :-1]], axis=1)
+        kink_currents = [i[d, onset[d]] for d in range(i.shape[0])]
+        
+        result = {
+            'threshold_current': threshold,
+            'slope_efficiency': slope,
+            'kink_currents': kink_currents,
+            'kink_count': onset.sum(axis=1),
+        }
+        
+        if voltages is not None:
+            v = np.broadcast_to(np.atleast_2d(np.asarray(voltages, dtype=np.float64)), i.shape)
+            v = np.take_along_axis(v, order, axis=1)
+            r_dyn = self._derivative(v, i)
+            with np.errstate(invalid='ignore'):
+                above = i > threshold[:, None]
+            result['dynamic_resistance'] = r_dyn
+            result['series_resistance'] = np.array([
+                np.nanmedian(r_dyn[d, above[d]]) if above[d].any() else np.nan
+                for d in range(i.shape[0])])
+        
+        if single:
+            result = {key: (value[0] if key != 'kink_count' else int(value[0])) for key, value in result.items()}
+            for key in ('threshold_current', 'slope_efficiency', 'series_resistance'):
+                if key in result:
+                    result[key] = float(result[key])
+        return result
+    
+    @staticmethod
+    def _derivative(y, x):
+        """
+        dy/dx along the last axis: central differences inside, one-sided at the ends.
+        
+        Works on non-uniform grids; steps where x does not change give NaN.
+        """
+        y = np.asarray(y, dtype=np.float64)
+        x = np.asarray(x, dtype=np.float64)
+        if y.shape[-1] < 2:
+            return np.full(y.shape, np.nan)
+        
+        dy = np.concatenate([y[..., 1:2] - y[..., :1], y[..., 2:] - y[..., :-2],
+                             y[..., -1:] - y[..., -2:-1]], axis=-1)
+        dx = np.concatenate([x[..., 1:2] - x[..., :1], x[..., 2:] - x[..., :-2],
+                             x[..., -1:] - x[..., -2:-1]], axis=-1)
+        with np.errstate(divide='ignore', invalid='ignore'):
+            return np.where(dx != 0, dy / np.where(dx != 0, dx, 1.0), np.nan)
 
 
 class Optical:
@@ -129,13 +270,17 @@ class Optical:
         if voltage is None:
             voltage = 0.0
         
+        # Read optical power once, dBm follows from mW
+        power_optical_mw = self.opm.get_power_mw(opm_channel)
+        
+        return self._make_point(dac_value, voltage, adc_channel, power_optical_mw)
+    
+    def _make_point(self, dac_value: int, voltage: float, adc_channel: int,
+                    power_optical_mw: Optional[float]) -> Dict:
+        """Build the measure_iv_point dictionary from the raw readings."""
         # Calculate current
         current = self.electrical.calculate_current_from_shunt(voltage, adc_channel)
         
-        # Read optical power
-        power_optical_mw = self.opm.get_power_mw(opm_channel)
-        power_optical_dbm = self.opm.get_power(opm_channel)
-        
         # Calculate electrical power
         power_electrical = self.electrical.calculate_power(voltage, current)
         
@@ -145,55 +290,159 @@ class Optical:
             'current': current,
             'power_electrical': power_electrical,
             'power_optical_mw': power_optical_mw if power_optical_mw is not None else float('nan'),
-            'power_optical_dbm': power_optical_dbm if power_optical_dbm is not None else float('nan')
+            'power_optical_dbm': self._mw_to_dbm(power_optical_mw)
         }
     
     def sweep_iv_curve(self, dac_channel: int, adc_channel: int,
                        start_value: int, end_value: int, steps: int,
-                       opm_channel: int = 1, delay: float = 0.1) -> Dict:
+                       opm_channel: int = 1, delay: float = 0.1,
+                       pipelined: bool = True, timeout: float = 2.0,
+                       opm_mode: str = 'point', save_path: Optional[str] = None,
+                       keep_data: bool = True) -> Dict:
         """
         Sweep DAC and measure IV curve with optical power.
         
+        With pipelined=True the MCU commands go through the controllers' async
+        layer: the ADC conversion runs while the OPM is queried, and the next
+        DAC code is sent before the current point is evaluated. The MCU handles
+        commands in order, so that write cannot land before the ADC reading.
+        
+        opm_mode selects how the optical column is acquired:
+            'point': query the OPM at every step
+            'software': arm OPM logging for all steps, software trigger per step
+            'hardware': arm OPM logging, the MCU pulses its trigger output per step
+        Both logging modes read the whole trace with one transfer after the sweep.
+        
+        With save_path, every point is written to disk as it is measured
+        (SweepWriter: CSV, or HDF5 for '.h5'), so a crash keeps the points taken so
+        far. In the logging modes the optical columns of that file stay NaN and the
+        trace is written to '<save_path stem>_opm.<ext>' once it has been read.
+        keep_data=False skips the in-memory lists, for runs too long to hold.
+        
         Returns:
             Dictionary with: dac_values, voltages, currents, powers_electrical,
-            powers_optical_mw, powers_optical_dbm
+            powers_optical_mw, powers_optical_dbm (empty lists with keep_data=False)
         """
-        dac_values = []
-        voltages = []
-        currents = []
-        powers_electrical = []
-        powers_optical_mw = []
-        powers_optical_dbm = []
+        results = {column: [] for column in SWEEP_COLUMNS}
         
         step_size = (end_value - start_value) / (steps - 1) if steps > 1 else 0
         
         print(f"Sweeping DAC ch{dac_channel}, reading ADC ch{adc_channel}, OPM ch{opm_channel}...")
         
-        for i in range(steps):
-            dac_value = int(start_value + i * step_size)
-            point = self.measure_iv_point(dac_channel, adc_channel, dac_value, 
-                                        opm_channel, delay)
-            
-            dac_values.append(point['dac_value'])
-            voltages.append(point['voltage'])
-            currents.append(point['current'])
-            powers_electrical.append(point['power_electrical'])
-            powers_optical_mw.append(point['power_optical_mw'])
-            powers_optical_dbm.append(point['power_optical_dbm'])
-            
-            print(f"  Step {i+1}/{steps}: V={point['voltage']:.3f}V, "
-                  f"I={point['current']*1000:.3f}mA, "
-                  f"P_elec={point['power_electrical']*1000:.3f}mW, "
-                  f"P_opt={point['power_optical_mw']:.3f}mW")
-        
-        return {
-            'dac_values': dac_values,
-            'voltages': voltages,
-            'currents': currents,
-            'powers_electrical': powers_electrical,
-            'powers_optical_mw': powers_optical_mw,
-            'powers_optical_dbm': powers_optical_dbm
-        }
+        dac_codes = [int(start_value + i * step_size) for i in range(steps)]
+        logging = opm_mode in ('software', 'hardware')
+        if logging and not self.opm.start_logging(opm_channel, steps, triggered=True):
+            print("  Warning: Could not arm OPM logging, querying every point instead")
+            logging = False
+        
+        writer = SweepWriter(save_path, SWEEP_COLUMNS) if save_path else None
+        started = self._start_async() if pipelined else []
+        ack = self.dac.set_dac_async(dac_channel, dac_codes[0]) if (pipelined and dac_codes) else None
+        
+        try:
+            for i, dac_value in enumerate(dac_codes):
+                if not pipelined and not logging:
+                    point = self.measure_iv_point(dac_channel, adc_channel, dac_value,
+                                                  opm_channel, delay)
+                elif not pipelined:
+                    self.dac.set_dac(dac_channel, dac_value, verbose=False)
+                    time.sleep(delay)
+                    self._trigger_opm(opm_mode, pipelined)
+                    voltage = self.adc.read_voltage(adc_channel, verbose=False)
+                    point = self._make_point(dac_value, voltage if voltage is not None else 0.0,
+                                             adc_channel, None)
+                else:
+                    time.sleep(delay)
+                    if not self._wait(ack, timeout):
+                        print(f"  Warning: DAC write {dac_value} not acknowledged")
+                    
+                    trigger = self._trigger_opm(opm_mode, pipelined) if logging else None
+                    reading = self.adc.read_voltage_async(adc_channel)
+                    power_optical_mw = None if logging else self.opm.get_power_mw(opm_channel)
+                    if i + 1 < steps:
+                        ack = self.dac.set_dac_async(dac_channel, dac_codes[i + 1])
+                    
+                    voltage = self._wait(reading, timeout)
+                    if voltage is None:
+                        print(f"  Warning: ADC reading at step {i+1} lost, recorded as 0 V")
+                    if trigger is not None and not self._wait(trigger, timeout):
+                        print(f"  Warning: OPM trigger at step {i+1} not acknowledged")
+                    point = self._make_point(dac_value, voltage if voltage is not None else 0.0,
+                                             adc_channel, power_optical_mw)
+                
+                row = (point['dac_value'], point['voltage'], point['current'],
+                       point['power_electrical'], point['power_optical_mw'],
+                       point['power_optical_dbm'])
+                if writer is not None:
+                    writer.write_row(row)
+                if keep_data:
+                    for column, value in zip(SWEEP_COLUMNS, row):
+                        results[column].append(value)
+                
+                print(f"  Step {i+1}/{steps}: V={point['voltage']:.3f}V, "
+                      f"I={point['current']*1000:.3f}mA, "
+                      f"P_elec={point['power_electrical']*1000:.3f}mW"
+                      + ("" if logging else f", P_opt={point['power_optical_mw']:.3f}mW"))
+        finally:
+            # Points measured before an error or Ctrl+C stay on disk
+            for controller in started:
+                controller.stop_async()
+            if writer is not None:
+                writer.close()
+        
+        if logging:
+            trace = self.opm.fetch_logging(opm_channel)
+            if trace is None or len(trace) < steps:
+                print("  Warning: OPM trace incomplete")
+            else:
+                powers_optical_mw = [float(p) for p in trace[:steps]]
+                powers_optical_dbm = [self._mw_to_dbm(p) for p in powers_optical_mw]
+                if keep_data:
+                    results['powers_optical_mw'] = powers_optical_mw
+                    results['powers_optical_dbm'] = powers_optical_dbm
+                if save_path:
+                    stem, ext = os.path.splitext(save_path)
+                    with SweepWriter(f"{stem}_opm{ext or '.csv'}", SWEEP_COLUMNS[-2:]) as opm_writer:
+                        for row in zip(powers_optical_mw, powers_optical_dbm):
+                            opm_writer.write_row(row)
+        
+        return results
+    
+    def _trigger_opm(self, opm_mode: str, pipelined: bool):
+        """Record one logged OPM point; returns the MCU trigger Future when pipelined."""
+        if opm_mode == 'software':
+            self.opm.trigger()
+            return None
+        if pipelined:
+            return self.dac.opm_trigger_async()
+        self.dac.opm_trigger(verbose=False)
+        return None
+    
+    @staticmethod
+    def _mw_to_dbm(power_mw: Optional[float]) -> float:
+        """Convert mW to dBm (NaN for missing or non-positive readings)."""
+        if power_mw is None or not power_mw > 0:
+            return float('nan')
+        return 10 * np.log10(power_mw)
+    
+    def _start_async(self) -> list:
+        """Start the reader of each MCU controller that is not pipelining yet; returns those started."""
+        started = []
+        controllers = [self.dac] if self.adc is self.dac else [self.dac, self.adc]
+        for controller in controllers:
+            if not controller.async_active and controller.start_async():
+                started.append(controller)
+        return started
+    
+    @staticmethod
+    def _wait(future, timeout: float):
+        """Result of an async command, or None if it failed, its reply was lost or it timed out."""
+        if future is None:
+            return None
+        try:
+            return future.result(timeout)
+        except (FutureTimeoutError, FrameError):
+            return None
 
 
 class DataHandler:
@@ -228,15 +477,22 @@ class DataHandler:
         print(f"Data saved to {filename}")
     
     @staticmethod
-    def load_from_csv(filename: str) -> Dict:
+    def load_from_csv(filename: str, mmap: bool = False) -> Dict:
         """
         Load data from CSV file.
         
+        Args:
+            filename: CSV file with a header row
+            mmap: Return memory-mapped numpy columns instead of lists, for files
+                  too large to load (see load_csv_mmap)
+        
         Returns:
             Dictionary with column names as keys
         """
         if not os.path.exists(filename):
             raise FileNotFoundError(f"File {filename} not found")
+        if mmap:
+            return DataHandler.load_csv_mmap(filename)
         
         data = {}
         with open(filename, 'r') as csvfile:
@@ -255,6 +511,88 @@ class DataHandler:
         
         return data
     
+    @staticmethod
+    def load_csv_mmap(filename: str, chunk_rows: int = 100000) -> Dict:
+        """
+        Load a CSV file as memory-mapped numpy columns.
+        
+        The first call converts the file, chunk_rows at a time, to a float64
+        cache '<filename>.npy' next to it; later calls map that cache directly
+        until the CSV is modified again. Only the pages actually read are loaded,
+        so multi-GB files can be sliced and plotted.
+        
+        Args:
+            filename: CSV file with a header row
+            chunk_rows: Rows parsed per conversion step
+        
+        Returns:
+            Dictionary of column name -> read-only numpy array (empty or
+            non-numeric cells are NaN)
+        """
+        if not os.path.exists(filename):
+            raise FileNotFoundError(f"File {filename} not found")
+        
+        cache = filename + '.npy'
+        with open(filename, 'r', newline='') as csvfile:
+            header = next(csv.reader(csvfile))
+            
+            if not os.path.exists(cache) or os.path.getmtime(cache) < os.path.getmtime(filename):
+                rows = sum(1 for _ in csvfile)
+                csvfile.seek(0)
+                next(csvfile)
+                
+                table = np.lib.format.open_memmap(cache, mode='w+', dtype=np.float64,
+                                                  shape=(rows, len(header)))
+                reader = csv.reader(csvfile)
+                start = 0
+                while start < rows:
+                    chunk = [row for _, row in zip(range(chunk_rows), reader)]
+                    if not chunk:
+                        break
+                    for i, row in enumerate(chunk):
+                        for j in range(len(header)):
+                            try:
+                                table[start + i, j] = float(row[j])
+                            except (ValueError, IndexError):
+                                table[start + i, j] = np.nan
+                    start += len(chunk)
+                table.flush()
+                del table
+        
+        table = np.load(cache, mmap_mode='r')
+        return {col: table[:, j] for j, col in enumerate(header)}
+    
+    @staticmethod
+    def save_to_json(data, filename: str) -> None:
+        """
+        Save data (dictionaries, lists, numbers, strings) to a JSON file.
+        
+        Args:
+            data: JSON-serializable data
+            filename: Output filename
+        """
+        if not filename.endswith('.json'):
+            filename += '.json'
+        
+        with open(filename, 'w') as jsonfile:
+            json.dump(data, jsonfile, indent=2)
+        
+        print(f"Data saved to {filename}")
+    
+    @staticmethod
+    def load_from_json(filename: str):
+        """
+        Load data from a JSON file.
+        
+        Returns:
+            The stored data
+        """
+        if not os.path.exists(filename):
+            raise FileNotFoundError(f"File {filename} not found")
+        
+        with open(filename, 'r') as jsonfile:
+            return json.load(jsonfile)
+    
     @staticmethod
     def create_timestamped_filename(prefix: str, extension: str = 'csv') -> str:
         """Create filename with timestamp."""
@@ -262,6 +600,112 @@ class DataHandler:
         return f"{prefix}_{timestamp}.{extension}"
 
 
+class SweepWriter:
+    """
+    Incremental writer for long measurements: rows go to disk as they arrive.
+    
+    CSV files are appended to and flushed to disk every flush_rows rows or
+    flush_interval seconds, so a crash loses at most that much. Files ending in
+    '.h5'/'.hdf5' are written with h5py instead: one chunked, resizable dataset
+    per column. Memory use stays flat however long the run is.
+    
+    Usage:
+        with SweepWriter('run.csv', ('dac_values', 'voltages')) as writer:
+            writer.write_row((1000, 0.512))
+    """
+    
+    def __init__(self, filename: str, columns, flush_rows: int = 100,
+                 flush_interval: float = 1.0, chunk_rows: int = 4096):
+        """
+        Open (or create) the output file.
+        
+        Args:
+            filename: Output file; '.csv' is appended unless it ends in .csv/.h5/.hdf5
+            columns: Column names, in row order. Appending to an existing CSV
+                     requires the same header
+            flush_rows: Rows between flushes to disk
+            flush_interval: Maximum seconds between flushes to disk
+            chunk_rows: HDF5 chunk size along the rows
+        """
+        self.hdf5 = filename.endswith(('.h5', '.hdf5'))
+        if not self.hdf5 and not filename.endswith('.csv'):
+            filename += '.csv'
+        self.filename = filename
+        self.columns = list(columns)
+        self.flush_rows = flush_rows
+        self.flush_interval = flush_interval
+        self.rows = 0                   # Rows written by this writer
+        self._pending = []              # Rows not yet flushed
+        self._last_flush = time.time()
+        
+        if self.hdf5:
+            import h5py                 # Optional dependency, only needed for HDF5 output
+            self._file = h5py.File(filename, 'a')
+            for col in self.columns:
+                if col not in self._file:
+                    self._file.create_dataset(col, shape=(0,), maxshape=(None,), dtype='f8',
+                                              chunks=(chunk_rows,))
+        else:
+            exists = os.path.exists(filename) and os.path.getsize(filename) > 0
+            if exists:
+                with open(filename, 'r', newline='') as csvfile:
+                    header = next(csv.reader(csvfile), [])
+                if header != self.columns:
+                    raise ValueError(f"{filename} has columns {header}, expected {self.columns}")
+            self._file = open(filename, 'a', newline='')
+            self._writer = csv.writer(self._file)
+            if not exists:
+                self._writer.writerow(self.columns)
+    
+    def write_row(self, row) -> None:
+        """
+        Append one row.
+        
+        Args:
+            row: Values in column order, or a dictionary keyed by column name
+                 (missing keys are left empty / NaN)
+        """
+        if isinstance(row, dict):
+            row = [row.get(col, float('nan') if self.hdf5 else '') for col in self.columns]
+        self._pending.append(row)
+        self.rows += 1
+        if (len(self._pending) >= self.flush_rows or
+                time.time() - self._last_flush >= self.flush_interval):
+            self.flush()
+    
+    def flush(self) -> None:
+        """Write pending rows and push them to disk."""
+        if self._pending:
+            if self.hdf5:
+                values = np.array(self._pending, dtype=np.float64).reshape(len(self._pending), -1)
+                for j, col in enumerate(self.columns):
+                    dataset = self._file[col]
+                    size = dataset.shape[0]
+                    dataset.resize((size + len(values),))
+                    dataset[size:] = values[:, j]
+            else:
+                self._writer.writerows(self._pending)
+            self._pending = []
+        self._file.flush()
+        if not self.hdf5:
+            os.fsync(self._file.fileno())
+        self._last_flush = time.time()
+    
+    def close(self) -> None:
+        """Flush and close the file."""
+        if self._file is not None:
+            self.flush()
+            self._file.close()
+            self._file = None
+            print(f"Data saved to {self.filename} ({self.rows} rows)")
+    
+    def __enter__(self):
+        return self
+    
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+
 class Plotter:
     """
     Class for plotting IV curves and related data.
@@ -353,27 +797,33 @@ class Plotter:
     @staticmethod
     def plot_from_csv(filename: str, x_col: str, y_col: str,
                      title: Optional[str] = None, save_path: Optional[str] = None,
-                     show_plot: bool = True) -> None:
-        """Plot data from CSV file."""
-        data = DataHandler.load_from_csv(filename)
+                     show_plot: bool = True, max_points: int = 20000) -> None:
+        """
+        Plot data from CSV file.
+        
+        Files above MMAP_THRESHOLD_BYTES are read through the memory-mapped
+        loader. Series longer than max_points are reduced to the minimum and
+        maximum of each bucket, which keeps spikes visible.
+        """
+        large = os.path.exists(filename) and os.path.getsize(filename) > MMAP_THRESHOLD_BYTES
+        data = DataHandler.load_from_csv(filename, mmap=large)
         
         if x_col not in data or y_col not in data:
             raise ValueError(f"Columns '{x_col}' or '{y_col}' not found in CSV")
         
-        x_data = data[x_col]
-        y_data = data[y_col]
+        x_data, y_data = Plotter._decimate(data[x_col], data[y_col], max_points)
         
         # Remove NaN values
-        valid_indices = [i for i in range(len(x_data))
-                        if not (np.isnan(x_data[i]) or np.isnan(y_data[i]))]
-        x_data = [x_data[i] for i in valid_indices]
-        y_data = [y_data[i] for i in valid_indices]
+        valid = ~(np.isnan(x_data) | np.isnan(y_data))
+        x_data = x_data[valid]
+        y_data = y_data[valid]
         
         if title is None:
             title = f"{y_col} vs {x_col}"
         
         plt.figure(figsize=(10, 6))
-        plt.plot(x_data, y_data, 'b-', linewidth=2, marker='o', markersize=4)
+        plt.plot(x_data, y_data, 'b-', linewidth=2, marker='o' if len(x_data) <= 1000 else None,
+                 markersize=4)
         plt.xlabel(x_col, fontsize=12)
         plt.ylabel(y_col, fontsize=12)
         plt.title(title, fontsize=14, fontweight='bold')
@@ -388,6 +838,45 @@ class Plotter:
             plt.show()
         else:
             plt.close()
+    
+    @staticmethod
+    def _decimate(x_data, y_data, max_points: int, chunk_buckets: int = 1000):
+        """
+        Reduce a series to at most ~max_points points: the min and max y of each bucket.
+        
+        Works through the data chunk_buckets buckets at a time, so memory-mapped
+        columns are never loaded whole.
+        
+        Returns:
+            (x, y) numpy arrays in the original order
+        """
+        n = len(x_data)
+        bucket = -(-n // max(max_points // 2, 1))
+        if bucket <= 1:
+            return np.asarray(x_data, dtype=np.float64), np.asarray(y_data, dtype=np.float64)
+        
+        x_out = []
+        y_out = []
+        for start in range(0, n, bucket * chunk_buckets):
+            stop = min(start + bucket * chunk_buckets, n)
+            y_chunk = np.asarray(y_data[start:stop], dtype=np.float64)
+            x_chunk = np.asarray(x_data[start:stop], dtype=np.float64)
+            buckets = -(-len(y_chunk) // bucket)
+            
+            # Pad the last bucket with NaN, ignored by the min/max below
+            padded = np.full(buckets * bucket, np.nan)
+            padded[:len(y_chunk)] = y_chunk
+            padded = padded.reshape(buckets, bucket)
+            lo = np.argmin(np.where(np.isnan(padded), np.inf, padded), axis=1)
+            hi = np.argmax(np.where(np.isnan(padded), -np.inf, padded), axis=1)
+            
+            offsets = np.arange(buckets) * bucket
+            index = np.sort(np.stack([offsets + lo, offsets + hi], axis=1), axis=1).ravel()
+            index = index[index < len(y_chunk)]
+            x_out.append(x_chunk[index])
+            y_out.append(y_chunk[index])
+        
+        return np.concatenate(x_out), np.concatenate(y_out)
 
 
 # Backward compatibility aliases